@@ -0,0 +1,124 @@
+import json
+import logging
+import os
+from typing import Optional, Tuple
+
+import cv2
+import numpy as np
+
+logger = logging.getLogger(__name__)
+
+# Fiducial carried by the gripper during hand-eye calibration
+MARKER_DICTIONARY = cv2.aruco.DICT_4X4_50
+MARKER_ID = 0
+MARKER_SIZE_MM = 40.0
+
+# Height of the conveyor surface in the arm frame (mm above the table)
+CONVEYOR_SURFACE_MM = 0.0
+
+# Camera intrinsics from a cv2.calibrateCamera run, optional
+INTRINSICS_FILE = os.path.join(os.path.dirname(__file__), "camera_intrinsics.json")
+
+# Camera pose written by the controller (HAND_EYE_FILE in include/config.h)
+HAND_EYE_FILE = os.path.join(os.path.dirname(__file__), "..", "config", "hand_eye.conf")
+
+class HandEyeCalibration:
+    def __init__(self, intrinsics_file: str = INTRINSICS_FILE):
+        """
+        Fiducial detection for the controller's HANDEYE routine and the
+        resulting camera pose, used to place detections in the arm frame
+        
+        Args:
+            intrinsics_file: JSON with camera_matrix (3x3) and dist_coeffs;
+                nominal values for a 640x480 camera are used without it
+        """
+        self.camera_matrix = np.array([[600.0, 0.0, 320.0],
+                                       [0.0, 600.0, 240.0],
+                                       [0.0, 0.0, 1.0]])
+        self.dist_coeffs = np.zeros(5)
+        if os.path.exists(intrinsics_file):
+            with open(intrinsics_file) as f:
+                intrinsics = json.load(f)
+            self.camera_matrix = np.array(intrinsics['camera_matrix'], dtype=float)
+            self.dist_coeffs = np.array(intrinsics['dist_coeffs'], dtype=float)
+        else:
+            logger.warning(f"No {intrinsics_file}, using nominal camera intrinsics")
+        
+        dictionary = cv2.aruco.getPredefinedDictionary(MARKER_DICTIONARY)
+        self.detector = cv2.aruco.ArucoDetector(dictionary, cv2.aruco.DetectorParameters())
+        
+        # Marker corners in its own frame, in the order IPPE_SQUARE expects
+        half = MARKER_SIZE_MM / 2.0
+        self.marker_points = np.array([[-half, half, 0.0], [half, half, 0.0],
+                                       [half, -half, 0.0], [-half, -half, 0.0]])
+        
+        # Camera pose in the arm frame, once calibrated
+        self.camera_rotation = None
+        self.camera_position = None
+    
+    def locate_fiducial(self, frame: np.ndarray) -> Optional[Tuple[np.ndarray, np.ndarray]]:
+        """Fiducial pose in the camera frame as (rotation vector, translation mm)"""
+        gray = cv2.cvtColor(frame, cv2.COLOR_BGR2GRAY)
+        corners, ids, _ = self.detector.detectMarkers(gray)
+        if ids is None:
+            return None
+        
+        for marker_corners, marker_id in zip(corners, ids.flatten()):
+            if marker_id != MARKER_ID:
+                continue
+            image_points = marker_corners.reshape(4, 2).astype(float)
+            ok, rvec, tvec = cv2.solvePnP(self.marker_points, image_points, self.camera_matrix,
+                                          self.dist_coeffs, flags=cv2.SOLVEPNP_IPPE_SQUARE)
+            if ok:
+                return rvec.flatten(), tvec.flatten()
+        return None
+    
+    def capture_reply(self, index: int, frame: Optional[np.ndarray]) -> str:
+        """Answer to the controller's CAPTURE <index> request"""
+        pose = self.locate_fiducial(frame) if frame is not None else None
+        if pose is None:
+            return f"{index} none"
+        rvec, tvec = pose
+        return f"{index} " + " ".join(f"{v:.6f}" for v in rvec) + " " + " ".join(f"{v:.2f}" for v in tvec)
+    
+    def load(self, path: str) -> bool:
+        """Read the camera pose written by the controller (key = value lines)"""
+        values = {}
+        try:
+            with open(path) as f:
+                for line in f:
+                    line = line.split('#', 1)[0]
+                    if '=' not in line:
+                        continue
+                    key, value = line.split('=', 1)
+                    values[key.strip()] = [float(v) for v in value.split()]
+        except (OSError, ValueError) as e:
+            logger.error(f"Failed to read {path}: {e}")
+            return False
+        
+        if len(values.get('rotation', [])) != 3 or len(values.get('translation', [])) != 3:
+            logger.error(f"{path}: needs rotation and translation")
+            return False
+        self.camera_rotation, _ = cv2.Rodrigues(np.array(values['rotation']))
+        self.camera_position = np.array(values['translation'])
+        logger.info(f"Camera pose loaded from {path}")
+        return True
+    
+    def is_calibrated(self) -> bool:
+        return self.camera_rotation is not None
+    
+    def pixel_to_arm(self, u: float, v: float,
+                     plane_z_mm: float = CONVEYOR_SURFACE_MM) -> Optional[Tuple[float, float, float]]:
+        """Arm-frame point (mm) where the camera ray through pixel (u, v) meets a horizontal plane"""
+        if not self.is_calibrated():
+            return None
+        
+        normalized = cv2.undistortPoints(np.array([[[u, v]]], dtype=float), self.camera_matrix, self.dist_coeffs)
+        ray = self.camera_rotation @ np.array([normalized[0, 0, 0], normalized[0, 0, 1], 1.0])
+        if abs(ray[2]) < 1e-6:
+            return None
+        scale = (plane_z_mm - self.camera_position[2]) / ray[2]
+        if scale <= 0:
+            return None  # Plane is behind the camera
+        point = self.camera_position + scale * ray
+        return float(point[0]), float(point[1]), float(point[2])
@@ -1,6 +1,7 @@
 import asyncio
 import json
 import logging
+import os
 import threading
 import time
 from datetime import datetime
@@ -12,6 +13,7 @@ from flask import Flask, jsonify, request, send_from_directory
 from flask_cors import CORS
 
 from vision_tracking import VisionTracker
+from hand_eye import HandEyeCalibration, HAND_EYE_FILE
 from data_logger import DataLogger
 
 # Configure logging
@@ -22,6 +24,7 @@ class SmartArmBackend:
     def __init__(self):
         """Initialize Smart Arm Backend System"""
         self.vision_tracker = VisionTracker()
+        self.hand_eye = HandEyeCalibration()
         self.data_logger = DataLogger()
         self.mqtt_client = None
         self.websocket_clients = set()
@@ -86,6 +89,10 @@ class SmartArmBackend:
                     success = self.move_to_home()
                     return jsonify({'success': success})
                 
+                elif command == 'hand_eye_calibration':
+                    success = self.start_hand_eye_calibration()
+                    return jsonify({'success': success})
+                
                 else:
                     return jsonify({'error': 'Unknown command'}), 400
                     
@@ -143,6 +150,10 @@ class SmartArmBackend:
         
         self.vision_tracker.set_detection_callback(self.on_vision_detection)
         
+        # Camera pose from an earlier hand-eye calibration, if any
+        if os.path.exists(HAND_EYE_FILE):
+            self.hand_eye.load(HAND_EYE_FILE)
+        
         # Initialize MQTT
         if not self.initialize_mqtt():
             logger.error("Failed to initialize MQTT")
@@ -177,6 +188,7 @@ class SmartArmBackend:
             
             # Subscribe to status updates from C++ controller
             client.subscribe("smartarm/status")
+            client.subscribe("smartarm/calibration")
             
         else:
             logger.error(f"MQTT connection failed with code {rc}")
@@ -186,6 +198,9 @@ class SmartArmBackend:
         """MQTT message callback"""
         try:
             topic = msg.topic
+            if topic == "smartarm/calibration":
+                self.on_calibration_message(msg.payload.decode())
+                return
             payload = json.loads(msg.payload.decode())
             
             if topic == "smartarm/status":
@@ -202,6 +217,23 @@ class SmartArmBackend:
         except Exception as e:
             logger.error(f"MQTT message processing error: {e}")
     
+    def on_calibration_message(self, message: str):
+        """Hand-eye calibration traffic from the C++ controller"""
+        fields = message.split()
+        if len(fields) >= 2 and fields[0] == "CAPTURE":
+            # Answer from a worker thread, waiting for a frame would stall the MQTT loop
+            threading.Thread(target=self.answer_capture, args=(int(fields[1]), time.time()), daemon=True).start()
+        elif len(fields) >= 2 and fields[0] == "RESULT":
+            self.hand_eye.load(HAND_EYE_FILE)
+        elif fields and fields[0] == "FAILED":
+            logger.warning(f"Hand-eye calibration failed: {message}")
+    
+    def answer_capture(self, index: int, requested: float):
+        """Report the gripper fiducial's pose in a frame taken after the request"""
+        frame = self.vision_tracker.get_frame_after(requested)
+        reply = self.hand_eye.capture_reply(index, frame)
+        self.mqtt_client.publish("smartarm/calibration/fiducial", reply)
+    
     def on_mqtt_disconnect(self, client, userdata, rc):
         """MQTT disconnect callback"""
         logger.warning("Disconnected from MQTT broker")
@@ -209,6 +241,11 @@ class SmartArmBackend:
     
     def on_vision_detection(self, detections: List[Dict]):
         """Vision detection callback"""
+        # Place detections on the conveyor in arm coordinates once calibrated
+        if self.hand_eye.is_calibrated():
+            for detection in detections:
+                detection['arm_position'] = self.hand_eye.pixel_to_arm(*detection['center'])
+        
         self.system_status['last_detection'] = {
             'timestamp': datetime.now().isoformat(),
             'count': len(detections),
@@ -278,6 +315,13 @@ class SmartArmBackend:
             return True
         return False
     
+    def start_hand_eye_calibration(self) -> bool:
+        """Run the controller's hand-eye calibration (manual mode)"""
+        if self.mqtt_client:
+            self.mqtt_client.publish("smartarm/control", "HANDEYE")
+            return True
+        return False
+    
     async def websocket_handler(self, websocket, path):
         """WebSocket connection handler"""
         logger.info(f"WebSocket client connected: {websocket.remote_address}")
@@ -25,6 +25,7 @@ class VisionTracker:
         self.cap = None
         self.is_running = False
         self.current_frame = None
+        self.frame_time = 0.0
         self.detections = []
         self.detection_callback = None
         self.frame_lock = threading.Lock()
@@ -95,6 +96,7 @@ class VisionTracker:
                 # Store current frame
                 with self.frame_lock:
                     self.current_frame = frame.copy()
+                    self.frame_time = time.time()
                 
                 # Run YOLO detection
                 results = self.model(frame, conf=self.confidence_threshold, classes=self.target_classes)
@@ -160,6 +162,16 @@ class VisionTracker:
         with self.frame_lock:
             return self.current_frame.copy() if self.current_frame is not None else None
     
+    def get_frame_after(self, timestamp: float, timeout: float = 1.0) -> Optional[np.ndarray]:
+        """Get the first frame captured after timestamp, e.g. once the arm has settled"""
+        deadline = time.time() + timeout
+        while time.time() < deadline:
+            with self.frame_lock:
+                if self.current_frame is not None and self.frame_time > timestamp:
+                    return self.current_frame.copy()
+            time.sleep(0.01)
+        return None
+    
     def get_detections(self) -> List[Dict]:
         """Get current detections"""
         with self.frame_lock:
@@ -21,7 +21,129 @@
 #define MAX_SERVO_ANGLE 180
 #define MIN_SERVO_ANGLE 0
 #define ULTRASONIC_MAX_DISTANCE 400  // cm
-#define SERVO_DELAY_MS 20
+#define SERVO_COUNT 5
+#define CONTROL_TICK_MS 20           // step of blocking moves and grab routines
+#define CONTROL_ACTIVE_TICK_US 2000  // manual tick while jogging, streaming or servos move (500 Hz)
+#define CONTROL_IDLE_TICK_MS 250     // manual tick with everything settled; commands wake it at once
+
+// Servo Model (per joint: base, shoulder, elbow, wrist, gripper)
+#define SERVO_SLEW_DPS {300.0f, 200.0f, 250.0f, 400.0f, 400.0f}  // loaded slew speed
+#define SERVO_DEADBAND_DEG {2.0f, 2.0f, 2.0f, 2.0f, 3.0f}         // smallest move that happens
+
+// Idle Servo Power
+#define SERVO_IDLE_DETACH_MS 10000   // stop pulses on parked joints this long after their last move
+#define SERVO_HOLD_TORQUE {0, 1, 1, 0, 1}  // 1 = stays energized when parked (load bearing, gripping)
+#define SERVO_HOLD_CURRENT_MA {60.0f, 250.0f, 200.0f, 40.0f, 80.0f}  // estimated draw holding a pose (full load)
+
+// Supply Current Budget (5 V rail shared by the Pi, servos and conveyor motor)
+#define SUPPLY_LIMIT_MA 6000.0f      // supply rating
+#define SUPPLY_BASE_MA 1200.0f       // Pi, camera and sensor
+#define SUPPLY_MARGIN_MA 300.0f      // headroom for model error
+#define SERVO_MOVE_CURRENT_MA {700.0f, 900.0f, 900.0f, 250.0f, 250.0f}     // slewing at full speed
+#define SERVO_STALL_CURRENT_MA {2500.0f, 2500.0f, 2500.0f, 650.0f, 650.0f} // accelerating from rest
+#define SERVO_ACCEL_MS 40            // length of the start-up surge
+#define SUPPLY_START_WAIT_MS 80      // longest a jog or stream start is held for the budget
+#define MOTOR_CURRENT_MA 800.0f      // conveyor motor at full speed
+
+// Input Shaping (per joint: base, shoulder, elbow, wrist, gripper)
+#define SHAPER_DEFAULT_TYPE 0        // 0 = off, 1 = ZV, 2 = ZVD
+#define SHAPER_FREQ_HZ {4.0f, 3.0f, 4.0f, 6.0f, 8.0f}    // natural frequency
+#define SHAPER_DAMPING {0.3f, 0.3f, 0.3f, 0.3f, 0.3f}    // conservative until identified
+#define SHAPER_HISTORY 64            // reference changes kept per joint
+#define SHAPER_CAL_STEP_DEG 30       // step size of the identification move
+#define SHAPER_CAL_DURATION_MS 2000  // response recording time
+
+// Auto Mode
+#define AUTO_DETECT_DISTANCE_CM 20.0f  // a part closer than this triggers a grab
+#define AUTO_HYSTERESIS_CM 3.0f      // a part leaves the zone only beyond detect distance + this
+#define AUTO_ENTER_SAMPLES 2         // consecutive in-zone readings that raise a detection
+#define AUTO_EXIT_SAMPLES 3          // consecutive out-of-zone readings that clear it
+#define RANGE_PING_MS 60             // auto-mode ping interval (HC-SR04 measurement cycle)
+#define RANGE_SLOW_PING_MS 200       // manual-mode ping interval (status and telemetry distance)
+#define ULTRASONIC_MOUNT_MM {230.0f, -120.0f, 100.0f}  // sensor position in the arm frame (see kinematics.h)
+#define ULTRASONIC_AIM {0.0f, 1.0f, 0.0f}             // beam axis in the arm frame (unit vector)
+#define ULTRASONIC_BEAM_DEG 15.0f    // beam half-angle
+#define OCCLUSION_STEP_DEG 5         // pose resolution of the self-occlusion table
+#define OCCLUSION_MARGIN_CM 3.0f     // echoes this close in front of the arm still count as the arm
+#define AUTO_IDLE_WAKE_MS 1000       // control loop housekeeping while waiting for a part
+#define PROFILE_SUMMARY_CYCLES 50    // log the grab cycle phase summary this often
+#define PROFILE_TOP_PHASES 5         // phases listed in the summary
+
+// Conveyor Coordination (auto mode drives the belt)
+#define CONVEYOR_RUN_SPEED 100       // motor speed while no part needs holding
+#define CONVEYOR_MIN_SPEED 25        // the belt stalls below this; slower requests stop it
+#define CONVEYOR_BELT_MM_S 50.0f     // belt surface speed at motor speed 100
+#define CONVEYOR_REACH_MM 200.0f     // belt travel from a part's first reading until it leaves reach
+#define CONVEYOR_MARGIN_MM 40.0f     // travel still left when the gripper closes
+#define CONVEYOR_HISTORY 8           // belt speed changes kept for travel estimates
+
+// Hand-Eye Calibration (fixed camera, fiducial on the gripper)
+#define HAND_EYE_FILE "config/hand_eye.conf"  // camera pose in the arm frame, written by HANDEYE
+#define HAND_EYE_POSES { \
+    {90, 60, 120, 90}, {70, 60, 120, 90}, {110, 60, 120, 90}, {90, 45, 130, 70}, \
+    {75, 50, 140, 110}, {105, 50, 140, 70}, {90, 70, 110, 120}, {65, 70, 100, 75}, \
+    {115, 55, 125, 105}, {80, 45, 150, 60}, {100, 65, 115, 115}, {90, 55, 135, 90} }  // base, shoulder, elbow, wrist
+#define HAND_EYE_SETTLE_MS 300       // dwell at each pose before the capture
+#define HAND_EYE_CAPTURE_TIMEOUT_MS 2000  // wait for the vision node's fiducial pose
+#define HAND_EYE_MIN_SAMPLES 6       // poses with a detected fiducial needed to solve
+#define HAND_EYE_MIN_ROTATION_DEG 5.0  // pose pairs that rotate less are skipped
+#define HAND_EYE_TUKEY_C 4.685       // residual with no weight left (in robust standard deviations)
+
+// Grab Routine
+#define GRAB_PARAMS_FILE "config/grab_params.conf"  // tuned by grab-tuner, optional
+
+// Arm Geometry (used for Cartesian jogging and sensor self-occlusion)
+#define ARM_BASE_HEIGHT_MM 70.0f     // shoulder axis above table
+#define ARM_UPPER_LINK_MM 105.0f     // shoulder to elbow
+#define ARM_FORE_LINK_MM 100.0f      // elbow to wrist
+#define ARM_GRIPPER_LINK_MM 60.0f    // wrist to fingertips
+#define ARM_LINK_RADIUS_MM 20.0f     // link half-width including servo bodies
+
+// Jog Mode
+#define JOG_MAX_VELOCITY 90.0f       // deg/s per joint
+#define JOG_MAX_ACCEL 360.0f         // deg/s^2 per joint
+#define JOG_MAX_CARTESIAN_SPEED 100.0f // mm/s
+#define JOG_TIMEOUT_MS 250           // dead-man timeout without refresh
+
+// Setpoint Streaming
+#define STREAM_BUFFER_SIZE 32        // jitter buffer capacity (setpoints)
+#define STREAM_DEFAULT_DELAY_MS 100  // playback latency behind the sender
+#define STREAM_MAX_DELAY_MS 1000
+#define STREAM_TIMEOUT_MS 500        // end stream after holding this long
+#define STREAM_OFFSET_CREEP_S 1      // seconds per 1 ms of clock offset creep
+
+// Real-Time Memory
+#define RT_MEMORY_MODE 1             // mlockall and prefault after initialization
+#define RT_STACK_PREFAULT_KB 256     // control thread stack touched at startup
+#define RT_HEAP_PREFAULT_KB 1024     // heap faulted in and kept at startup
+#define RT_THREAD_STACK_KB 256       // stack of each helper thread (MQTT, watchdog, ranging, telemetry, HTTP)
+#define SCRATCH_ARENA_KB 64          // calibration scratch memory per thread
+
+// Flight Recorder
+#define FLIGHT_RECORDER_DIR "logs"     // dumps land here as flight-<time>-<reason>.bin
+#define FLIGHT_RECORDER_RECORDS 4096   // records kept per thread (~15 s of manual control)
+#define FLIGHT_RECORDER_THREADS 8      // threads that get a ring
+#define WATCHDOG_TIMEOUT_MS 10000      // control loop stall that trips the watchdog (> grab + cooldown)
+
+// Telemetry Store
+#define TELEMETRY_DIR "telemetry"      // columnar segments and Arrow exports
+#define TELEMETRY_EXPORT_FILE TELEMETRY_DIR "/export.arrow"  // latest export, replaced by the next one
+#define TELEMETRY_SAMPLE_MS 20         // joint and distance sample period (50 Hz)
+#define TELEMETRY_SEGMENT_ROWS 65536   // rows per segment file (~22 min at 50 Hz, 2.2 MB)
+#define TELEMETRY_RAW_HOURS 24         // full-rate rows kept, then rolled up to 1 s min/max/mean
+#define TELEMETRY_SECOND_DAYS 30       // 1 s rollups kept, then rolled up to 1 min
+#define TELEMETRY_MINUTE_DAYS 365      // 1 min rollups kept
+#define TELEMETRY_MAX_MB 1024          // oldest segments deleted beyond this
+#define TELEMETRY_RETENTION_S 60       // period of the retention pass
+#define TELEMETRY_HISTORY_POINTS 1000  // default points per series of a history query
+#define TELEMETRY_HISTORY_MAX_POINTS 10000  // largest history query accepted
+
+// Monitoring
+#define HTTP_BIND_ADDRESS "127.0.0.1"  // local HTTP endpoint (GET /metrics)
+#define HTTP_PORT 9105                 // 0 disables the TCP listener
+#define HTTP_UNIX_SOCKET ""            // also serve on this Unix socket path ("" disables)
+#define METRICS_SHARDS 8               // per-thread cells per counter/histogram
+#define METRICS_MAX_BUCKETS 16         // histogram buckets (excluding +Inf)
 
 // Communication
 #define MQTT_BROKER_HOST "localhost"
@@ -29,6 +151,13 @@
 #define MQTT_TOPIC_CONTROL "smartarm/control"
 #define MQTT_TOPIC_STATUS "smartarm/status"
 #define MQTT_TOPIC_DATA "smartarm/data"
+#define MQTT_TOPIC_CALIBRATION "smartarm/calibration"          // capture requests and results
+#define MQTT_TOPIC_FIDUCIAL "smartarm/calibration/fiducial"    // fiducial poses from the vision node
+#define MQTT_MAX_PAYLOAD 512         // longer control messages are truncated
+#define MQTT_LOOP_MS 10              // network loop wait, bounds outbound latency
+#define MESSAGE_POOL_SIZE 16         // preallocated outbound message buffers
+#define MESSAGE_BUFFER_SIZE 1024     // largest outbound message
+#define MESSAGE_POOL_WAIT_MS 50      // critical messages wait this long for a buffer
 
 // Vision Tracking
 #define CAMERA_WIDTH 640
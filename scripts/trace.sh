@@ -0,0 +1,26 @@
+#!/bin/bash
+
+# Smart Robotic Arm - attach a bundled bpftrace script to the running controller
+# Usage: ./scripts/trace.sh <script> [bpftrace options]
+# Scripts: command_latency, tick_latency, sensor_echo, publish_latency, servo_writes
+# Needs a build with USDT probes (systemtap-sdt-dev installed) and root.
+
+cd "$(dirname "$0")/.."
+
+SCRIPT="scripts/bpftrace/$1.bt"
+if [ -z "$1" ] || [ ! -f "$SCRIPT" ]; then
+    echo "Usage: $0 <script> [bpftrace options]"
+    echo "Available scripts:"
+    ls scripts/bpftrace/*.bt | xargs -n1 basename | sed 's/\.bt$//; s/^/  /'
+    exit 1
+fi
+shift
+
+PID=$(pidof SmartArm-Vision)
+if [ -z "$PID" ]; then
+    echo "SmartArm-Vision is not running"
+    exit 1
+fi
+
+echo "Tracing SmartArm-Vision (pid $PID) with $SCRIPT, Ctrl+C to print results..."
+exec sudo bpftrace -p "$PID" "$@" "$SCRIPT"
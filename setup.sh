@@ -10,6 +10,7 @@ sudo apt update && sudo apt upgrade -y
 # Install C++ build tools
 echo "🔧 Installing C++ build tools..."
 sudo apt install -y cmake build-essential pkg-config
+sudo apt install -y systemtap-sdt-dev bpftrace  # USDT probes and tracing scripts
 
 # Install wiringPi for GPIO control
 echo "🔌 Installing wiringPi library..."
@@ -0,0 +1,368 @@
+#include "sim_hardware.h"
+#include "occlusion_map.h"
+#include <wiringPi.h>
+#include <softPwm.h>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    const float POSE_TOLERANCE_DEG = 10.0f;   // softPwm resolution is 9 degrees
+    const std::chrono::microseconds ECHO_DELAY(450);
+    const std::chrono::milliseconds DYNAMICS_STEP(1);
+    const float DT = 0.001f;
+    const float PI = 3.14159265f;
+    const float DEFAULT_ACCEL = 4000.0f;      // deg/s^2, typical loaded hobby servo
+    
+    SimHardware* active_hardware = nullptr;
+    
+    float distance_mm(const ArmPoint& a, const ArmPoint& b) {
+        float dx = a.x - b.x, dy = a.y - b.y, dz = a.z - b.z;
+        return std::sqrt(dx * dx + dy * dy + dz * dz);
+    }
+}
+
+void set_sim_hardware(SimHardware* hardware) {
+    active_hardware = hardware;
+}
+
+SimHardware::SimHardware(SimClock& sim_clock, const GrabParams& grab_pose, const SimSensor& sensor_model,
+                         unsigned int seed) :
+    clock(sim_clock),
+    station(grab_pose),
+    sensor(sensor_model),
+    servo_pins{SERVO_BASE_PIN, SERVO_SHOULDER_PIN, SERVO_ELBOW_PIN, SERVO_WRIST_PIN, SERVO_GRIPPER_PIN},
+    gripper_closed(false),
+    gripper_closing(false),
+    reach_mm(CONVEYOR_REACH_MM),
+    motor_duty(0),
+    motor_direction_pins(0),
+    first_open(0),
+    trig_level(LOW),
+    echo_rise(Clock::TimePoint::max()),
+    echo_fall(Clock::TimePoint::max()),
+    empty_grabs(0),
+    rng(seed),
+    dynamics(false),
+    coupling(0.0f),
+    integrated(clock.now()),
+    carry_from(Clock::TimePoint::max()),
+    dynamics_report{0.0f, 0.0f, true} {
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        commanded[i] = 90.0f;
+        links[i] = {commanded[i], 0.0f, 0.0f, 0.0f};
+    }
+    belt.push_back({clock.now(), 0.0, 0.0});
+}
+
+void SimHardware::setServoSpeedScale(float scale) {
+    const float speeds[SERVO_COUNT] = SERVO_SLEW_DPS;
+    const float deadbands[SERVO_COUNT] = SERVO_DEADBAND_DEG;
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        servos.setCalibration(i, speeds[i] * scale, deadbands[i]);
+    }
+}
+
+void SimHardware::setDynamics(const SimJoint physical[SERVO_COUNT], float coupling_gain) {
+    std::lock_guard<std::mutex> lock(mutex);
+    const float deadbands[SERVO_COUNT] = SERVO_DEADBAND_DEG;
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        joints[i] = physical[i];
+        servos.setCalibration(i, physical[i].speed, deadbands[i]);
+        links[i] = {commanded[i], 0.0f, 0.0f, 0.0f};
+    }
+    coupling = coupling_gain;
+    dynamics = true;
+    integrated = clock.now();
+    carry_from = Clock::TimePoint::max();
+    dynamics_report = {0.0f, 0.0f, true};
+}
+
+void SimHardware::defaultJoints(SimJoint physical[SERVO_COUNT]) {
+    const float speeds[SERVO_COUNT] = SERVO_SLEW_DPS;
+    const float frequencies[SERVO_COUNT] = SHAPER_FREQ_HZ;
+    const float dampings[SERVO_COUNT] = SHAPER_DAMPING;
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        physical[i] = {speeds[i], DEFAULT_ACCEL, frequencies[i], dampings[i]};
+    }
+}
+
+SimDynamicsReport SimHardware::getDynamics() {
+    std::lock_guard<std::mutex> lock(mutex);
+    advanceDynamics(clock.now());
+    return dynamics_report;
+}
+
+void SimHardware::setReach(double reach) {
+    reach_mm = reach;
+}
+
+void SimHardware::reserveBelt(size_t changes) {
+    belt.reserve(belt.size() + changes);
+}
+
+void SimHardware::addPart(double position_mm, float distance_cm) {
+    SimPart part;
+    part.position_mm = position_mm;
+    part.distance_cm = distance_cm;
+    part.picked = false;
+    parts.push_back(part);
+}
+
+double SimHardware::travelAt(Clock::TimePoint when) const {
+    // Last segment starting at or before the time
+    auto after = std::upper_bound(belt.begin(), belt.end(), when,
+                                  [](Clock::TimePoint t, const SimBeltSegment& segment) { return t < segment.start; });
+    const SimBeltSegment& segment = after == belt.begin() ? belt.front() : *(after - 1);
+    double seconds = std::chrono::duration<double>(when - segment.start).count();
+    return segment.travel_mm + segment.speed_mm_s * std::max(0.0, seconds);
+}
+
+Clock::TimePoint SimHardware::arrivalTime(const SimPart& part) const {
+    for (size_t i = 0; i < belt.size(); i++) {
+        const SimBeltSegment& segment = belt[i];
+        if (segment.travel_mm >= part.position_mm) {
+            return segment.start;
+        }
+        bool last = i + 1 == belt.size();
+        if (segment.speed_mm_s > 0.0 && (last || belt[i + 1].travel_mm >= part.position_mm)) {
+            double seconds = (part.position_mm - segment.travel_mm) / segment.speed_mm_s;
+            return segment.start + std::chrono::microseconds(static_cast<long long>(seconds * 1e6));
+        }
+    }
+    return Clock::TimePoint::max();
+}
+
+bool SimHardware::inReach(const SimPart& part, double travel) const {
+    return part.position_mm <= travel && travel < part.position_mm + reach_mm;
+}
+
+int SimHardware::missedCount(Clock::TimePoint until) const {
+    double travel = travelAt(until);
+    int missed = 0;
+    for (const SimPart& part : parts) {
+        if (!part.picked && part.position_mm + reach_mm <= travel) {
+            missed++;
+        }
+    }
+    return missed;
+}
+
+void SimHardware::driveBelt(Clock::TimePoint when) {
+    // Both or neither direction pin high brakes the motor
+    int direction = motor_direction_pins == 1 ? 1 : motor_direction_pins == 2 ? -1 : 0;
+    double speed = CONVEYOR_BELT_MM_S * motor_duty / 100.0 * direction;
+    double travel = travelAt(when);
+    if (belt.back().start == when) {
+        belt.back().speed_mm_s = speed;
+    } else {
+        belt.push_back({when, travel, speed});
+    }
+}
+
+float SimHardware::rangeAt(Clock::TimePoint when) {
+    double travel = travelAt(when);
+    while (first_open < parts.size() &&
+           (parts[first_open].picked || parts[first_open].position_mm + reach_mm <= travel)) {
+        first_open++;
+    }
+    
+    if (std::uniform_real_distribution<float>(0.0f, 1.0f)(rng) < sensor.dropout) {
+        return -1.0f;
+    }
+    
+    // Nearest part in front of the sensor, else the background
+    float range = sensor.background_cm;
+    for (size_t i = first_open; i < parts.size() && parts[i].position_mm <= travel; i++) {
+        if (!parts[i].picked && inReach(parts[i], travel)) {
+            range = std::min(range, parts[i].distance_cm);
+        }
+    }
+    
+    // The physical arm reflects the ping when a link is in the beam
+    float arm = arm_beam_range(servos.estimatePosition(0), servos.estimatePosition(1), servos.estimatePosition(2));
+    if (arm >= 0.0f) {
+        range = std::min(range, arm);
+    }
+    return std::max(0.0f, range + std::normal_distribution<float>(0.0f, sensor.noise_cm)(rng));
+}
+
+void SimHardware::advanceDynamics(Clock::TimePoint until) {
+    if (!dynamics) {
+        return;
+    }
+    
+    // Acceleration-limited slew towards the pulse, plus a damped
+    // second-order link oscillation excited by the joint's acceleration
+    for (; integrated + DYNAMICS_STEP <= until; integrated += DYNAMICS_STEP) {
+        for (int i = 0; i < SERVO_COUNT; i++) {
+            LinkState& link = links[i];
+            const SimJoint& joint = joints[i];
+            float error = commanded[i] - link.position;
+            float brake = std::sqrt(2.0f * joint.accel * std::fabs(error));
+            float desired = (error > 0 ? 1.0f : -1.0f) * std::min(joint.speed, brake);
+            float dv = std::max(-joint.accel * DT, std::min(joint.accel * DT, desired - link.velocity));
+            link.velocity += dv;
+            link.position += link.velocity * DT;
+            if ((error > 0 && link.position > commanded[i]) || (error < 0 && link.position < commanded[i]) ||
+                std::fabs(error) < 1e-3f) {
+                link.position = commanded[i];
+                dv -= link.velocity;
+                link.velocity = 0.0f;
+            }
+            
+            float omega = 2.0f * PI * joint.frequency;
+            float ydd = -2.0f * joint.damping * omega * link.deflection_rate - omega * omega * link.deflection -
+                        coupling * dv / DT;
+            link.deflection_rate += ydd * DT;
+            link.deflection += link.deflection_rate * DT;
+            
+            float angle = link.position + link.deflection;
+            if (angle < MIN_SERVO_ANGLE - 1.0f || angle > MAX_SERVO_ANGLE + 1.0f) {
+                dynamics_report.within_limits = false;
+            }
+        }
+        
+        if (integrated >= carry_from) {
+            dynamics_report.carry_deflection_mm = std::max(dynamics_report.carry_deflection_mm,
+                                                           distance_mm(wristAt(true), wristAt(false)));
+        }
+    }
+}
+
+ArmPoint SimHardware::wristAt(bool deflected) const {
+    float angle[3];
+    for (int i = 0; i < 3; i++) {
+        angle[i] = links[i].position + (deflected ? links[i].deflection : 0.0f);
+    }
+    return arm_forward_kinematics(angle[0], angle[1], angle[2]);
+}
+
+bool SimHardware::inGrabPose(int servo_id, int angle, Clock::TimePoint when) const {
+    return servos.arrivalTime(servo_id) <= when &&
+           std::fabs(commanded[servo_id] - angle) <= POSE_TOLERANCE_DEG;
+}
+
+void SimHardware::gripperClosed(Clock::TimePoint when) {
+    bool in_pose = inGrabPose(1, station.shoulder_grab_angle, when) &&
+                   inGrabPose(2, station.elbow_grab_angle, when);
+    
+    double travel = travelAt(when);
+    for (size_t i = first_open; in_pose && i < parts.size() && parts[i].position_mm <= travel; i++) {
+        if (!parts[i].picked && inReach(parts[i], travel)) {
+            parts[i].picked = true;
+            parts[i].pick_time = when;
+            return;
+        }
+    }
+    empty_grabs++;
+}
+
+void SimHardware::digitalWrite(int pin, int value) {
+    if (pin == MOTOR_DIR1_PIN || pin == MOTOR_DIR2_PIN) {
+        std::lock_guard<std::mutex> lock(mutex);
+        int bit = pin == MOTOR_DIR1_PIN ? 1 : 2;
+        motor_direction_pins = value == HIGH ? (motor_direction_pins | bit) : (motor_direction_pins & ~bit);
+        driveBelt(clock.now());
+        return;
+    }
+    if (pin != ULTRASONIC_TRIG_PIN) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    // Falling edge of the trigger pulse starts a measurement
+    if (trig_level == HIGH && value == LOW) {
+        Clock::TimePoint now = clock.now();
+        float range = rangeAt(now);
+        if (range < 0) {
+            echo_rise = echo_fall = Clock::TimePoint::max();
+        } else {
+            // Round trip at 0.0343 cm/us
+            echo_rise = now + ECHO_DELAY;
+            echo_fall = echo_rise + std::chrono::microseconds(static_cast<long>(range * 2.0f / 0.0343f));
+            clock.scheduleEdge(echo_rise);
+            clock.scheduleEdge(echo_fall);
+        }
+    }
+    trig_level = value;
+}
+
+int SimHardware::digitalRead(int pin) {
+    if (pin != ULTRASONIC_ECHO_PIN) {
+        return LOW;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    Clock::TimePoint now = clock.now();
+    return now >= echo_rise && now < echo_fall ? HIGH : LOW;
+}
+
+void SimHardware::softPwmWrite(int pin, int value) {
+    if (pin == MOTOR_PWM_PIN) {
+        std::lock_guard<std::mutex> lock(mutex);
+        motor_duty = std::max(0, std::min(100, value));
+        driveBelt(clock.now());
+        return;
+    }
+    int servo_id = std::find(servo_pins, servo_pins + SERVO_COUNT, pin) - servo_pins;
+    if (servo_id >= SERVO_COUNT || value == 0) {
+        return; // Not a servo, or the pulse was switched off
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    advanceDynamics(clock.now());
+    
+    // Inverse of ServoControl's pulse mapping (0.5-2.5 ms in 0.1 ms units)
+    float angle = std::max(0.0f, std::min(180.0f, (value - 5) * 9.0f));
+    float previous = commanded[servo_id];
+    commanded[servo_id] = angle;
+    servos.command(servo_id, angle);
+    
+    if (servo_id == 4) {
+        float target = static_cast<float>(station.gripper_closed_angle);
+        bool toward = std::fabs(angle - target) < std::fabs(previous - target);
+        if (toward && !gripper_closing) {
+            // How far the vibrating wrist is from the pose the arm is driven
+            // to as the fingers start moving in
+            dynamics_report.close_error_mm = distance_mm(wristAt(true), arm_forward_kinematics(
+                commanded[0], commanded[1], commanded[2]));
+        }
+        gripper_closing = toward || (gripper_closing && angle == previous);
+        
+        bool closing = std::fabs(angle - target) <= POSE_TOLERANCE_DEG;
+        if (closing && !gripper_closed) {
+            gripperClosed(servos.arrivalTime(servo_id));
+            carry_from = servos.arrivalTime(servo_id);
+        } else if (!closing && gripper_closed) {
+            carry_from = Clock::TimePoint::max();
+        }
+        gripper_closed = closing;
+    }
+}
+
+// Fake wiringPi / softPwm
+
+int wiringPiSetupGpio() {
+    return 0;
+}
+
+void pinMode(int pin, int mode) {
+    (void)pin;
+    (void)mode;
+}
+
+void digitalWrite(int pin, int value) {
+    if (active_hardware) active_hardware->digitalWrite(pin, value);
+}
+
+int digitalRead(int pin) {
+    return active_hardware ? active_hardware->digitalRead(pin) : LOW;
+}
+
+int softPwmCreate(int pin, int initial_value, int pwm_range) {
+    (void)pwm_range;
+    softPwmWrite(pin, initial_value);
+    return 0;
+}
+
+void softPwmWrite(int pin, int value) {
+    if (active_hardware) active_hardware->softPwmWrite(pin, value);
+}
@@ -0,0 +1,158 @@
+#ifndef SIM_HARDWARE_H
+#define SIM_HARDWARE_H
+
+#include <vector>
+#include <random>
+#include <mutex>
+#include "clock.h"
+#include "servo_model.h"
+#include "kinematics.h"
+#include "grab_params.h"
+#include "../include/config.h"
+
+// A part travelling past the sensor on the conveyor
+struct SimPart {
+    double position_mm;         // belt travel at which it reaches the sensor / grab position
+    float distance_cm;          // range seen by the ultrasonic sensor
+    bool picked;
+    Clock::TimePoint pick_time;
+};
+
+// Belt motion from one motor speed change to the next
+struct SimBeltSegment {
+    Clock::TimePoint start;
+    double travel_mm;           // belt travel at start
+    double speed_mm_s;
+};
+
+// Sensor imperfections
+struct SimSensor {
+    float background_cm = 60.0f;  // far side of the conveyor
+    float noise_cm = 0.3f;        // reading standard deviation
+    float dropout = 0.01f;        // probability of a missing echo
+};
+
+// Physical behaviour of one joint for setDynamics()
+struct SimJoint {
+    float speed;       // slew speed, deg/s
+    float accel;       // acceleration limit, deg/s^2
+    float frequency;   // link natural frequency, Hz
+    float damping;     // link damping ratio
+};
+
+// What the joint dynamics did during a pick, for judging the routine
+struct SimDynamicsReport {
+    float close_error_mm;       // wrist off the commanded pose when the gripper started closing
+    float carry_deflection_mm;  // worst link vibration at the wrist while holding the part
+    bool within_limits;         // joints including link deflection stayed in range
+};
+
+// Simulated arm station behind the fake wiringPi/softPwm headers: servos
+// follow the PWM pulses with a slew model, the conveyor moves parts at
+// CONVEYOR_BELT_MM_S times the motor PWM duty, the ultrasonic sensor
+// produces echo edges on the SimClock from the parts in front of it (or
+// from the arm when a link is in the beam), and a part counts as picked
+// when the gripper closes on it while it is within reach and the arm is in
+// the grab pose. Pin access is serialized, so the control and ranging
+// threads may both use it. With setDynamics() the joints also accelerate
+// at a finite rate and their links oscillate when excited, integrated at
+// 1 ms between pin writes, so a routine can be judged on how still the
+// wrist is when it grabs and while it carries the part.
+class SimHardware {
+private:
+    SimClock& clock;
+    std::mutex mutex;
+    GrabParams station;          // grab pose the parts are presented at
+    SimSensor sensor;
+    ServoModel servos;           // the physical servos
+    int servo_pins[SERVO_COUNT];
+    float commanded[SERVO_COUNT];
+    bool gripper_closed;
+    bool gripper_closing;        // last gripper command moved towards closed
+    std::vector<SimPart> parts;  // ordered by position on the belt
+    std::vector<SimBeltSegment> belt;
+    double reach_mm;             // belt travel a part stays within reach
+    int motor_duty;
+    int motor_direction_pins;    // bit 0 = DIR1 high, bit 1 = DIR2 high
+    size_t first_open;           // parts before this have left or been picked
+    int trig_level;
+    Clock::TimePoint echo_rise;
+    Clock::TimePoint echo_fall;
+    int empty_grabs;
+    std::mt19937 rng;
+    
+    // Joint dynamics (setDynamics)
+    struct LinkState {
+        float position;              // servo horn
+        float velocity;
+        float deflection;            // link oscillation on top of the horn
+        float deflection_rate;
+    };
+    bool dynamics;
+    SimJoint joints[SERVO_COUNT];
+    float coupling;                  // joint acceleration -> link deflection gain
+    LinkState links[SERVO_COUNT];
+    Clock::TimePoint integrated;     // dynamics advanced up to here
+    Clock::TimePoint carry_from;     // gripper closed on a part (max while open)
+    SimDynamicsReport dynamics_report;
+    
+    void advanceDynamics(Clock::TimePoint until);
+    ArmPoint wristAt(bool physical) const;
+    
+    float rangeAt(Clock::TimePoint when);
+    void driveBelt(Clock::TimePoint when);
+    bool inReach(const SimPart& part, double travel) const;
+    bool inGrabPose(int servo_id, int angle, Clock::TimePoint when) const;
+    void gripperClosed(Clock::TimePoint when);
+    
+public:
+    SimHardware(SimClock& sim_clock, const GrabParams& grab_pose, const SimSensor& sensor_model,
+                unsigned int seed);
+    
+    // Physical servo speed differing from the controller's model
+    void setServoSpeedScale(float scale);
+    
+    // Simulate acceleration limits and link vibration with these joints
+    // (their speeds replace the servo speed scale); coupling is the link
+    // deflection per unit of joint acceleration
+    void setDynamics(const SimJoint physical[SERVO_COUNT], float coupling_gain);
+    
+    // Nominal joints from include/config.h
+    static void defaultJoints(SimJoint physical[SERVO_COUNT]);
+    
+    // Dynamics since setDynamics(), integrated up to now
+    SimDynamicsReport getDynamics();
+    
+    // Belt travel between a part reaching the grab position and leaving reach
+    void setReach(double reach_mm);
+    
+    // Room for this many belt speed changes, so driving the motor does not
+    // allocate during the run
+    void reserveBelt(size_t changes);
+    
+    // Parts must be added in order of position
+    void addPart(double position_mm, float distance_cm);
+    
+    const std::vector<SimPart>& getParts() const { return parts; }
+    
+    // Belt travel at a time (extrapolated at the current speed beyond now)
+    // and the time a part reached the grab position (max if it has not)
+    double travelAt(Clock::TimePoint when) const;
+    Clock::TimePoint arrivalTime(const SimPart& part) const;
+    
+    // Parts that left reach unpicked before the given time
+    int missedCount(Clock::TimePoint until) const;
+    
+    // Gripper closures with no part in reach
+    int emptyGrabCount() const { return empty_grabs; }
+    
+    // wiringPi / softPwm entry points
+    void digitalWrite(int pin, int value);
+    int digitalRead(int pin);
+    void softPwmWrite(int pin, int value);
+};
+
+// Hardware the fake wiringPi functions act on; nullptr detaches
+void set_sim_hardware(SimHardware* hardware);
+
+#endif // SIM_HARDWARE_H
@@ -0,0 +1,9 @@
+#ifndef SIM_SOFTPWM_H
+#define SIM_SOFTPWM_H
+
+// Stand-in for wiringPi's softPwm used by simulated builds, see sim_hardware.h
+
+int softPwmCreate(int pin, int initial_value, int pwm_range);
+void softPwmWrite(int pin, int value);
+
+#endif // SIM_SOFTPWM_H
@@ -0,0 +1,17 @@
+#ifndef SIM_WIRINGPI_H
+#define SIM_WIRINGPI_H
+
+// Stand-in for wiringPi used by simulated builds (soak benchmark). Pin
+// access is routed to the active SimHardware, see sim_hardware.h.
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0
+#define OUTPUT 1
+
+int wiringPiSetupGpio();
+void pinMode(int pin, int mode);
+void digitalWrite(int pin, int value);
+int digitalRead(int pin);
+
+#endif // SIM_WIRINGPI_H
@@ -0,0 +1,429 @@
+#include "arrow_ipc.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace {
+    const size_t BODY_ALIGNMENT = 64;
+    const int16_t METADATA_V5 = 4;
+    const uint32_t CONTINUATION = 0xFFFFFFFF;
+    
+    // Message header and type union members (Message.fbs, Schema.fbs)
+    const uint8_t HEADER_SCHEMA = 1;
+    const uint8_t HEADER_DICTIONARY_BATCH = 2;
+    const uint8_t HEADER_RECORD_BATCH = 3;
+    const uint8_t TYPE_INT = 2;
+    const uint8_t TYPE_FLOATING_POINT = 3;
+    const uint8_t TYPE_UTF8 = 5;
+    const uint8_t TYPE_TIMESTAMP = 10;
+    
+    // Minimal FlatBuffers encoder that writes front to back: a table comes
+    // before the objects it references, so every offset points forward as
+    // the format requires, and is filled in once the target is written.
+    class FlatWriter {
+    public:
+        std::vector<uint8_t> data;
+        
+        size_t size() const { return data.size(); }
+        
+        void align(size_t alignment) {
+            while (data.size() % alignment) data.push_back(0);
+        }
+        
+        size_t putBytes(const void* bytes, size_t count, size_t alignment) {
+            align(alignment);
+            size_t at = data.size();
+            data.resize(at + count);
+            std::memcpy(&data[at], bytes, count);
+            return at;
+        }
+        
+        template <typename T> size_t put(T value) { return putBytes(&value, sizeof(T), sizeof(T)); }
+        template <typename T> void set(size_t at, T value) { std::memcpy(&data[at], &value, sizeof(T)); }
+        
+        // Fill the offset slot at with the position of target
+        void link(size_t slot, size_t target) { set<uint32_t>(slot, static_cast<uint32_t>(target - slot)); }
+        
+        size_t string(const std::string& text) {
+            size_t at = put<uint32_t>(static_cast<uint32_t>(text.size()));
+            data.insert(data.end(), text.begin(), text.end());
+            data.push_back(0);
+            return at;
+        }
+        
+        // Vector of structs with 8-byte alignment
+        size_t structs(const void* elements, size_t count, size_t element_size) {
+            while ((data.size() + 4) % 8) data.push_back(0);
+            size_t at = put<uint32_t>(static_cast<uint32_t>(count));
+            if (count > 0) putBytes(elements, count * element_size, 1);
+            return at;
+        }
+        
+        // Vector of offsets, filled in with element(at, i) as targets are written
+        size_t offsets(size_t count) {
+            size_t at = put<uint32_t>(static_cast<uint32_t>(count));
+            for (size_t i = 0; i < count; i++) put<uint32_t>(0);
+            return at;
+        }
+        static size_t element(size_t vector, size_t index) { return vector + 4 + 4 * index; }
+    };
+    
+    // A table under construction: scalar fields and offset placeholders by
+    // vtable slot, written with finish()
+    class FlatTable {
+    private:
+        struct Field {
+            int id;
+            size_t size;
+            uint64_t bits;
+            size_t position;
+        };
+        FlatWriter& writer;
+        std::vector<Field> fields;
+    
+    public:
+        explicit FlatTable(FlatWriter& w) : writer(w) {}
+        
+        template <typename T> void add(int id, T value) {
+            Field field = {id, sizeof(T), 0, 0};
+            std::memcpy(&field.bits, &value, sizeof(T));
+            fields.push_back(field);
+        }
+        void addOffset(int id) { add<uint32_t>(id, 0); }
+        
+        size_t finish() {
+            int slots = 0;
+            for (const Field& field : fields) slots = std::max(slots, field.id + 1);
+            
+            size_t vtable = writer.put<uint16_t>(static_cast<uint16_t>(4 + 2 * slots));
+            writer.put<uint16_t>(0);
+            for (int i = 0; i < slots; i++) writer.put<uint16_t>(0);
+            
+            // Widest fields first keeps padding down
+            std::stable_sort(fields.begin(), fields.end(),
+                             [](const Field& a, const Field& b) { return a.size > b.size; });
+            size_t table = writer.put<int32_t>(0);
+            for (Field& field : fields) {
+                field.position = writer.putBytes(&field.bits, field.size, field.size);
+            }
+            writer.set<int32_t>(table, static_cast<int32_t>(table - vtable));
+            writer.set<uint16_t>(vtable + 2, static_cast<uint16_t>(writer.size() - table));
+            for (const Field& field : fields) {
+                writer.set<uint16_t>(vtable + 4 + 2 * field.id, static_cast<uint16_t>(field.position - table));
+            }
+            return table;
+        }
+        
+        size_t slot(int id) const {
+            for (const Field& field : fields) {
+                if (field.id == id) return field.position;
+            }
+            return 0;
+        }
+    };
+    
+    struct FieldNode {
+        int64_t length;
+        int64_t null_count;
+    };
+    
+    struct BufferSpec {
+        int64_t offset;
+        int64_t length;
+    };
+    
+    struct FooterBlock {
+        int64_t offset;
+        int32_t metadata_length;
+        int32_t padding;
+        int64_t body_length;
+    };
+    
+    int64_t align_up(int64_t value, int64_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+    
+    size_t write_int_type(FlatWriter& w, int bits, bool is_signed) {
+        FlatTable type(w);
+        type.add<int32_t>(0, bits);
+        type.add<uint8_t>(1, is_signed ? 1 : 0);
+        return type.finish();
+    }
+    
+    size_t write_field(FlatWriter& w, const ArrowField& field, int64_t dictionary_id) {
+        uint8_t type_type = field.type == ARROW_TIMESTAMP_MS ? TYPE_TIMESTAMP
+                          : field.type == ARROW_FLOAT32 ? TYPE_FLOATING_POINT
+                          : field.type == ARROW_INT32 || field.type == ARROW_UINT8 ? TYPE_INT
+                          : TYPE_UTF8;   // dictionary fields carry the value type
+        bool dictionary = field.type == ARROW_DICTIONARY;
+        
+        FlatTable table(w);
+        table.addOffset(0);   // name
+        table.add<uint8_t>(1, field.nullable ? 1 : 0);
+        table.add<uint8_t>(2, type_type);
+        table.addOffset(3);   // type
+        if (dictionary) table.addOffset(4);
+        table.addOffset(5);   // children
+        size_t at = table.finish();
+        
+        w.link(table.slot(0), w.string(field.name));
+        
+        size_t type;
+        if (field.type == ARROW_TIMESTAMP_MS) {
+            FlatTable timestamp(w);
+            timestamp.add<int16_t>(0, 1);   // MILLISECOND
+            timestamp.addOffset(1);         // timezone
+            type = timestamp.finish();
+            w.link(timestamp.slot(1), w.string("UTC"));
+        } else if (field.type == ARROW_FLOAT32) {
+            FlatTable floating(w);
+            floating.add<int16_t>(0, 1);    // SINGLE
+            type = floating.finish();
+        } else if (field.type == ARROW_INT32) {
+            type = write_int_type(w, 32, true);
+        } else if (field.type == ARROW_UINT8) {
+            type = write_int_type(w, 8, false);
+        } else {
+            FlatTable utf8(w);
+            type = utf8.finish();
+        }
+        w.link(table.slot(3), type);
+        
+        if (dictionary) {
+            FlatTable encoding(w);
+            encoding.add<int64_t>(0, dictionary_id);
+            encoding.addOffset(1);          // index type
+            size_t encoding_at = encoding.finish();
+            w.link(encoding.slot(1), write_int_type(w, 8, true));
+            w.link(table.slot(4), encoding_at);
+        }
+        w.link(table.slot(5), w.offsets(0));
+        return at;
+    }
+    
+    size_t write_schema(FlatWriter& w, const std::vector<ArrowField>& fields) {
+        FlatTable schema(w);
+        schema.add<int16_t>(0, 0);     // little endian
+        schema.addOffset(1);
+        size_t at = schema.finish();
+        
+        size_t vector = w.offsets(fields.size());
+        w.link(schema.slot(1), vector);
+        int64_t dictionary_id = 0;
+        for (size_t i = 0; i < fields.size(); i++) {
+            bool dictionary = fields[i].type == ARROW_DICTIONARY;
+            w.link(FlatWriter::element(vector, i), write_field(w, fields[i], dictionary ? dictionary_id++ : -1));
+        }
+        return at;
+    }
+    
+    size_t write_record_batch(FlatWriter& w, int64_t rows, const std::vector<FieldNode>& nodes,
+                              const std::vector<BufferSpec>& buffers) {
+        FlatTable batch(w);
+        batch.add<int64_t>(0, rows);
+        batch.addOffset(1);
+        batch.addOffset(2);
+        size_t at = batch.finish();
+        w.link(batch.slot(1), w.structs(nodes.data(), nodes.size(), sizeof(FieldNode)));
+        w.link(batch.slot(2), w.structs(buffers.data(), buffers.size(), sizeof(BufferSpec)));
+        return at;
+    }
+    
+    // Message table around a header; returns the finished flatbuffer
+    template <typename WriteHeader>
+    std::vector<uint8_t> build_message(uint8_t header_type, int64_t body_length, WriteHeader write_header) {
+        FlatWriter w;
+        size_t root = w.put<uint32_t>(0);
+        FlatTable message(w);
+        message.add<int16_t>(0, METADATA_V5);
+        message.add<uint8_t>(1, header_type);
+        message.addOffset(2);
+        message.add<int64_t>(3, body_length);
+        size_t at = message.finish();
+        w.link(root, at);
+        w.link(message.slot(2), write_header(w));
+        return w.data;
+    }
+    
+    // Lay out buffers in a body: each starts 64-byte aligned
+    int64_t add_buffer(std::vector<BufferSpec>& buffers, int64_t body_length, int64_t length) {
+        buffers.push_back({body_length, length});
+        return align_up(body_length + length, BODY_ALIGNMENT);
+    }
+}
+
+size_t arrow_value_size(ArrowType type) {
+    switch (type) {
+        case ARROW_TIMESTAMP_MS: return 8;
+        case ARROW_FLOAT32: return 4;
+        case ARROW_INT32: return 4;
+        case ARROW_UINT8: return 1;
+        case ARROW_DICTIONARY: return 1;
+    }
+    return 0;
+}
+
+ArrowFileWriter::ArrowFileWriter() : file(nullptr), position(0), failed(false) {}
+
+ArrowFileWriter::~ArrowFileWriter() {
+    if (file) {
+        std::fclose(file);
+    }
+}
+
+void ArrowFileWriter::write(const void* data, size_t size) {
+    if (size == 0 || failed) return;
+    if (std::fwrite(data, 1, size, file) != size) {
+        failed = true;
+    }
+    position += size;
+}
+
+void ArrowFileWriter::pad(size_t alignment) {
+    static const uint8_t zeros[BODY_ALIGNMENT] = {};
+    size_t remainder = position % alignment;
+    if (remainder) write(zeros, alignment - remainder);
+}
+
+ArrowFileWriter::Block ArrowFileWriter::writeMessage(const std::vector<uint8_t>& metadata, int64_t body_length) {
+    Block block;
+    block.offset = position;
+    // Pad the metadata so the body starts 64-byte aligned in the file
+    int64_t end = align_up(position + 8 + static_cast<int64_t>(metadata.size()), BODY_ALIGNMENT);
+    int32_t length = static_cast<int32_t>(end - position - 8);
+    write(&CONTINUATION, 4);
+    write(&length, 4);
+    write(metadata.data(), metadata.size());
+    pad(BODY_ALIGNMENT);
+    block.metadata_length = static_cast<int32_t>(position - block.offset);
+    block.body_length = body_length;
+    return block;
+}
+
+bool ArrowFileWriter::open(const std::string& file_path, const std::vector<ArrowField>& schema) {
+    path = file_path;
+    fields = schema;
+    file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Failed to create " << path << std::endl;
+        return false;
+    }
+    position = 0;
+    failed = false;
+    dictionary_blocks.clear();
+    batch_blocks.clear();
+    
+    write("ARROW1\0\0", 8);
+    writeMessage(build_message(HEADER_SCHEMA, 0,
+                               [this](FlatWriter& w) { return write_schema(w, fields); }), 0);
+    
+    // One dictionary batch per dictionary field, in schema order (= id)
+    int64_t dictionary_id = 0;
+    for (const ArrowField& field : fields) {
+        if (field.type != ARROW_DICTIONARY) continue;
+        
+        std::vector<int32_t> offsets(1, 0);
+        std::string values;
+        for (const std::string& value : field.dictionary) {
+            values += value;
+            offsets.push_back(static_cast<int32_t>(values.size()));
+        }
+        int64_t count = static_cast<int64_t>(field.dictionary.size());
+        std::vector<FieldNode> nodes = {{count, 0}};
+        std::vector<BufferSpec> buffers;
+        int64_t body_length = add_buffer(buffers, 0, 0);   // no nulls
+        body_length = add_buffer(buffers, body_length, static_cast<int64_t>(offsets.size() * 4));
+        body_length = add_buffer(buffers, body_length, static_cast<int64_t>(values.size()));
+        
+        int64_t id = dictionary_id++;
+        Block block = writeMessage(build_message(HEADER_DICTIONARY_BATCH, body_length, [&](FlatWriter& w) {
+            FlatTable batch(w);
+            batch.add<int64_t>(0, id);
+            batch.addOffset(1);
+            size_t at = batch.finish();
+            w.link(batch.slot(1), write_record_batch(w, count, nodes, buffers));
+            return at;
+        }), body_length);
+        write(offsets.data(), offsets.size() * 4);
+        pad(BODY_ALIGNMENT);
+        write(values.data(), values.size());
+        pad(BODY_ALIGNMENT);
+        dictionary_blocks.push_back(block);
+    }
+    return !failed;
+}
+
+bool ArrowFileWriter::writeBatch(int64_t rows, const std::vector<ArrowColumn>& columns) {
+    if (!file || columns.size() != fields.size()) {
+        return false;
+    }
+    
+    std::vector<FieldNode> nodes;
+    std::vector<BufferSpec> buffers;
+    int64_t body_length = 0;
+    for (size_t i = 0; i < columns.size(); i++) {
+        bool nulls = columns[i].validity && columns[i].null_count > 0;
+        nodes.push_back({rows, nulls ? columns[i].null_count : 0});
+        body_length = add_buffer(buffers, body_length, nulls ? (rows + 7) / 8 : 0);
+        body_length = add_buffer(buffers, body_length, rows * static_cast<int64_t>(arrow_value_size(fields[i].type)));
+    }
+    
+    Block block = writeMessage(build_message(HEADER_RECORD_BATCH, body_length, [&](FlatWriter& w) {
+        return write_record_batch(w, rows, nodes, buffers);
+    }), body_length);
+    
+    // Buffers go out straight from the caller's columns
+    for (size_t i = 0; i < columns.size(); i++) {
+        const BufferSpec& validity = buffers[2 * i];
+        const BufferSpec& values = buffers[2 * i + 1];
+        write(columns[i].validity, static_cast<size_t>(validity.length));
+        pad(BODY_ALIGNMENT);
+        write(columns[i].values, static_cast<size_t>(values.length));
+        pad(BODY_ALIGNMENT);
+    }
+    batch_blocks.push_back(block);
+    return !failed;
+}
+
+bool ArrowFileWriter::close() {
+    if (!file) {
+        return false;
+    }
+    
+    // End-of-stream marker, then the footer indexing every message
+    const uint32_t end_of_stream[2] = {CONTINUATION, 0};
+    write(end_of_stream, sizeof(end_of_stream));
+    
+    std::vector<FooterBlock> dictionaries, batches;
+    for (const Block& block : dictionary_blocks) {
+        dictionaries.push_back({block.offset, block.metadata_length, 0, block.body_length});
+    }
+    for (const Block& block : batch_blocks) {
+        batches.push_back({block.offset, block.metadata_length, 0, block.body_length});
+    }
+    
+    FlatWriter w;
+    size_t root = w.put<uint32_t>(0);
+    FlatTable footer(w);
+    footer.add<int16_t>(0, METADATA_V5);
+    footer.addOffset(1);
+    footer.addOffset(2);
+    footer.addOffset(3);
+    size_t at = footer.finish();
+    w.link(root, at);
+    w.link(footer.slot(1), write_schema(w, fields));
+    w.link(footer.slot(2), w.structs(dictionaries.data(), dictionaries.size(), sizeof(FooterBlock)));
+    w.link(footer.slot(3), w.structs(batches.data(), batches.size(), sizeof(FooterBlock)));
+    
+    int32_t footer_length = static_cast<int32_t>(w.size());
+    write(w.data.data(), w.size());
+    write(&footer_length, 4);
+    write("ARROW1", 6);
+    
+    bool ok = !failed && std::fclose(file) == 0;
+    file = nullptr;
+    if (!ok) {
+        std::cerr << "Failed to write " << path << std::endl;
+    }
+    return ok;
+}
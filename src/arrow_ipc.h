@@ -0,0 +1,84 @@
+#ifndef ARROW_IPC_H
+#define ARROW_IPC_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Writer for the Apache Arrow IPC file format (Feather v2), covering what
+// telemetry export needs: fixed-width columns and int8 dictionary-encoded
+// strings. Column buffers are written straight from the caller's memory,
+// 64-byte aligned, so pyarrow, pandas.read_feather and polars can
+// memory-map the file and use the columns in place.
+
+enum ArrowType {
+    ARROW_TIMESTAMP_MS,   // int64 milliseconds since the epoch, UTC
+    ARROW_FLOAT32,
+    ARROW_INT32,
+    ARROW_UINT8,
+    ARROW_DICTIONARY      // int8 indices into the field's dictionary (utf8)
+};
+
+struct ArrowField {
+    std::string name;
+    ArrowType type;
+    bool nullable;
+    std::vector<std::string> dictionary;   // ARROW_DICTIONARY values
+};
+
+// One column of a record batch, borrowed for the duration of writeBatch()
+struct ArrowColumn {
+    const void* values;
+    const uint8_t* validity;   // LSB-first bitmap, nullptr when nothing is null
+    int64_t null_count;
+};
+
+class ArrowFileWriter {
+private:
+    // Location of a message in the file, for the footer
+    struct Block {
+        int64_t offset;
+        int32_t metadata_length;
+        int64_t body_length;
+    };
+    
+    FILE* file;
+    std::string path;
+    std::vector<ArrowField> fields;
+    std::vector<Block> dictionary_blocks;
+    std::vector<Block> batch_blocks;
+    int64_t position;
+    bool failed;
+    
+    void write(const void* data, size_t size);
+    void pad(size_t alignment);
+    
+    // Encapsulated message: continuation marker, metadata length, metadata,
+    // then the body buffers
+    Block writeMessage(const std::vector<uint8_t>& metadata, int64_t body_length);
+
+public:
+    ArrowFileWriter();
+    ~ArrowFileWriter();
+    
+    ArrowFileWriter(const ArrowFileWriter&) = delete;
+    ArrowFileWriter& operator=(const ArrowFileWriter&) = delete;
+    
+    // Create the file and write the schema and dictionaries
+    bool open(const std::string& file_path, const std::vector<ArrowField>& schema);
+    
+    // Append a record batch; columns in schema order, each with rows values
+    bool writeBatch(int64_t rows, const std::vector<ArrowColumn>& columns);
+    
+    // Write the footer and close; the file is only readable after this
+    bool close();
+    
+    int64_t getBytesWritten() const { return position; }
+    int getBatchCount() const { return static_cast<int>(batch_blocks.size()); }
+};
+
+// Width in bytes of one value of a column type
+size_t arrow_value_size(ArrowType type);
+
+#endif // ARROW_IPC_H
@@ -0,0 +1,165 @@
+#include "auto_controller.h"
+#include "servo_control.h"
+#include "sensor_ultrasonic.h"
+#include "grab_params.h"
+#include "clock.h"
+#include "flight_recorder.h"
+#include "metrics.h"
+#include "../include/config.h"
+#include <iostream>
+
+namespace {
+    MetricCounter& grabs_success = metrics().counter("smartarm_grabs_total", "Grab cycles by outcome",
+                                                     "result=\"success\"");
+    MetricCounter& grabs_failed = metrics().counter("smartarm_grabs_total", "Grab cycles by outcome",
+                                                    "result=\"failed\"");
+    MetricHistogram& grab_seconds = metrics().histogram("smartarm_grab_cycle_seconds", "Grab routine duration",
+                                                        {0.5, 1.0, 1.5, 2.0, 2.5, 3.0, 4.0, 5.0, 8.0});
+}
+
+AutoController::AutoController(ServoControl& servo_control, UltrasonicSensor& ultrasonic,
+                               const GrabParams& grab_params) :
+    servo(servo_control),
+    params(grab_params),
+    runner(servo_control),
+    monitor(ultrasonic, servo_control),
+    conveyor(servo_control),
+    detect_phase(-1),
+    cooldown_phase(-1),
+    action_phase(-1),
+    close_action(-1),
+    prepared(false) {
+}
+
+void AutoController::prepare() {
+    routine = build_grab_routine(params);
+    runner.reserve(routine.getActions().size(), cycle.report);
+    
+    profiler.clear();
+    detect_phase = profiler.addPhase("detect");
+    action_phase = profiler.getPhaseCount();
+    for (const MotionAction& action : routine.getActions()) {
+        profiler.addPhase(action.name);
+    }
+    cooldown_phase = profiler.addPhase("cooldown");
+    
+    // Until a grab has been timed the belt is held for the whole routine
+    close_action = -1;
+    for (size_t i = 0; i < routine.getActions().size(); i++) {
+        if (routine.getActions()[i].name == "close_gripper") {
+            close_action = static_cast<int>(i);
+        }
+    }
+    runner.estimate(routine, cycle.report);
+    conveyor.setCloseTime(cycle.report.estimated);
+    prepared = true;
+}
+
+void AutoController::profileRoutine() {
+    const RoutineReport& report = cycle.report;
+    int n = static_cast<int>(report.action_finish.size());
+    
+    // Critical actions are charged the time from the previous critical
+    // action's finish to their own; the rest overlap and cost nothing
+    long previous_finish = 0;
+    size_t next_critical = 0;
+    for (int i = 0; i < n; i++) {
+        if (report.action_start[i].count() < 0 || report.action_finish[i].count() < 0) continue;
+        double critical_ms = 0.0;
+        if (next_critical < report.critical_path.size() && report.critical_path[next_critical] == i) {
+            critical_ms = static_cast<double>(report.action_finish[i].count() - previous_finish);
+            previous_finish = report.action_finish[i].count();
+            next_critical++;
+        }
+        double run_ms = static_cast<double>((report.action_finish[i] - report.action_start[i]).count());
+        profiler.record(action_phase + i, run_ms, critical_ms);
+    }
+}
+
+bool AutoController::start() {
+    return monitor.start();
+}
+
+void AutoController::stop() {
+    monitor.stop();
+    conveyor.release();
+}
+
+void AutoController::suspend() {
+    monitor.resumeSlow();
+    conveyor.release();
+}
+
+void AutoController::releaseSensor() {
+    monitor.pause();
+}
+
+const AutoCycle& AutoController::poll(Clock::TimePoint deadline) {
+    if (!prepared) {
+        prepare();
+    }
+    monitor.resume();
+    conveyor.engage();
+    
+    cycle.grabbed = false;
+    cycle.report.success = false;
+    Clock::TimePoint seen;
+    if (!monitor.waitForTarget(deadline, cycle.distance, seen)) {
+        cycle.distance = monitor.getLastDistance();
+        return cycle;
+    }
+    
+    // Object detected within range - perform grab sequence. Ranging goes
+    // on and discards the readings in which the arm blocks the beam.
+    std::cout << "Object detected at " << cycle.distance << "cm - executing grab sequence" << std::endl;
+    
+    profiler.beginCycle();
+    double detect_ms = std::chrono::duration<double, std::milli>(arm_clock().now() - seen).count();
+    profiler.record(detect_phase, detect_ms, detect_ms);
+    Clock::TimePoint occupied;
+    if (monitor.occupiedSince(occupied) && occupied < seen) {
+        seen = occupied; // It may have been behind the last part all along
+    }
+    conveyor.partSeen(seen, arm_clock().now());
+    runner.run(routine, cycle.report);
+    cycle.grabbed = true;
+    
+    // The routine ends with the lift, so the gripper is clear of the belt
+    std::chrono::milliseconds closed = cycle.report.actual;
+    if (close_action >= 0 && cycle.report.action_finish[close_action].count() >= 0) {
+        closed = cycle.report.action_finish[close_action];
+    }
+    conveyor.gripperCleared(closed);
+    profileRoutine();
+    flight_record(FLIGHT_EVENT, FLIGHT_EVENT_GRAB, static_cast<int>(cycle.report.actual.count()),
+                  cycle.distance, cycle.report.success ? 1.0f : 0.0f);
+    (cycle.report.success ? grabs_success : grabs_failed).inc();
+    grab_seconds.observe(std::chrono::duration<double>(cycle.report.actual).count());
+    
+    std::cout << "Grab cycle " << cycle.report.actual.count() << " ms (critical path estimate "
+              << cycle.report.estimated.count() << " ms:";
+    for (int index : cycle.report.critical_path) {
+        std::cout << " " << routine.getActions()[index].name;
+    }
+    std::cout << ")" << std::endl;
+    
+    std::cout << "Grab sequence completed" << std::endl;
+    
+    // Wait before next detection. A part left in the zone or arriving
+    // meanwhile is held on the belt for the grab that follows; the zone
+    // first needs a few pings with the arm out of the beam to read clear.
+    auto cooldown_start = arm_clock().now();
+    auto cooldown_end = cooldown_start + std::chrono::milliseconds(params.cooldown_ms);
+    arm_clock().sleepUntil(std::min(cooldown_end,
+                                    cooldown_start + std::chrono::milliseconds(RANGE_PING_MS * (AUTO_EXIT_SAMPLES + 1))));
+    Clock::TimePoint next_seen;
+    if (monitor.occupiedSince(next_seen) || monitor.waitForEntry(cooldown_end, next_seen)) {
+        conveyor.partSeen(next_seen, cooldown_end);
+    }
+    arm_clock().sleepUntil(cooldown_end);
+    double cooldown_ms = std::chrono::duration<double, std::milli>(arm_clock().now() - cooldown_start).count();
+    profiler.record(cooldown_phase, cooldown_ms, cooldown_ms);
+    profiler.endCycle(cycle.report.success);
+    monitor.rearm(); // A part that arrived meanwhile is picked next, without waiting to see it again
+    return cycle;
+}
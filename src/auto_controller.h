@@ -0,0 +1,80 @@
+#ifndef AUTO_CONTROLLER_H
+#define AUTO_CONTROLLER_H
+
+#include "routine_runner.h"
+#include "motion_routine.h"
+#include "cycle_profiler.h"
+#include "range_monitor.h"
+#include "conveyor_coordinator.h"
+#include "clock.h"
+
+class ServoControl;
+class UltrasonicSensor;
+struct GrabParams;
+
+// Outcome of one auto-mode poll
+struct AutoCycle {
+    bool grabbed;           // a part was detected and the grab routine ran
+    float distance;         // reading that raised the event, else the last reading (cm, -1 for none)
+    RoutineReport report;   // valid when grabbed
+};
+
+// Automatic pick logic: a RangeMonitor watches the conveyor and the grab
+// routine runs as soon as it reports a part within reach, while a
+// ConveyorCoordinator holds the belt back only as far as the grab needs.
+// Shared by the controller's main loop and the soak benchmark, so both
+// exercise the same code.
+class AutoController {
+private:
+    ServoControl& servo;
+    const GrabParams& params;
+    RoutineRunner runner;
+    RangeMonitor monitor;
+    ConveyorCoordinator conveyor;
+    MotionRoutine routine;
+    AutoCycle cycle;
+    CycleProfiler profiler;
+    int detect_phase;
+    int cooldown_phase;
+    int action_phase;      // first routine action; actions follow in order
+    int close_action;      // routine action that closes the gripper on the part
+    bool prepared;
+    
+    // Attribute the routine's actions to the profiler along the critical path
+    void profileRoutine();
+    
+public:
+    AutoController(ServoControl& servo_control, UltrasonicSensor& ultrasonic, const GrabParams& grab_params);
+    
+    // Build the grab routine and preallocate run state; call after the grab
+    // parameters are loaded and again whenever they change
+    void prepare();
+    
+    // Start and stop the ranging thread (the sensor belongs to it while
+    // auto mode is polled)
+    bool start();
+    void stop();
+    
+    // Leave auto mode: stop the belt and switch the ranging thread to slow
+    // manual-mode readings. The next poll() resumes both.
+    void suspend();
+    
+    // Stop ranging so others may use the sensor (until the next suspend()
+    // or poll())
+    void releaseSensor();
+    
+    // Sleep until a part enters the detection zone or the deadline passes.
+    // On a detection run the grab routine, then cool down before the next.
+    const AutoCycle& poll(Clock::TimePoint deadline);
+    
+    // Return from a poll() that is waiting for a part (e.g. on a mode change)
+    void wake() { monitor.interrupt(); }
+    
+    const RangeMonitor& getMonitor() const { return monitor; }
+    ConveyorCoordinator& getConveyor() { return conveyor; }
+    
+    // Phase timing of the grab cycles run so far (reset by prepare())
+    const CycleProfiler& getProfiler() const { return profiler; }
+};
+
+#endif // AUTO_CONTROLLER_H
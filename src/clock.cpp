@@ -0,0 +1,154 @@
+#include "clock.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace {
+    const std::chrono::milliseconds SPIN_QUANTUM(1);  // busy-wait step without a scheduled edge
+    const size_t WAKEUP_SLOTS = 32;                  // blocked threads before the queue grows
+    const size_t EDGE_SLOTS = 256;                   // pending hardware edges before it grows
+    
+    SystemClock system_clock;
+    std::atomic<Clock*> active_clock(&system_clock);
+}
+
+Clock& arm_clock() {
+    return *active_clock.load(std::memory_order_acquire);
+}
+
+void set_arm_clock(Clock* clock) {
+    active_clock.store(clock ? clock : &system_clock, std::memory_order_release);
+}
+
+Clock::TimePoint SystemClock::now() {
+    return std::chrono::steady_clock::now();
+}
+
+void SystemClock::sleepUntil(TimePoint when) {
+    std::this_thread::sleep_until(when);
+}
+
+bool SystemClock::waitUntil(std::condition_variable& cv, std::unique_lock<std::mutex>& lock,
+                            TimePoint deadline, const std::function<bool()>& pred) {
+    return cv.wait_until(lock, deadline, pred);
+}
+
+void SystemClock::notifyAll(std::condition_variable& cv) {
+    cv.notify_all();
+}
+
+SimClock::SimClock(TimePoint start) :
+    current(start),
+    participants(1),
+    waiting(0),
+    condition_waiters(0),
+    notifications(0) {
+    wakeups.reserve(WAKEUP_SLOTS);
+    edges.reserve(EDGE_SLOTS);
+}
+
+void SimClock::advanceIfIdle() {
+    if (waiting < participants || wakeups.empty()) {
+        return;
+    }
+    TimePoint next = *std::min_element(wakeups.begin(), wakeups.end());
+    if (next > current) {
+        current = next;
+    }
+    edges.erase(edges.begin(), std::upper_bound(edges.begin(), edges.end(), current));
+    changed.notify_all();
+}
+
+Clock::TimePoint SimClock::now() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return current;
+}
+
+void SimClock::sleepUntil(TimePoint when) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (when <= current) {
+        return;
+    }
+    
+    wakeups.push_back(when);
+    waiting++;
+    advanceIfIdle();
+    changed.wait(lock, [&]() { return current >= when; });
+    waiting--;
+    wakeups.erase(std::find(wakeups.begin(), wakeups.end(), when));
+}
+
+bool SimClock::waitUntil(std::condition_variable& cv, std::unique_lock<std::mutex>& lock,
+                         TimePoint deadline, const std::function<bool()>& pred) {
+    (void)cv; // Waiters block on the clock; notifyAll() wakes them through it
+    
+    while (!pred()) {
+        std::unique_lock<std::mutex> clock_lock(mutex);
+        if (current >= deadline) {
+            return false;
+        }
+        
+        // Read the notification count before releasing the caller's lock so
+        // a notify between the predicate check and the wait is not lost
+        unsigned long seen = notifications;
+        lock.unlock();
+        
+        wakeups.push_back(deadline);
+        waiting++;
+        condition_waiters++;
+        advanceIfIdle();
+        changed.wait(clock_lock, [&]() { return current >= deadline || notifications != seen; });
+        if (notifications == seen) {
+            // Timed out; a notification would already have un-counted us
+            waiting--;
+            condition_waiters--;
+        }
+        wakeups.erase(std::find(wakeups.begin(), wakeups.end(), deadline));
+        
+        clock_lock.unlock();
+        lock.lock();
+    }
+    return true;
+}
+
+void SimClock::notifyAll(std::condition_variable& cv) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        // Notified waiters are runnable from now on, so time must not
+        // advance past them before they get to run
+        waiting -= condition_waiters;
+        condition_waiters = 0;
+        notifications++;
+        changed.notify_all();
+    }
+    cv.notify_all();
+}
+
+void SimClock::spinPause() {
+    TimePoint target;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto edge = std::upper_bound(edges.begin(), edges.end(), current);
+        target = edge != edges.end() ? std::min(*edge, current + SPIN_QUANTUM) : current + SPIN_QUANTUM;
+    }
+    sleepUntil(target);
+}
+
+void SimClock::scheduleEdge(TimePoint when) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto slot = std::lower_bound(edges.begin(), edges.end(), when);
+    if (slot == edges.end() || *slot != when) {
+        edges.insert(slot, when);
+    }
+}
+
+void SimClock::attach() {
+    std::lock_guard<std::mutex> lock(mutex);
+    participants++;
+}
+
+void SimClock::detach() {
+    std::lock_guard<std::mutex> lock(mutex);
+    participants--;
+    advanceIfIdle();
+}
@@ -0,0 +1,94 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <vector>
+
+// Clock and timer service. Every timing decision in the controller goes
+// through arm_clock(), so a simulated clock can replace wall time and run
+// soak tests faster than real time.
+class Clock {
+public:
+    typedef std::chrono::steady_clock::time_point TimePoint;
+    typedef std::chrono::steady_clock::duration Duration;
+    
+    virtual ~Clock() {}
+    
+    virtual TimePoint now() = 0;
+    virtual void sleepUntil(TimePoint when) = 0;
+    void sleepFor(Duration duration) { sleepUntil(now() + duration); }
+    
+    // Wait on a condition variable until pred() holds or the deadline passes.
+    // Use notifyAll() on the same variable to wake waiters.
+    virtual bool waitUntil(std::condition_variable& cv, std::unique_lock<std::mutex>& lock,
+                           TimePoint deadline, const std::function<bool()>& pred) = 0;
+    virtual void notifyAll(std::condition_variable& cv) = 0;
+    
+    // Called on every iteration of a busy-wait loop
+    virtual void spinPause() {}
+    
+    // Register a thread that will block on the clock (call before starting
+    // it) and unregister it when it finishes; only simulated time cares
+    virtual void attach() {}
+    virtual void detach() {}
+};
+
+// Wall time: std::chrono::steady_clock and real sleeps
+class SystemClock : public Clock {
+public:
+    TimePoint now() override;
+    void sleepUntil(TimePoint when) override;
+    bool waitUntil(std::condition_variable& cv, std::unique_lock<std::mutex>& lock,
+                   TimePoint deadline, const std::function<bool()>& pred) override;
+    void notifyAll(std::condition_variable& cv) override;
+};
+
+// Discrete-event virtual time. Time only moves when every participating
+// thread is blocked in the clock; it then jumps straight to the earliest
+// wake-up. The creating thread participates; other threads that sleep on
+// the clock must attach() (and detach() when they finish), and must not
+// block anywhere else for long or virtual time stalls. Both queues are
+// reserved up front so that, like the system clock, it does not allocate
+// in steady state (the soak benchmark checks the poll for allocations).
+class SimClock : public Clock {
+private:
+    std::mutex mutex;
+    std::condition_variable changed;
+    TimePoint current;
+    int participants;
+    int waiting;                        // blocked participants, excluding notified ones
+    int condition_waiters;              // of those, blocked in waitUntil()
+    unsigned long notifications;
+    std::vector<TimePoint> wakeups;     // deadlines of blocked threads, unordered
+    std::vector<TimePoint> edges;       // hardware events for spinPause(), sorted
+    
+    // With the mutex held: advance if everyone is blocked
+    void advanceIfIdle();
+    
+public:
+    explicit SimClock(TimePoint start = TimePoint(std::chrono::hours(1)));
+    
+    TimePoint now() override;
+    void sleepUntil(TimePoint when) override;
+    bool waitUntil(std::condition_variable& cv, std::unique_lock<std::mutex>& lock,
+                   TimePoint deadline, const std::function<bool()>& pred) override;
+    void notifyAll(std::condition_variable& cv) override;
+    
+    // Busy-wait loops jump to the next scheduled hardware edge
+    void spinPause() override;
+    void scheduleEdge(TimePoint when);
+    
+    void attach() override;
+    void detach() override;
+};
+
+// Current clock (SystemClock unless replaced)
+Clock& arm_clock();
+
+// Replace the clock; nullptr restores the system clock
+void set_arm_clock(Clock* clock);
+
+#endif // CLOCK_H
@@ -0,0 +1,138 @@
+#include "conveyor_coordinator.h"
+#include "servo_control.h"
+#include "flight_recorder.h"
+#include "metrics.h"
+#include <algorithm>
+#include <iostream>
+
+// Motor driver interface (driver_motor.cpp)
+extern "C" {
+    void motor_set_speed(int speed);
+    int motor_get_speed();
+}
+
+namespace {
+    MetricCounter& belt_slowdowns = metrics().counter("smartarm_conveyor_holds_total",
+                                                      "Belt slowed or stopped to keep a part in reach",
+                                                      "action=\"slow\"");
+    MetricCounter& belt_stops = metrics().counter("smartarm_conveyor_holds_total",
+                                                  "Belt slowed or stopped to keep a part in reach",
+                                                  "action=\"stop\"");
+    
+    float belt_mm(int speed, Clock::Duration time) {
+        return CONVEYOR_BELT_MM_S * speed / 100.0f * std::chrono::duration<float>(time).count();
+    }
+}
+
+ConveyorCoordinator::ConveyorCoordinator(ServoControl& servo_control) :
+    servo(servo_control),
+    engaged(false),
+    halted(false),
+    coordinated(true),
+    run_speed(CONVEYOR_RUN_SPEED),
+    head(0),
+    count(0),
+    close_time(Clock::Duration::zero()),
+    slowdowns(0),
+    stops(0) {
+}
+
+void ConveyorCoordinator::drive(int speed, Clock::TimePoint now) {
+    if (count > 0 && history[head].speed == speed && motor_get_speed() == speed) {
+        return;
+    }
+    motor_set_speed(speed);
+    servo.getBudget().setMotorSpeed(speed);
+    flight_record(FLIGHT_EVENT, FLIGHT_EVENT_CONVEYOR, speed);
+    
+    head = (head + 1) % CONVEYOR_HISTORY;
+    history[head] = { now, speed };
+    count = std::min(count + 1, CONVEYOR_HISTORY);
+}
+
+void ConveyorCoordinator::adjust(int speed, Clock::TimePoint now) {
+    if (!coordinated) {
+        engaged = false;
+        return;
+    }
+    if (count > 0 && motor_get_speed() != history[head].speed) {
+        // Emergency stop or manual override: leave the belt alone
+        engaged = false;
+        halted = true;
+        std::cout << "Conveyor taken over, coordination halted" << std::endl;
+        return;
+    }
+    drive(speed, now);
+}
+
+float ConveyorCoordinator::travelSince(Clock::TimePoint since, Clock::TimePoint now) const {
+    float travel = 0.0f;
+    Clock::TimePoint end = now;
+    for (int i = 0; i < count && end > since; i++) {
+        const SpeedChange& change = history[(head - i + CONVEYOR_HISTORY) % CONVEYOR_HISTORY];
+        Clock::TimePoint begin = std::max(change.when, since);
+        if (begin < end) {
+            travel += belt_mm(std::abs(change.speed), end - begin);
+        }
+        end = change.when;
+    }
+    if (end > since) {
+        travel += belt_mm(100, end - since); // Older than the history: assume full speed
+    }
+    return travel;
+}
+
+void ConveyorCoordinator::engage() {
+    if (engaged || halted || !coordinated) return;
+    engaged = true;
+    drive(run_speed.load(), arm_clock().now());
+    std::cout << "Conveyor coordinated at speed " << run_speed.load() << std::endl;
+}
+
+void ConveyorCoordinator::release() {
+    if (engaged) {
+        adjust(0, arm_clock().now());
+    }
+    engaged = false;
+    halted = false;
+}
+
+void ConveyorCoordinator::setRunSpeed(int speed) {
+    run_speed = std::max(0, std::min(100, speed));
+}
+
+void ConveyorCoordinator::partSeen(Clock::TimePoint seen, Clock::TimePoint grab_start) {
+    if (!engaged || count == 0) return;
+    
+    Clock::TimePoint now = arm_clock().now();
+    int speed = history[head].speed;
+    float remaining = CONVEYOR_REACH_MM - CONVEYOR_MARGIN_MM - travelSince(seen, now);
+    Clock::TimePoint close_at = std::max(now, grab_start + close_time);
+    float seconds = std::chrono::duration<float>(close_at - now).count();
+    
+    // Fastest speed that still has the part in reach when the gripper closes
+    int fits = 0;
+    if (remaining > 0.0f) {
+        fits = seconds > 0.0f ? static_cast<int>(remaining / seconds / CONVEYOR_BELT_MM_S * 100.0f) : 100;
+    }
+    if (fits >= speed) {
+        return;
+    }
+    if (fits < CONVEYOR_MIN_SPEED) {
+        fits = 0;
+        stops++;
+        belt_stops.inc();
+    } else {
+        slowdowns++;
+        belt_slowdowns.inc();
+    }
+    adjust(fits, now);
+}
+
+void ConveyorCoordinator::gripperCleared(Clock::Duration measured) {
+    // Follow slower grabs at once and faster ones gradually
+    close_time = std::max(measured, (close_time * 4 + measured) / 5);
+    if (engaged) {
+        adjust(run_speed.load(), arm_clock().now());
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef CONVEYOR_COORDINATOR_H
+#define CONVEYOR_COORDINATOR_H
+
+#include <atomic>
+#include "clock.h"
+#include "../include/config.h"
+
+class ServoControl;
+
+// Ties the conveyor to the pick cycle in auto mode. The belt runs at the
+// run speed until a part is seen; from then on it moves only as fast as
+// keeps that part within reach until the gripper is expected to close on
+// it, which is a stop when the arm is busy and no change at all when the
+// grab will be in time anyway. Once the gripper has cleared the belt it
+// goes back to the run speed.
+//
+// Travel is estimated from the commanded speeds (CONVEYOR_BELT_MM_S at
+// motor speed 100), so a part seen before the last few speed changes is
+// placed conservatively.
+class ConveyorCoordinator {
+private:
+    struct SpeedChange {
+        Clock::TimePoint when;
+        int speed;
+    };
+    
+    ServoControl& servo;
+    bool engaged;                      // the coordinator owns the motor
+    bool halted;                       // stopped from outside (STOP) until auto mode is left
+    std::atomic<bool> coordinated;     // off: the belt is left to MOTOR commands
+    std::atomic<int> run_speed;        // set from the command thread
+    SpeedChange history[CONVEYOR_HISTORY];   // ring, newest at head
+    int head;
+    int count;
+    Clock::Duration close_time;        // grab start to gripper closed
+    unsigned long slowdowns;
+    unsigned long stops;
+    
+    void drive(int speed, Clock::TimePoint now);
+    
+    // Change speed unless someone else has taken the motor since
+    void adjust(int speed, Clock::TimePoint now);
+    
+    // Belt travel (mm) from since to now by the commanded speed history
+    float travelSince(Clock::TimePoint since, Clock::TimePoint now) const;
+    
+public:
+    explicit ConveyorCoordinator(ServoControl& servo_control);
+    
+    // Take the belt over at the run speed; release() leaves it stopped.
+    // After the belt was stopped from outside, engage() does nothing until
+    // release().
+    void engage();
+    void release();
+    bool isEngaged() const { return engaged; }
+    
+    // Switch coordination off to run the belt by hand in auto mode too; it
+    // takes effect at the next speed change and leaves the belt running
+    void setCoordinated(bool enable) { coordinated = enable; }
+    bool isCoordinated() const { return coordinated.load(); }
+    
+    // Motor speed used while no part needs holding (0-100)
+    void setRunSpeed(int speed);
+    int getRunSpeed() const { return run_speed.load(); }
+    
+    // A part was first seen at `seen` and the gripper may close on it no
+    // earlier than `grab_start` plus the learned close time: slow or stop
+    // the belt if it would otherwise carry the part out of reach
+    void partSeen(Clock::TimePoint seen, Clock::TimePoint grab_start);
+    
+    // The gripper is off the belt; measured is the time from grab start
+    // to the gripper closing in the cycle just run
+    void gripperCleared(Clock::Duration measured);
+    
+    // Learned grab start to gripper close time
+    Clock::Duration getCloseTime() const { return close_time; }
+    void setCloseTime(Clock::Duration estimate) { close_time = estimate; }
+    
+    unsigned long getSlowdowns() const { return slowdowns; }
+    unsigned long getStops() const { return stops; }
+};
+
+#endif // CONVEYOR_COORDINATOR_H
@@ -0,0 +1,211 @@
+#include "current_budget.h"
+#include "kinematics.h"
+#include "flight_recorder.h"
+#include "metrics.h"
+#include <cmath>
+#include <algorithm>
+
+namespace {
+    const float HOLD_CURRENT[SERVO_COUNT] = SERVO_HOLD_CURRENT_MA;
+    const float MOVE_CURRENT[SERVO_COUNT] = SERVO_MOVE_CURRENT_MA;
+    const float STALL_CURRENT[SERVO_COUNT] = SERVO_STALL_CURRENT_MA;
+    const std::chrono::milliseconds ACCEL_TIME(SERVO_ACCEL_MS);
+    
+    // Holding draw with no gravity load (electronics, friction), as a
+    // fraction of the full-load figure
+    const float UNLOADED_HOLD_FRACTION = 0.25f;
+    
+    MetricCounter& deferral_count = metrics().counter("smartarm_motion_deferrals_total",
+                                                      "Joint segments delayed by the supply current budget");
+    MetricCounter& overload_count = metrics().counter("smartarm_supply_overloads_total",
+                                                      "Joint segments started over the supply current budget");
+}
+
+CurrentBudget::CurrentBudget() :
+    motor_ma(0.0f),
+    peak_ma(0.0f),
+    deferrals(0),
+    overloads(0) {
+    Clock::TimePoint now = arm_clock().now();
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        joints[i] = { 0.0f, 0.0f, 0.0f, now, now };
+    }
+}
+
+float CurrentBudget::holdCurrent(int servo_id, const float pose[3]) {
+    if (servo_id < 0 || servo_id >= SERVO_COUNT) {
+        return 0.0f;
+    }
+    if (servo_id != 1 && servo_id != 2) {
+        return HOLD_CURRENT[servo_id];
+    }
+    
+    // Gravity torque follows the horizontal lever of the links beyond the
+    // joint, taken at their midpoints; base yaw does not change it
+    ArmPoint points[4];
+    arm_chain(90.0f, pose[1], pose[2], points);
+    float lever;
+    float full_lever;
+    if (servo_id == 1) {
+        lever = (points[1].x + points[2].x + points[3].x) / 3.0f;
+        full_lever = (3.0f * ARM_UPPER_LINK_MM + 2.0f * ARM_FORE_LINK_MM + ARM_GRIPPER_LINK_MM) / 3.0f;
+    } else {
+        lever = (points[2].x + points[3].x) / 2.0f - points[1].x;
+        full_lever = (2.0f * ARM_FORE_LINK_MM + ARM_GRIPPER_LINK_MM) / 2.0f;
+    }
+    float load = std::min(1.0f, std::fabs(lever) / full_lever);
+    return HOLD_CURRENT[servo_id] * (UNLOADED_HOLD_FRACTION + (1.0f - UNLOADED_HOLD_FRACTION) * load);
+}
+
+float CurrentBudget::segmentPeak(int servo_id, bool from_rest) {
+    if (servo_id < 0 || servo_id >= SERVO_COUNT) {
+        return 0.0f;
+    }
+    return from_rest ? STALL_CURRENT[servo_id] : MOVE_CURRENT[servo_id];
+}
+
+float CurrentBudget::drawAt(const JointLoad& joint, Clock::TimePoint when) {
+    if (when < joint.surge_until) {
+        return joint.surge_ma;
+    }
+    if (when < joint.move_until) {
+        return joint.move_ma;
+    }
+    return joint.hold_ma;
+}
+
+float CurrentBudget::othersAt(int servo_id, Clock::TimePoint when) const {
+    float total = motor_ma;
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        if (i != servo_id) {
+            total += drawAt(joints[i], when);
+        }
+    }
+    return total;
+}
+
+void CurrentBudget::recordMove(int servo_id, Clock::TimePoint start, Clock::TimePoint arrival,
+                               bool from_rest, float hold_ma) {
+    if (servo_id < 0 || servo_id >= SERVO_COUNT) {
+        return;
+    }
+    
+    std::lock_guard<std::mutex> lock(mutex);
+    JointLoad& joint = joints[servo_id];
+    float before = drawAt(joint, start);
+    joint.hold_ma = hold_ma;
+    joint.move_ma = MOVE_CURRENT[servo_id];
+    joint.move_until = arrival;
+    if (from_rest) {
+        joint.surge_ma = STALL_CURRENT[servo_id];
+        joint.surge_until = std::min(arrival, start + std::chrono::duration_cast<Clock::Duration>(ACCEL_TIME));
+    } else if (joint.surge_until > arrival) {
+        joint.surge_until = arrival;
+    }
+    
+    // Loads only end from here, so the total now is the peak of this segment
+    float total = SUPPLY_BASE_MA + othersAt(-1, start);
+    if (total > peak_ma) {
+        peak_ma = total;
+    }
+    
+    // Only the write that pushes the total over counts, not every later
+    // step of the same motion while the surge lasts
+    if (total > limit() + SUPPLY_BASE_MA && drawAt(joint, start) > before) {
+        overloads++;
+        overload_count.inc();
+        flight_record(FLIGHT_EVENT, FLIGHT_EVENT_SUPPLY_BUDGET, servo_id, total - SUPPLY_BASE_MA, 0.0f);
+    }
+}
+
+void CurrentBudget::setHolding(int servo_id, float hold_ma) {
+    if (servo_id < 0 || servo_id >= SERVO_COUNT) {
+        return;
+    }
+    
+    std::lock_guard<std::mutex> lock(mutex);
+    joints[servo_id].hold_ma = hold_ma;
+}
+
+void CurrentBudget::release(int servo_id) {
+    if (servo_id < 0 || servo_id >= SERVO_COUNT) {
+        return;
+    }
+    
+    std::lock_guard<std::mutex> lock(mutex);
+    Clock::TimePoint now = arm_clock().now();
+    joints[servo_id] = { 0.0f, 0.0f, 0.0f, now, now };
+}
+
+bool CurrentBudget::admit(int servo_id, bool from_rest, Clock::TimePoint now, Clock::TimePoint& retry) {
+    if (servo_id < 0 || servo_id >= SERVO_COUNT) {
+        return true;
+    }
+    
+    std::lock_guard<std::mutex> lock(mutex);
+    float peak = from_rest ? STALL_CURRENT[servo_id] : MOVE_CURRENT[servo_id];
+    if (othersAt(servo_id, now) + peak <= limit()) {
+        return true;
+    }
+    
+    // Earliest moment another joint's surge or slew ends
+    bool found = false;
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        if (i == servo_id) {
+            continue;
+        }
+        const JointLoad& joint = joints[i];
+        Clock::TimePoint next;
+        if (now < joint.surge_until) {
+            next = joint.surge_until;
+        } else if (now < joint.move_until) {
+            next = joint.move_until;
+        } else {
+            continue;
+        }
+        if (!found || next < retry) {
+            retry = next;
+            found = true;
+        }
+    }
+    
+    if (!found) {
+        // Waiting frees nothing; start it and let the margin absorb it
+        return true;
+    }
+    
+    deferrals++;
+    deferral_count.inc();
+    flight_record(FLIGHT_EVENT, FLIGHT_EVENT_SUPPLY_BUDGET, servo_id, othersAt(servo_id, now) + peak,
+                  std::chrono::duration<float, std::milli>(retry - now).count());
+    return false;
+}
+
+void CurrentBudget::setMotorSpeed(int speed) {
+    std::lock_guard<std::mutex> lock(mutex);
+    motor_ma = MOTOR_CURRENT_MA * std::min(100, std::abs(speed)) / 100.0f;
+    float total = SUPPLY_BASE_MA + othersAt(-1, arm_clock().now());
+    if (total > peak_ma) {
+        peak_ma = total;
+    }
+}
+
+float CurrentBudget::supplyAt(Clock::TimePoint when) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return SUPPLY_BASE_MA + othersAt(-1, when);
+}
+
+float CurrentBudget::getPeak() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return peak_ma;
+}
+
+unsigned long CurrentBudget::getDeferrals() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return deferrals;
+}
+
+unsigned long CurrentBudget::getOverloads() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return overloads;
+}
@@ -0,0 +1,80 @@
+#ifndef CURRENT_BUDGET_H
+#define CURRENT_BUDGET_H
+
+#include <mutex>
+#include "clock.h"
+#include "../include/config.h"
+
+// Supply current model for the servos and the conveyor motor. Every
+// commanded joint segment is recorded as a start-up surge at stall current
+// (SERVO_ACCEL_MS, only when the joint starts from rest), then slewing
+// current until the modeled arrival, then holding current scaled by the
+// gravity load of the pose. Motion schedulers ask admit() before starting
+// a segment; it refuses while the segment's peak would push the modeled
+// total over the budget, and says when the next load ends so the segment
+// can be staggered to then. Any recorded segment that raises the modeled
+// total over the budget, admitted or not, is counted as an overload.
+//
+// Loads only ever end, so the total at the start of a segment is the most
+// the others will draw during it, which keeps admit() O(joints).
+class CurrentBudget {
+private:
+    struct JointLoad {
+        float hold_ma;                  // once the segment is over (0 when not energized)
+        float move_ma;
+        float surge_ma;
+        Clock::TimePoint surge_until;
+        Clock::TimePoint move_until;
+    };
+    
+    mutable std::mutex mutex;
+    JointLoad joints[SERVO_COUNT];
+    float motor_ma;
+    float peak_ma;
+    unsigned long deferrals;
+    unsigned long overloads;
+    
+    static float drawAt(const JointLoad& joint, Clock::TimePoint when);
+    
+    // Modeled draw of everything but one joint (-1 for none), base load excluded
+    float othersAt(int servo_id, Clock::TimePoint when) const;
+    
+public:
+    CurrentBudget();
+    
+    // Current available to servos and motor
+    static float limit() { return SUPPLY_LIMIT_MA - SUPPLY_BASE_MA - SUPPLY_MARGIN_MA; }
+    
+    // Holding current of a joint at a base/shoulder/elbow pose
+    static float holdCurrent(int servo_id, const float pose[3]);
+    
+    // Peak draw of a segment starting now
+    static float segmentPeak(int servo_id, bool from_rest);
+    
+    // Record a commanded segment and the holding current after it; counts
+    // an overload when it raises the total over the budget
+    void recordMove(int servo_id, Clock::TimePoint start, Clock::TimePoint arrival, bool from_rest, float hold_ma);
+    
+    // Holding current after the joint's current segment, for load changes
+    // caused by other joints
+    void setHolding(int servo_id, float hold_ma);
+    
+    // Joint no longer energized (idle detach, emergency stop)
+    void release(int servo_id);
+    
+    // Whether a segment may start now. If not, retry is when the next load
+    // ends; if nothing will end (holding and motor current alone use the
+    // budget) the segment is admitted anyway and recordMove() counts it.
+    bool admit(int servo_id, bool from_rest, Clock::TimePoint now, Clock::TimePoint& retry);
+    
+    // Conveyor motor speed, -100..100
+    void setMotorSpeed(int speed);
+    
+    // Modeled supply current including the base load (mA)
+    float supplyAt(Clock::TimePoint when) const;
+    float getPeak() const;
+    unsigned long getDeferrals() const;
+    unsigned long getOverloads() const;
+};
+
+#endif // CURRENT_BUDGET_H
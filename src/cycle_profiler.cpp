@@ -0,0 +1,158 @@
+#include "cycle_profiler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <iomanip>
+
+namespace {
+    const double BUCKET_GROWTH = 1.25;
+    
+    // Append formatted text to a fixed buffer, counting what did not fit
+    void append(char* buffer, size_t size, size_t& length, const char* format, ...) {
+        va_list args;
+        va_start(args, format);
+        int written = std::vsnprintf(length < size ? buffer + length : nullptr,
+                                     length < size ? size - length : 0, format, args);
+        va_end(args);
+        if (written > 0) {
+            length += written;
+        }
+    }
+}
+
+CycleProfiler::CycleProfiler() : cycles(0), cycle_total_ms(0.0), last_cycle_ms(0.0), last_success(false) {
+}
+
+int CycleProfiler::bucketOf(double ms) {
+    if (ms <= 1.0) return 0;
+    int bucket = static_cast<int>(std::ceil(std::log(ms) / std::log(BUCKET_GROWTH)));
+    return std::min(bucket, BUCKETS - 1);
+}
+
+double CycleProfiler::bucketUpper(int bucket) {
+    return std::pow(BUCKET_GROWTH, bucket);
+}
+
+void CycleProfiler::clear() {
+    phases.clear();
+    order.clear();
+    cycles = 0;
+    cycle_total_ms = 0.0;
+    last_cycle_ms = 0.0;
+    last_success = false;
+}
+
+int CycleProfiler::addPhase(const std::string& name) {
+    Phase phase;
+    phase.name = name;
+    phase.count = 0;
+    phase.total_ms = 0.0;
+    phase.critical_ms = 0.0;
+    phase.max_ms = 0.0;
+    std::fill(phase.histogram, phase.histogram + BUCKETS, 0UL);
+    phase.last_ms = -1.0;
+    phase.last_critical_ms = 0.0;
+    phases.push_back(phase);
+    order.push_back(0);
+    return static_cast<int>(phases.size()) - 1;
+}
+
+void CycleProfiler::beginCycle() {
+    for (Phase& phase : phases) {
+        phase.last_ms = -1.0;
+        phase.last_critical_ms = 0.0;
+    }
+    last_cycle_ms = 0.0;
+}
+
+void CycleProfiler::record(int index, double ms, double critical_ms) {
+    if (index < 0 || index >= static_cast<int>(phases.size())) return;
+    Phase& phase = phases[index];
+    phase.count++;
+    phase.total_ms += ms;
+    phase.critical_ms += critical_ms;
+    phase.max_ms = std::max(phase.max_ms, ms);
+    phase.histogram[bucketOf(ms)]++;
+    phase.last_ms = ms;
+    phase.last_critical_ms = critical_ms;
+    last_cycle_ms += critical_ms;
+}
+
+void CycleProfiler::endCycle(bool success) {
+    cycles++;
+    cycle_total_ms += last_cycle_ms;
+    last_success = success;
+}
+
+double CycleProfiler::getMeanMs(int phase) const {
+    return phases[phase].count > 0 ? phases[phase].total_ms / phases[phase].count : 0.0;
+}
+
+double CycleProfiler::getMeanCriticalMs(int phase) const {
+    return cycles > 0 ? phases[phase].critical_ms / cycles : 0.0;
+}
+
+double CycleProfiler::getShare(int phase) const {
+    return cycle_total_ms > 0.0 ? phases[phase].critical_ms / cycle_total_ms : 0.0;
+}
+
+double CycleProfiler::percentile(int index, double fraction) const {
+    const Phase& phase = phases[index];
+    if (phase.count == 0) return 0.0;
+    unsigned long target = static_cast<unsigned long>(std::ceil(fraction * phase.count));
+    unsigned long seen = 0;
+    for (int bucket = 0; bucket < BUCKETS; bucket++) {
+        seen += phase.histogram[bucket];
+        if (seen >= target && seen > 0) {
+            return std::min(bucketUpper(bucket), phase.max_ms);
+        }
+    }
+    return phase.max_ms;
+}
+
+const std::vector<int>& CycleProfiler::ranked() const {
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = static_cast<int>(i);
+    }
+    // Insertion sort: stable, in place and plenty for a handful of phases
+    for (size_t i = 1; i < order.size(); i++) {
+        int phase = order[i];
+        size_t j = i;
+        for (; j > 0 && phases[order[j - 1]].critical_ms < phases[phase].critical_ms; j--) {
+            order[j] = order[j - 1];
+        }
+        order[j] = phase;
+    }
+    return order;
+}
+
+size_t CycleProfiler::formatCycle(char* buffer, size_t size) const {
+    size_t length = 0;
+    append(buffer, size, length, "{\"operation\":\"grab_profile\",\"cycle\":%lu,\"success\":%s,\"total_ms\":%.1f,\"phases\":[",
+           cycles, last_success ? "true" : "false", last_cycle_ms);
+    bool first = true;
+    for (const Phase& phase : phases) {
+        if (phase.last_ms < 0.0) continue;
+        append(buffer, size, length, "%s{\"name\":\"%s\",\"ms\":%.1f,\"critical_ms\":%.1f}",
+               first ? "" : ",", phase.name.c_str(), phase.last_ms, phase.last_critical_ms);
+        first = false;
+    }
+    append(buffer, size, length, "]}");
+    return length;
+}
+
+void CycleProfiler::printSummary(std::ostream& out, int top) const {
+    out << "Cycle profile over " << cycles << " cycles, mean " << std::fixed << std::setprecision(1)
+        << getMeanCycleMs() << " ms. Top contributors:" << std::endl;
+    ranked();
+    for (int i = 0; i < top && i < static_cast<int>(order.size()); i++) {
+        int phase = order[i];
+        if (phases[phase].critical_ms <= 0.0) break;
+        out << "  " << std::left << std::setw(16) << phases[phase].name << std::right
+            << std::setw(8) << getMeanCriticalMs(phase) << " ms/cycle " << std::setw(5) << getShare(phase) * 100.0
+            << "%  (runs " << getMeanMs(phase) << " ms, p95 " << percentile(phase, 0.95)
+            << ", max " << phases[phase].max_ms << ")" << std::endl;
+    }
+    out << std::defaultfloat << std::setprecision(6);
+}
@@ -0,0 +1,75 @@
+#ifndef CYCLE_PROFILER_H
+#define CYCLE_PROFILER_H
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Per-phase timing of auto-mode pick cycles. Phases are registered up
+// front (ranging, each routine action, cooldown); every cycle records each
+// phase's own duration and its share of the cycle's critical path, so
+// overlapping actions are not double counted. Recording does not allocate.
+class CycleProfiler {
+private:
+    static const int BUCKETS = 48;   // log-spaced, 1 ms to ~36 s
+    
+    struct Phase {
+        std::string name;
+        unsigned long count;
+        double total_ms;
+        double critical_ms;          // summed contribution to cycle time
+        double max_ms;
+        unsigned long histogram[BUCKETS];
+        double last_ms;              // current / last cycle, -1 if not run
+        double last_critical_ms;
+    };
+    
+    std::vector<Phase> phases;
+    mutable std::vector<int> order;  // ranking scratch, sized with phases
+    unsigned long cycles;
+    double cycle_total_ms;
+    double last_cycle_ms;
+    bool last_success;
+    
+    static int bucketOf(double ms);
+    static double bucketUpper(int bucket);
+    
+public:
+    CycleProfiler();
+    
+    // Drop all phases and statistics
+    void clear();
+    int addPhase(const std::string& name);
+    
+    void beginCycle();
+    void record(int phase, double ms, double critical_ms);
+    void endCycle(bool success);
+    
+    int getPhaseCount() const { return static_cast<int>(phases.size()); }
+    const std::string& getPhaseName(int phase) const { return phases[phase].name; }
+    unsigned long getCycles() const { return cycles; }
+    double getMeanCycleMs() const { return cycles > 0 ? cycle_total_ms / cycles : 0.0; }
+    double getMeanMs(int phase) const;
+    double getMeanCriticalMs(int phase) const;
+    double getMaxMs(int phase) const { return phases[phase].max_ms; }
+    // Duration in the current / last cycle, -1 if the phase did not run
+    double getLastMs(int phase) const { return phases[phase].last_ms; }
+    // Share of total cycle time spent on this phase's critical path, 0..1
+    double getShare(int phase) const;
+    // Approximate percentile of the phase duration (bucket upper bound)
+    double percentile(int phase, double fraction) const;
+    
+    // Phase indices ordered by contribution to cycle time, largest first.
+    // Valid until the next call; does not allocate.
+    const std::vector<int>& ranked() const;
+    
+    // JSON breakdown of the last cycle into a caller's buffer; returns the
+    // length written, which is >= size if it did not fit
+    size_t formatCycle(char* buffer, size_t size) const;
+    
+    // Top contributors as a text table
+    void printSummary(std::ostream& out, int top) const;
+};
+
+#endif // CYCLE_PROFILER_H
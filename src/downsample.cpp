@@ -0,0 +1,154 @@
+#include "downsample.h"
+#include <algorithm>
+#include <cmath>
+
+TimeBuckets::TimeBuckets(int64_t from, int64_t to, int buckets) :
+    from_ms(from),
+    span_ms(std::max<int64_t>(1, to - from)),
+    count(std::max(1, buckets)),
+    cursor(-1),
+    cursor_start(0),
+    cursor_end(0) {}
+
+int TimeBuckets::indexOf(int64_t time_ms) {
+    if (cursor >= 0 && time_ms >= cursor_start && time_ms < cursor_end) {
+        return cursor;
+    }
+    if (time_ms < from_ms) return 0;
+    if (time_ms >= from_ms + span_ms) return count - 1;
+    
+    // Bucket starts are rounded down, so the estimate can be one short
+    int bucket = static_cast<int>((time_ms - from_ms) * count / span_ms);
+    while (bucket + 1 < count && time_ms >= startOf(bucket + 1)) bucket++;
+    cursor = bucket;
+    cursor_start = startOf(bucket);
+    cursor_end = startOf(bucket + 1);
+    return bucket;
+}
+
+// First and last points are kept on top of one per bucket
+LttbDownsampler::LttbDownsampler(int64_t from, int64_t to, int points) :
+    from_ms(from),
+    slices(from, to, points - 2),
+    buckets(slices.size(), Bucket{0.0, 0.0, 0, -1}),
+    last_time(0.0),
+    last_value(0.0f),
+    measured(false),
+    selecting(false),
+    current(-1),
+    kept_time(0.0),
+    kept_value(0.0f),
+    corner_time(0.0),
+    corner_value(0.0),
+    best_time(0.0),
+    best_value(0.0f),
+    best_area(-1.0) {}
+
+void LttbDownsampler::keep(double time, float value) {
+    times.push_back(from_ms + static_cast<int64_t>(time));
+    values.push_back(value);
+    kept_time = time;
+    kept_value = value;
+}
+
+void LttbDownsampler::measure(int64_t time_ms, float value) {
+    Bucket& bucket = buckets[slices.indexOf(time_ms)];
+    bucket.time_sum += time_ms - from_ms;
+    bucket.value_sum += value;
+    bucket.count++;
+    last_time = time_ms - from_ms;
+    last_value = value;
+    measured = true;
+}
+
+void LttbDownsampler::select(int64_t time_ms, float value) {
+    if (!selecting) {
+        selecting = true;
+        int next = -1;
+        for (int b = static_cast<int>(buckets.size()) - 1; b >= 0; b--) {
+            buckets[b].next = next;
+            if (buckets[b].count > 0) next = b;
+        }
+    }
+    
+    double time = static_cast<double>(time_ms - from_ms);
+    int b = slices.indexOf(time_ms);
+    if (b != current) {
+        bool first = current < 0;
+        if (best_area >= 0.0) keep(best_time, best_value);
+        current = b;
+        best_area = -1.0;
+        
+        // Third corner: the next bucket's mean, or the last point at the end
+        corner_time = last_time;
+        corner_value = last_value;
+        if (buckets[b].next >= 0) {
+            const Bucket& next = buckets[buckets[b].next];
+            corner_time = next.time_sum / next.count;
+            corner_value = next.value_sum / next.count;
+        }
+        if (first) {
+            keep(time, value); // The first point is always kept
+            return;
+        }
+    }
+    
+    double area = std::fabs((kept_time - corner_time) * (value - kept_value) -
+                            (kept_time - time) * (corner_value - kept_value));
+    if (area > best_area) {
+        best_area = area;
+        best_time = time;
+        best_value = value;
+    }
+}
+
+void LttbDownsampler::finish(std::vector<int64_t>& time, std::vector<float>& value) {
+    if (best_area >= 0.0) keep(best_time, best_value);
+    if (measured && !times.empty() && times.back() != from_ms + static_cast<int64_t>(last_time)) {
+        keep(last_time, last_value);
+    }
+    time.swap(times);
+    value.swap(values);
+}
+
+MinMaxDownsampler::MinMaxDownsampler(int64_t from, int64_t to, int points) :
+    slices(from, to, points / 2),
+    buckets(slices.size(), Bucket{0, 0, 0.0f, 0.0f, false}) {}
+
+void MinMaxDownsampler::add(int64_t time_ms, float low, float high) {
+    Bucket& bucket = buckets[slices.indexOf(time_ms)];
+    if (!bucket.used) {
+        bucket = {time_ms, time_ms, low, high, true};
+        return;
+    }
+    if (low < bucket.low) {
+        bucket.low = low;
+        bucket.low_time = time_ms;
+    }
+    if (high > bucket.high) {
+        bucket.high = high;
+        bucket.high_time = time_ms;
+    }
+}
+
+void MinMaxDownsampler::finish(std::vector<int64_t>& time, std::vector<float>& value) {
+    time.clear();
+    value.clear();
+    for (const Bucket& bucket : buckets) {
+        if (!bucket.used) continue;
+        if (bucket.low_time == bucket.high_time && bucket.low == bucket.high) {
+            time.push_back(bucket.low_time);
+            value.push_back(bucket.low);
+        } else if (bucket.low_time <= bucket.high_time) {
+            time.push_back(bucket.low_time);
+            value.push_back(bucket.low);
+            time.push_back(bucket.high_time);
+            value.push_back(bucket.high);
+        } else {
+            time.push_back(bucket.high_time);
+            value.push_back(bucket.high);
+            time.push_back(bucket.low_time);
+            value.push_back(bucket.low);
+        }
+    }
+}
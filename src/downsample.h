@@ -0,0 +1,106 @@
+#ifndef DOWNSAMPLE_H
+#define DOWNSAMPLE_H
+
+#include <cstdint>
+#include <vector>
+
+// Reduce a time-ordered series to a plottable number of points, streaming
+// over the input so the full series is never held in memory. Buckets are
+// equal slices of [from_ms, to_ms), so gaps in the data stay gaps.
+
+// Equal time slices of [from_ms, to_ms). Points arrive in time order, so
+// a lookup is usually a comparison against the previous point's bucket.
+class TimeBuckets {
+private:
+    int64_t from_ms;
+    int64_t span_ms;
+    int count;
+    int cursor;
+    int64_t cursor_start;
+    int64_t cursor_end;
+    
+    int64_t startOf(int bucket) const { return from_ms + span_ms * bucket / count; }
+    
+public:
+    TimeBuckets(int64_t from_ms, int64_t to_ms, int buckets);
+    
+    int size() const { return count; }
+    
+    // Bucket of a time; times outside the range go to the first or last
+    int indexOf(int64_t time_ms);
+};
+
+// Largest-Triangle-Three-Buckets: keeps the point of each bucket that
+// spans the largest triangle with the point kept before it and the mean
+// of the next bucket, plus the first and last points. Takes two passes:
+// measure() every point, then select() the same points in the same order.
+class LttbDownsampler {
+private:
+    struct Bucket {
+        double time_sum;       // relative to from_ms
+        double value_sum;
+        int64_t count;
+        int next;              // next bucket with points, -1 for none
+    };
+    
+    int64_t from_ms;
+    TimeBuckets slices;
+    std::vector<Bucket> buckets;
+    double last_time;          // last measured point
+    float last_value;
+    bool measured;
+    bool selecting;
+    
+    // Selection state
+    int current;               // bucket being selected from, -1 before the first point
+    double kept_time;          // point kept before the current bucket
+    float kept_value;
+    double corner_time;        // third corner for the current bucket
+    double corner_value;
+    double best_time;
+    float best_value;
+    double best_area;          // < 0 while the bucket has no candidate
+    std::vector<int64_t> times;
+    std::vector<float> values;
+    
+    void keep(double time, float value);
+    
+public:
+    LttbDownsampler(int64_t from_ms, int64_t to_ms, int points);
+    
+    // First pass
+    void measure(int64_t time_ms, float value);
+    
+    // Second pass
+    void select(int64_t time_ms, float value);
+    
+    // The kept points, oldest first
+    void finish(std::vector<int64_t>& time, std::vector<float>& value);
+};
+
+// Min/max bucketing: keeps the lowest and highest point of each of
+// points / 2 buckets, so spikes survive any zoom level. One pass.
+class MinMaxDownsampler {
+private:
+    struct Bucket {
+        int64_t low_time;
+        int64_t high_time;
+        float low;
+        float high;
+        bool used;
+    };
+    
+    TimeBuckets slices;
+    std::vector<Bucket> buckets;
+    
+public:
+    MinMaxDownsampler(int64_t from_ms, int64_t to_ms, int points);
+    
+    // A sample (low == high), or a range already summarized at one time
+    void add(int64_t time_ms, float low, float high);
+    
+    // The kept points, oldest first
+    void finish(std::vector<int64_t>& time, std::vector<float>& value);
+};
+
+#endif // DOWNSAMPLE_H
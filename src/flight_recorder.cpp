@@ -0,0 +1,217 @@
+#include "flight_recorder.h"
+#include "clock.h"
+#include "../include/config.h"
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <iostream>
+
+namespace {
+    const uint32_t DUMP_VERSION = 1;
+    
+    // One ring per thread, written only by its owner. Threads keep their
+    // ring for the life of the process.
+    struct Ring {
+        std::atomic<uint64_t> head;   // records ever written
+        char name[16];
+        FlightRecord records[FLIGHT_RECORDER_RECORDS];
+    };
+    
+    Ring rings[FLIGHT_RECORDER_THREADS];
+    std::atomic<int> ring_count(0);
+    std::atomic<bool> dumping(false);
+    thread_local Ring* thread_ring = nullptr;
+    thread_local bool thread_registered = false;
+    
+    Ring* current_ring() {
+        if (!thread_registered) {
+            thread_registered = true;
+            int index = ring_count.fetch_add(1);
+            if (index < FLIGHT_RECORDER_THREADS) {
+                thread_ring = &rings[index];
+                std::strcpy(thread_ring->name, "thread-");
+                thread_ring->name[7] = static_cast<char>('0' + index % 10);
+                thread_ring->name[8] = '\0';
+            }
+        }
+        return thread_ring; // nullptr once all rings are taken
+    }
+    
+    FlightRecord* begin_record(Ring* ring, FlightRecordType type, int id, int value) {
+        FlightRecord& record = ring->records[ring->head.load(std::memory_order_relaxed) % FLIGHT_RECORDER_RECORDS];
+        record.time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            arm_clock().now().time_since_epoch()).count();
+        record.type = static_cast<uint8_t>(type);
+        record.id = static_cast<uint8_t>(id);
+        record.reserved = 0;
+        record.value = value;
+        return &record;
+    }
+    
+    void commit_record(Ring* ring) {
+        ring->head.fetch_add(1, std::memory_order_release);
+    }
+    
+    // Path building and writing without malloc or stdio, usable in a signal handler
+    void append(char* buffer, size_t size, size_t& length, const char* text) {
+        while (*text && length + 1 < size) buffer[length++] = *text++;
+        buffer[length] = '\0';
+    }
+    
+    void append_number(char* buffer, size_t size, size_t& length, unsigned long long value) {
+        char digits[24];
+        int count = 0;
+        do {
+            digits[count++] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value > 0);
+        while (count > 0 && length + 1 < size) buffer[length++] = digits[--count];
+        buffer[length] = '\0';
+    }
+    
+    bool write_all(int fd, const void* data, size_t size) {
+        const char* bytes = static_cast<const char*>(data);
+        while (size > 0) {
+            ssize_t written = write(fd, bytes, size);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            bytes += written;
+            size -= written;
+        }
+        return true;
+    }
+    
+    const char* reason_name(FlightDumpReason reason) {
+        switch (reason) {
+            case FLIGHT_DUMP_REQUEST: return "request";
+            case FLIGHT_DUMP_ESTOP: return "estop";
+            case FLIGHT_DUMP_WATCHDOG: return "watchdog";
+            case FLIGHT_DUMP_CRASH: return "crash";
+        }
+        return "unknown";
+    }
+    
+    void crash_handler(int signal_number) {
+        flight_recorder_dump(FLIGHT_DUMP_CRASH, signal_number);
+        raise(signal_number); // SA_RESETHAND restored the default action
+    }
+}
+
+bool flight_recorder_init() {
+    std::error_code error;
+    std::filesystem::create_directories(FLIGHT_RECORDER_DIR, error);
+    if (error) {
+        std::cerr << "Cannot create flight recorder directory " << FLIGHT_RECORDER_DIR << ": "
+                  << error.message() << std::endl;
+        return false;
+    }
+    
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = crash_handler;
+    action.sa_flags = SA_RESETHAND;
+    sigemptyset(&action.sa_mask);
+    const int signals[] = {SIGSEGV, SIGABRT, SIGBUS, SIGFPE, SIGILL};
+    for (int signal_number : signals) {
+        sigaction(signal_number, &action, nullptr);
+    }
+    return true;
+}
+
+void flight_thread_name(const char* name) {
+    Ring* ring = current_ring();
+    if (!ring) return;
+    std::strncpy(ring->name, name, sizeof(ring->name) - 1);
+    ring->name[sizeof(ring->name) - 1] = '\0';
+}
+
+void flight_record(FlightRecordType type, int id, int value, float a, float b, float c, float d) {
+    Ring* ring = current_ring();
+    if (!ring) return;
+    FlightRecord* record = begin_record(ring, type, id, value);
+    record->values[0] = a;
+    record->values[1] = b;
+    record->values[2] = c;
+    record->values[3] = d;
+    commit_record(ring);
+}
+
+void flight_record_text(FlightRecordType type, int id, const char* text, size_t length) {
+    Ring* ring = current_ring();
+    if (!ring) return;
+    FlightRecord* record = begin_record(ring, type, id, static_cast<int>(length));
+    size_t copied = length < sizeof(record->text) ? length : sizeof(record->text);
+    std::memset(record->text, 0, sizeof(record->text));
+    std::memcpy(record->text, text, copied);
+    commit_record(ring);
+}
+
+bool flight_recorder_dump(FlightDumpReason reason, int signal) {
+    bool expected = false;
+    if (!dumping.compare_exchange_strong(expected, true)) {
+        return false;
+    }
+    
+    char path[256];
+    size_t length = 0;
+    path[0] = '\0';
+    append(path, sizeof(path), length, FLIGHT_RECORDER_DIR "/flight-");
+    append_number(path, sizeof(path), length, static_cast<unsigned long long>(time(nullptr)));
+    append(path, sizeof(path), length, "-");
+    append(path, sizeof(path), length, reason_name(reason));
+    append(path, sizeof(path), length, ".bin");
+    
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        dumping = false;
+        return false;
+    }
+    
+    int threads = ring_count.load();
+    if (threads > FLIGHT_RECORDER_THREADS) threads = FLIGHT_RECORDER_THREADS;
+    
+    FlightDumpHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "SAFLIGHT", sizeof(header.magic));
+    header.version = DUMP_VERSION;
+    header.reason = reason;
+    header.signal = signal;
+    header.thread_count = threads;
+    header.record_size = sizeof(FlightRecord);
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    header.time_ns = static_cast<uint64_t>(now.tv_sec) * 1000000000ULL + now.tv_nsec;
+    bool ok = write_all(fd, &header, sizeof(header));
+    
+    // Other threads keep recording; the oldest records of a busy ring may
+    // be overwritten by newer ones while it is written out
+    for (int i = 0; i < threads && ok; i++) {
+        const Ring& ring = rings[i];
+        uint64_t end = ring.head.load(std::memory_order_acquire);
+        uint64_t start = end > FLIGHT_RECORDER_RECORDS ? end - FLIGHT_RECORDER_RECORDS : 0;
+        
+        FlightDumpThread thread;
+        std::memset(&thread, 0, sizeof(thread));
+        std::memcpy(thread.name, ring.name, sizeof(thread.name));
+        thread.record_count = static_cast<uint32_t>(end - start);
+        ok = write_all(fd, &thread, sizeof(thread));
+        
+        size_t first = start % FLIGHT_RECORDER_RECORDS;
+        size_t count = end - start;
+        size_t head_part = count < FLIGHT_RECORDER_RECORDS - first ? count : FLIGHT_RECORDER_RECORDS - first;
+        ok = ok && write_all(fd, &ring.records[first], head_part * sizeof(FlightRecord));
+        ok = ok && write_all(fd, &ring.records[0], (count - head_part) * sizeof(FlightRecord));
+    }
+    
+    ok = close(fd) == 0 && ok;
+    dumping = false;
+    return ok;
+}
@@ -0,0 +1,89 @@
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+
+#include <cstdint>
+#include <cstddef>
+
+// Always-on flight recorder. Every thread appends fixed-size binary records
+// (commands, setpoints, servo outputs, sensor samples, tick timings) to its
+// own lock-free ring holding the last FLIGHT_RECORDER_RECORDS entries. The
+// rings are dumped to FLIGHT_RECORDER_DIR on e-stop, watchdog trip, crash
+// signals or on request; tools/flight_decode.cpp turns a dump into text.
+
+enum FlightRecordType {
+    FLIGHT_TICK = 1,      // id = mode (0 manual, 1 auto), value = tick duration us
+    FLIGHT_COMMAND,       // text = first bytes of the MQTT command
+    FLIGHT_SETPOINT,      // id = servo, value = commanded angle
+    FLIGHT_OUTPUT,        // id = servo, value = PWM value, values[0] = shaped angle
+    FLIGHT_SENSOR,        // value = echo us (-1 timeout), values[0] = distance cm
+    FLIGHT_EVENT          // id = FlightEvent, value = event specific
+};
+
+enum FlightEvent {
+    FLIGHT_EVENT_ESTOP = 1,
+    FLIGHT_EVENT_MODE,          // value = 1 auto, 0 manual
+    FLIGHT_EVENT_GRAB,          // value = cycle ms, values = distance cm, success
+    FLIGHT_EVENT_WATCHDOG,      // value = ms since the last tick
+    FLIGHT_EVENT_DUMP,          // value = FlightDumpReason
+    FLIGHT_EVENT_SERVO_POWER,   // value = servo, values[0] = 1 re-engaged, 0 detached when idle
+    FLIGHT_EVENT_SUPPLY_BUDGET, // value = servo, values = modeled mA, deferral ms (0 = started over budget)
+    FLIGHT_EVENT_CONVEYOR       // value = belt motor speed set by auto mode
+};
+
+enum FlightDumpReason {
+    FLIGHT_DUMP_REQUEST = 1,
+    FLIGHT_DUMP_ESTOP,
+    FLIGHT_DUMP_WATCHDOG,
+    FLIGHT_DUMP_CRASH
+};
+
+struct FlightRecord {
+    uint64_t time_ns;     // arm_clock() time
+    uint8_t type;         // FlightRecordType
+    uint8_t id;
+    uint16_t reserved;
+    int32_t value;
+    union {
+        float values[4];
+        char text[16];
+    };
+};
+
+// Dump file layout: FlightDumpHeader, then per thread a FlightDumpThread
+// followed by its records, oldest first
+struct FlightDumpHeader {
+    char magic[8];        // "SAFLIGHT"
+    uint32_t version;
+    uint32_t reason;      // FlightDumpReason
+    int32_t signal;       // crash signal, 0 otherwise
+    uint32_t thread_count;
+    uint32_t record_size;
+    uint32_t reserved;
+    uint64_t time_ns;     // CLOCK_MONOTONIC when the dump was taken
+};
+
+struct FlightDumpThread {
+    char name[16];
+    uint32_t record_count;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(FlightRecord) == 32, "flight records are fixed size");
+
+// Create the dump directory and install crash handlers (SIGSEGV, SIGABRT,
+// SIGBUS, SIGFPE, SIGILL). Recording works without it.
+bool flight_recorder_init();
+
+// Name the calling thread in dumps (at most 15 characters)
+void flight_thread_name(const char* name);
+
+void flight_record(FlightRecordType type, int id, int value,
+                   float a = 0.0f, float b = 0.0f, float c = 0.0f, float d = 0.0f);
+void flight_record_text(FlightRecordType type, int id, const char* text, size_t length);
+
+// Write all rings to FLIGHT_RECORDER_DIR/flight-<unix time>-<reason>.bin.
+// Async-signal-safe; returns false if the file could not be written or
+// another dump is in progress.
+bool flight_recorder_dump(FlightDumpReason reason, int signal = 0);
+
+#endif // FLIGHT_RECORDER_H
@@ -0,0 +1,125 @@
+#include "grab_params.h"
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+namespace {
+    // Single table drives both load and save so the two never drift apart
+    struct Field {
+        const char* key;
+        int GrabParams::* int_value;
+        float GrabParams::* float_value;
+        bool GrabParams::* bool_value;
+    };
+    
+    const Field FIELDS[] = {
+        {"shoulder_grab_angle", &GrabParams::shoulder_grab_angle, nullptr, nullptr},
+        {"elbow_grab_angle", &GrabParams::elbow_grab_angle, nullptr, nullptr},
+        {"shoulder_lift_angle", &GrabParams::shoulder_lift_angle, nullptr, nullptr},
+        {"elbow_lift_angle", &GrabParams::elbow_lift_angle, nullptr, nullptr},
+        {"gripper_open_angle", &GrabParams::gripper_open_angle, nullptr, nullptr},
+        {"gripper_closed_angle", &GrabParams::gripper_closed_angle, nullptr, nullptr},
+        {"approach_steps", &GrabParams::approach_steps, nullptr, nullptr},
+        {"lift_steps", &GrabParams::lift_steps, nullptr, nullptr},
+        {"gripper_steps", &GrabParams::gripper_steps, nullptr, nullptr},
+        {"approach_speed", nullptr, &GrabParams::approach_speed, nullptr},
+        {"lift_speed", nullptr, &GrabParams::lift_speed, nullptr},
+        {"blend_deg", nullptr, &GrabParams::blend_deg, nullptr},
+        {"wait_settle", nullptr, nullptr, &GrabParams::wait_settle},
+        {"settle_dwell_ms", &GrabParams::settle_dwell_ms, nullptr, nullptr},
+        {"grip_dwell_ms", &GrabParams::grip_dwell_ms, nullptr, nullptr},
+        {"cooldown_ms", &GrabParams::cooldown_ms, nullptr, nullptr},
+    };
+}
+
+bool load_grab_params(const std::string& path, GrabParams& params) {
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+    
+    std::string line;
+    int line_number = 0;
+    while (std::getline(file, line)) {
+        line_number++;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) line.erase(comment);
+        
+        size_t equals = line.find('=');
+        if (equals == std::string::npos) continue;
+        
+        std::string key;
+        std::istringstream(line.substr(0, equals)) >> key;
+        std::istringstream value(line.substr(equals + 1));
+        
+        bool known = false;
+        for (const Field& field : FIELDS) {
+            if (key != field.key) continue;
+            known = true;
+            bool ok = field.int_value ? static_cast<bool>(value >> (params.*field.int_value))
+                    : field.float_value ? static_cast<bool>(value >> (params.*field.float_value))
+                    : static_cast<bool>(value >> (params.*field.bool_value));
+            if (!ok) {
+                std::cerr << path << ":" << line_number << ": bad value for " << key << std::endl;
+            }
+        }
+        if (!known) {
+            std::cerr << path << ":" << line_number << ": unknown key " << key << std::endl;
+        }
+    }
+    return true;
+}
+
+bool save_grab_params(const std::string& path, const GrabParams& params) {
+    std::ofstream file(path);
+    if (!file) {
+        std::cerr << "Failed to write " << path << std::endl;
+        return false;
+    }
+    
+    file << "# Grab routine parameters (see src/grab_params.h)\n";
+    for (const Field& field : FIELDS) {
+        file << field.key << " = ";
+        if (field.int_value) file << params.*field.int_value;
+        else if (field.float_value) file << params.*field.float_value;
+        else file << (params.*field.bool_value ? 1 : 0);
+        file << "\n";
+    }
+    return static_cast<bool>(file);
+}
+
+// Grab choreography as a dependency graph. Independent joints overlap:
+// the gripper opens while the arm descends, and both lift joints retract
+// together. Closing waits for the arm to be in place (and settled, unless
+// blending).
+MotionRoutine build_grab_routine(const GrabParams& params) {
+    MotionRoutine routine;
+    bool settle = params.wait_settle && params.blend_deg <= 0.0f;
+    
+    int shoulder_down = routine.addMove("shoulder_down", 1, params.shoulder_grab_angle,
+                                       params.approach_steps, {}, 0, settle);
+    int elbow_extend = routine.addMove("elbow_extend", 2, params.elbow_grab_angle,
+                                      params.approach_steps, {}, 0, settle);
+    int open_gripper = routine.addMove("open_gripper", 4, params.gripper_open_angle, params.gripper_steps);
+    routine.setSpeed(shoulder_down, params.approach_speed);
+    routine.setSpeed(elbow_extend, params.approach_speed);
+    routine.setBlend(shoulder_down, params.blend_deg);
+    routine.setBlend(elbow_extend, params.blend_deg);
+    
+    std::vector<int> before_close = {shoulder_down, elbow_extend, open_gripper};
+    if (params.settle_dwell_ms > 0) {
+        before_close = {routine.addDwell("settle_dwell", params.settle_dwell_ms, before_close)};
+    }
+    int close_gripper = routine.addMove("close_gripper", 4, params.gripper_closed_angle,
+                                       params.gripper_steps, before_close);
+    
+    std::vector<int> before_lift = {close_gripper};
+    if (params.grip_dwell_ms > 0) {
+        before_lift = {routine.addDwell("grip_dwell", params.grip_dwell_ms, before_lift)};
+    }
+    int shoulder_up = routine.addMove("shoulder_up", 1, params.shoulder_lift_angle, params.lift_steps, before_lift);
+    int elbow_retract = routine.addMove("elbow_retract", 2, params.elbow_lift_angle, params.lift_steps, before_lift);
+    routine.setSpeed(shoulder_up, params.lift_speed);
+    routine.setSpeed(elbow_retract, params.lift_speed);
+    return routine;
+}
@@ -0,0 +1,38 @@
+#ifndef GRAB_PARAMS_H
+#define GRAB_PARAMS_H
+
+#include <string>
+#include "motion_routine.h"
+
+// Tunable parameters of the auto-mode grab choreography. Defaults match
+// the original hand-written sequence; grab-tuner writes optimized values
+// to GRAB_PARAMS_FILE as key = value lines.
+struct GrabParams {
+    int shoulder_grab_angle = 45;
+    int elbow_grab_angle = 120;
+    int shoulder_lift_angle = 90;
+    int elbow_lift_angle = 90;
+    int gripper_open_angle = 0;
+    int gripper_closed_angle = 180;
+    int approach_steps = 5;
+    int lift_steps = 5;
+    int gripper_steps = 3;
+    float approach_speed = 0.0f;  // deg/s, 0 = servo slew limit
+    float lift_speed = 0.0f;      // deg/s, 0 = servo slew limit
+    float blend_deg = 0.0f;       // start closing this far before the approach ends
+    bool wait_settle = true;      // wait out residual vibration before closing
+    int settle_dwell_ms = 0;      // extra dwell before closing
+    int grip_dwell_ms = 0;        // dwell after closing, before lifting
+    int cooldown_ms = 3000;       // pause before the next detection
+};
+
+// Read parameters from a file; missing keys keep their current value
+bool load_grab_params(const std::string& path, GrabParams& params);
+
+// Write all parameters to a file
+bool save_grab_params(const std::string& path, const GrabParams& params);
+
+// Build the grab routine graph for the given parameters
+MotionRoutine build_grab_routine(const GrabParams& params);
+
+#endif // GRAB_PARAMS_H
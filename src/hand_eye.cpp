@@ -0,0 +1,609 @@
+#include "hand_eye.h"
+#include "../include/config.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+namespace {
+    const double PI = 3.14159265358979;
+    const double RAD_TO_DEG = 180.0 / PI;
+    const double MIN_CONDITION = 1e-4;    // eigenvalue ratio below which an axis is unobserved
+    const double INLIER_SIGMAS = 3.0;     // robust scales a pair may be off and still count
+    const double MIN_ROTATION_SCALE = 0.05 / RAD_TO_DEG;  // floor of the robust scales,
+    const double MIN_TRANSLATION_SCALE = 0.2;              // so exact data does not divide by 0
+    const int MAX_ITERATIONS = 20;
+    
+    typedef double Matrix[3][3];
+    
+    // A relative motion between two poses, as seen by the arm and by the camera
+    struct MotionPair {
+        RigidTransform a;   // gripper motion in the arm frame
+        RigidTransform b;   // fiducial motion in the camera frame
+        int first;          // sample indices
+        int second;
+        double alpha[3];    // rotation vectors of a and b
+        double beta[3];
+        double weight;
+        double rotation_error;
+        double translation_error;
+    };
+    
+    RigidTransform compose(const RigidTransform& x, const RigidTransform& y) {
+        RigidTransform result;
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) {
+                result.r[i][j] = x.r[i][0] * y.r[0][j] + x.r[i][1] * y.r[1][j] + x.r[i][2] * y.r[2][j];
+            }
+            result.t[i] = x.r[i][0] * y.t[0] + x.r[i][1] * y.t[1] + x.r[i][2] * y.t[2] + x.t[i];
+        }
+        return result;
+    }
+    
+    RigidTransform inverse(const RigidTransform& x) {
+        RigidTransform result;
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) {
+                result.r[i][j] = x.r[j][i];
+            }
+        }
+        for (int i = 0; i < 3; i++) {
+            result.t[i] = -(result.r[i][0] * x.t[0] + result.r[i][1] * x.t[1] + result.r[i][2] * x.t[2]);
+        }
+        return result;
+    }
+    
+    // From both the symmetric and antisymmetric parts, so small angles
+    // keep their precision (acos of the trace alone loses half the digits)
+    double rotation_angle(const Matrix r) {
+        double w[3] = { r[2][1] - r[1][2], r[0][2] - r[2][0], r[1][0] - r[0][1] };
+        double s = std::sqrt(w[0] * w[0] + w[1] * w[1] + w[2] * w[2]) / 2.0;
+        double c = (r[0][0] + r[1][1] + r[2][2] - 1.0) / 2.0;
+        return std::atan2(s, c);
+    }
+    
+    void rotation_vector(const Matrix r, double v[3]) {
+        double angle = rotation_angle(r);
+        double w[3] = { r[2][1] - r[1][2], r[0][2] - r[2][0], r[1][0] - r[0][1] };
+        double s = std::sqrt(w[0] * w[0] + w[1] * w[1] + w[2] * w[2]) / 2.0;
+        if (s < 1e-15 && angle < 1.0) {
+            v[0] = v[1] = v[2] = 0.0;
+        } else if (angle < 1.0 || s > 1e-6) {
+            for (int i = 0; i < 3; i++) v[i] = w[i] * angle / (2.0 * s);
+        } else {
+            // Near 180 deg the antisymmetric part vanishes; take the axis
+            // from the largest column of (R + I) / 2 = axis * axis^T
+            int k = 0;
+            for (int i = 1; i < 3; i++) {
+                if (r[i][i] > r[k][k]) k = i;
+            }
+            double axis[3];
+            double norm = 0.0;
+            for (int i = 0; i < 3; i++) {
+                axis[i] = (r[i][k] + (i == k ? 1.0 : 0.0)) / 2.0;
+                norm += axis[i] * axis[i];
+            }
+            norm = std::sqrt(norm);
+            for (int i = 0; i < 3; i++) v[i] = axis[i] / norm * angle;
+        }
+    }
+    
+    // Eigen-decomposition of a symmetric matrix by Jacobi rotations:
+    // a = v * diag(values) * v^T
+    void symmetric_eigen(const Matrix a, double values[3], Matrix v) {
+        Matrix m;
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) {
+                m[i][j] = a[i][j];
+                v[i][j] = (i == j) ? 1.0 : 0.0;
+            }
+        }
+        for (int sweep = 0; sweep < 50; sweep++) {
+            double off = m[0][1] * m[0][1] + m[0][2] * m[0][2] + m[1][2] * m[1][2];
+            if (off < 1e-30) break;
+            for (int p = 0; p < 2; p++) {
+                for (int q = p + 1; q < 3; q++) {
+                    if (std::fabs(m[p][q]) < 1e-300) continue;
+                    double theta = (m[q][q] - m[p][p]) / (2.0 * m[p][q]);
+                    double t = (theta >= 0 ? 1.0 : -1.0) / (std::fabs(theta) + std::sqrt(theta * theta + 1.0));
+                    double c = 1.0 / std::sqrt(t * t + 1.0);
+                    double s = t * c;
+                    for (int k = 0; k < 3; k++) {
+                        double mkp = m[k][p], mkq = m[k][q];
+                        m[k][p] = c * mkp - s * mkq;
+                        m[k][q] = s * mkp + c * mkq;
+                    }
+                    for (int k = 0; k < 3; k++) {
+                        double mpk = m[p][k], mqk = m[q][k];
+                        m[p][k] = c * mpk - s * mqk;
+                        m[q][k] = s * mpk + c * mqk;
+                    }
+                    for (int k = 0; k < 3; k++) {
+                        double vkp = v[k][p], vkq = v[k][q];
+                        v[k][p] = c * vkp - s * vkq;
+                        v[k][q] = s * vkp + c * vkq;
+                    }
+                }
+            }
+        }
+        for (int i = 0; i < 3; i++) values[i] = m[i][i];
+    }
+    
+    double determinant(const Matrix m) {
+        return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+             - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+             + m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+    }
+    
+    // Closest rotation to m: m * (m^T m)^(-1/2). False if m is rank
+    // deficient or a reflection.
+    bool nearest_rotation(const Matrix m, Matrix r) {
+        if (determinant(m) <= 0.0) return false;
+        
+        Matrix mtm;
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) {
+                mtm[i][j] = m[0][i] * m[0][j] + m[1][i] * m[1][j] + m[2][i] * m[2][j];
+            }
+        }
+        double values[3];
+        Matrix v;
+        symmetric_eigen(mtm, values, v);
+        double largest = std::max(values[0], std::max(values[1], values[2]));
+        double smallest = std::min(values[0], std::min(values[1], values[2]));
+        if (largest <= 0.0 || smallest < MIN_CONDITION * largest) return false;
+        
+        Matrix root;
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) {
+                root[i][j] = 0.0;
+                for (int k = 0; k < 3; k++) root[i][j] += v[i][k] * v[j][k] / std::sqrt(values[k]);
+            }
+        }
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) {
+                r[i][j] = m[i][0] * root[0][j] + m[i][1] * root[1][j] + m[i][2] * root[2][j];
+            }
+        }
+        return true;
+    }
+    
+    // Solve n * x = b for a symmetric positive definite n
+    bool solve_symmetric(const Matrix n, const double b[3], double x[3]) {
+        double values[3];
+        Matrix v;
+        symmetric_eigen(n, values, v);
+        double largest = std::max(values[0], std::max(values[1], values[2]));
+        if (largest <= 0.0) return false;
+        for (int k = 0; k < 3; k++) {
+            if (values[k] < MIN_CONDITION * largest) return false;
+        }
+        for (int i = 0; i < 3; i++) {
+            x[i] = 0.0;
+            for (int k = 0; k < 3; k++) {
+                double projection = v[0][k] * b[0] + v[1][k] * b[1] + v[2][k] * b[2];
+                x[i] += v[i][k] * projection / values[k];
+            }
+        }
+        return true;
+    }
+    
+    // Solve a * x = b by Gaussian elimination with partial pivoting; a is
+    // n x n, row major. False if a is singular for practical purposes.
+    bool solve_linear(std::vector<double> a, std::vector<double> b, std::vector<double>& x) {
+        int n = static_cast<int>(b.size());
+        double largest = 0.0;
+        for (double value : a) largest = std::max(largest, std::fabs(value));
+        for (int column = 0; column < n; column++) {
+            int pivot = column;
+            for (int row = column + 1; row < n; row++) {
+                if (std::fabs(a[row * n + column]) > std::fabs(a[pivot * n + column])) pivot = row;
+            }
+            if (std::fabs(a[pivot * n + column]) <= 1e-12 * largest) return false;
+            if (pivot != column) {
+                for (int k = 0; k < n; k++) std::swap(a[pivot * n + k], a[column * n + k]);
+                std::swap(b[pivot], b[column]);
+            }
+            for (int row = column + 1; row < n; row++) {
+                double factor = a[row * n + column] / a[column * n + column];
+                for (int k = column; k < n; k++) a[row * n + k] -= factor * a[column * n + k];
+                b[row] -= factor * b[column];
+            }
+        }
+        x.assign(n, 0.0);
+        for (int row = n - 1; row >= 0; row--) {
+            double sum = b[row];
+            for (int k = row + 1; k < n; k++) sum -= a[row * n + k] * x[k];
+            x[row] = sum / a[row * n + row];
+        }
+        return true;
+    }
+    
+    // Rotation of X from the weighted pairs (Park and Martin): alpha = R * beta
+    bool solve_rotation(const std::vector<MotionPair>& pairs, Matrix r) {
+        Matrix m = {};
+        for (const MotionPair& pair : pairs) {
+            for (int i = 0; i < 3; i++) {
+                for (int j = 0; j < 3; j++) {
+                    m[i][j] += pair.weight * pair.alpha[i] * pair.beta[j];
+                }
+            }
+        }
+        return nearest_rotation(m, r);
+    }
+    
+    // Translation of X from the weighted pairs: (Ra - I) t = R tb - ta
+    bool solve_translation(const std::vector<MotionPair>& pairs, const Matrix r, double t[3]) {
+        Matrix n = {};
+        double b[3] = {0.0, 0.0, 0.0};
+        for (const MotionPair& pair : pairs) {
+            Matrix c;
+            double d[3];
+            for (int i = 0; i < 3; i++) {
+                for (int j = 0; j < 3; j++) c[i][j] = pair.a.r[i][j] - (i == j ? 1.0 : 0.0);
+                d[i] = r[i][0] * pair.b.t[0] + r[i][1] * pair.b.t[1] + r[i][2] * pair.b.t[2] - pair.a.t[i];
+            }
+            for (int i = 0; i < 3; i++) {
+                for (int j = 0; j < 3; j++) {
+                    n[i][j] += pair.weight * (c[0][i] * c[0][j] + c[1][i] * c[1][j] + c[2][i] * c[2][j]);
+                }
+                b[i] += pair.weight * (c[0][i] * d[0] + c[1][i] * d[1] + c[2][i] * d[2]);
+            }
+        }
+        return solve_symmetric(n, b, t);
+    }
+    
+    bool solve_pairs(const std::vector<MotionPair>& pairs, RigidTransform& x) {
+        return solve_rotation(pairs, x.r) && solve_translation(pairs, x.r, x.t);
+    }
+    
+    // AX = XB residuals of each pair for the current estimate
+    void measure_residuals(std::vector<MotionPair>& pairs, const RigidTransform& x) {
+        for (MotionPair& pair : pairs) {
+            RigidTransform left = compose(pair.a, x);
+            RigidTransform right = compose(x, pair.b);
+            RigidTransform error = compose(inverse(left), right);
+            pair.rotation_error = rotation_angle(error.r);
+            double squared = 0.0;
+            for (int i = 0; i < 3; i++) {
+                double d = left.t[i] - right.t[i];
+                squared += d * d;
+            }
+            pair.translation_error = std::sqrt(squared);
+        }
+    }
+    
+    // Robust scale (MAD of residuals that are already non-negative)
+    double robust_scale(std::vector<double> values, double floor) {
+        std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+        return std::max(1.4826 * values[values.size() / 2], floor);
+    }
+    
+    // Tukey's biweight: redescending, so a gross outlier ends up with no
+    // weight at all instead of a small but still steering one
+    double tukey_weight(double u) {
+        if (u >= HAND_EYE_TUKEY_C) return 0.0;
+        double v = u / HAND_EYE_TUKEY_C;
+        return (1.0 - v * v) * (1.0 - v * v);
+    }
+    
+    // Small rotation (rad) and offset (mm) applied on the outside of a pose
+    RigidTransform nudge(const RigidTransform& pose, const double delta[6]) {
+        return compose(rigid_from_rotation_vector(delta, delta + 3), pose);
+    }
+    
+    // How far a sample is from the model: the gripper carries the marker,
+    // the camera sees it, so (G M)^-1 X C is the identity for exact data.
+    // Rotation vector (rad) then offset (mm).
+    void sample_residual(const HandEyeSample& sample, const RigidTransform& x, const RigidTransform& marker,
+                         double residual[6]) {
+        RigidTransform error = compose(inverse(compose(sample.gripper, marker)), compose(x, sample.fiducial));
+        rotation_vector(error.r, residual);
+        for (int i = 0; i < 3; i++) residual[3 + i] = error.t[i];
+    }
+    
+    double norm3(const double v[3]) {
+        return std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    }
+    
+    // Chordal mean of G^-1 X C over the samples, by weight
+    bool mean_marker(const std::vector<HandEyeSample>& samples, const std::vector<double>& weights,
+                     const RigidTransform& x, RigidTransform& marker) {
+        Matrix rotation_sum = {};
+        double translation_sum[3] = {0.0, 0.0, 0.0};
+        double weight_sum = 0.0;
+        for (size_t k = 0; k < samples.size(); k++) {
+            RigidTransform seen = compose(inverse(samples[k].gripper), compose(x, samples[k].fiducial));
+            for (int i = 0; i < 3; i++) {
+                for (int j = 0; j < 3; j++) rotation_sum[i][j] += weights[k] * seen.r[i][j];
+                translation_sum[i] += weights[k] * seen.t[i];
+            }
+            weight_sum += weights[k];
+        }
+        if (weight_sum <= 0.0 || !nearest_rotation(rotation_sum, marker.r)) return false;
+        for (int i = 0; i < 3; i++) marker.t[i] = translation_sum[i] / weight_sum;
+        return true;
+    }
+    
+    // Residuals of every sample (6 each) and their rotation (rad) and
+    // offset (mm) sizes
+    void measure_samples(const std::vector<HandEyeSample>& samples, const RigidTransform& x,
+                         const RigidTransform& marker, std::vector<double>& residuals,
+                         std::vector<double>& rotation_errors, std::vector<double>& translation_errors) {
+        size_t n = samples.size();
+        residuals.resize(n * 6);
+        rotation_errors.resize(n);
+        translation_errors.resize(n);
+        for (size_t k = 0; k < n; k++) {
+            sample_residual(samples[k], x, marker, &residuals[k * 6]);
+            rotation_errors[k] = norm3(&residuals[k * 6]);
+            translation_errors[k] = norm3(&residuals[k * 6 + 3]);
+        }
+    }
+    
+    // Refine the camera and marker poses together on the samples themselves
+    // (Gauss-Newton on a Tukey-weighted loss, scales from the median
+    // residual). The pair equations amplify translation noise when motions
+    // rotate little, and one bad sample spoils every pair it is in, so with
+    // a few bad samples most pairs are bad; here it costs one residual.
+    // Flags the samples within INLIER_SIGMAS of the result.
+    void refine(const std::vector<HandEyeSample>& samples, RigidTransform& x, RigidTransform& marker,
+                std::vector<bool>& inliers) {
+        const int n = static_cast<int>(samples.size());
+        const double steps[6] = {1e-6, 1e-6, 1e-6, 1e-4, 1e-4, 1e-4};
+        std::vector<double> residuals, rotation_errors, translation_errors, weights(n);
+        double rotation_scale = 0.0, translation_scale = 0.0;
+        
+        for (int iteration = 0; iteration <= MAX_ITERATIONS; iteration++) {
+            measure_samples(samples, x, marker, residuals, rotation_errors, translation_errors);
+            rotation_scale = robust_scale(rotation_errors, MIN_ROTATION_SCALE);
+            translation_scale = robust_scale(translation_errors, MIN_TRANSLATION_SCALE);
+            if (iteration == MAX_ITERATIONS) break;
+            for (int k = 0; k < n; k++) {
+                weights[k] = tukey_weight(std::max(rotation_errors[k] / rotation_scale,
+                                                   translation_errors[k] / translation_scale));
+            }
+            double norms[6] = {rotation_scale, rotation_scale, rotation_scale,
+                               translation_scale, translation_scale, translation_scale};
+            
+            // Normal equations over the 12 parameters (camera, then marker),
+            // with residuals in robust scales and numeric derivatives
+            std::vector<double> normal(144, 0.0), gradient(12, 0.0);
+            for (int k = 0; k < n; k++) {
+                if (weights[k] <= 0.0) continue;
+                double jacobian[6][12];
+                for (int p = 0; p < 12; p++) {
+                    double delta[6] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+                    delta[p % 6] = steps[p % 6];
+                    double moved[6];
+                    if (p < 6) {
+                        sample_residual(samples[k], nudge(x, delta), marker, moved);
+                    } else {
+                        sample_residual(samples[k], x, nudge(marker, delta), moved);
+                    }
+                    for (int i = 0; i < 6; i++) {
+                        jacobian[i][p] = (moved[i] - residuals[k * 6 + i]) / steps[p % 6] / norms[i];
+                    }
+                }
+                for (int i = 0; i < 6; i++) {
+                    double r = residuals[k * 6 + i] / norms[i];
+                    for (int p = 0; p < 12; p++) {
+                        gradient[p] -= weights[k] * jacobian[i][p] * r;
+                        for (int q = 0; q < 12; q++) normal[p * 12 + q] += weights[k] * jacobian[i][p] * jacobian[i][q];
+                    }
+                }
+            }
+            std::vector<double> step;
+            if (!solve_linear(normal, gradient, step)) break; // Too few samples left to move
+            
+            x = nudge(x, &step[0]);
+            marker = nudge(marker, &step[6]);
+            double largest = 0.0;
+            for (int p = 0; p < 12; p++) largest = std::max(largest, std::fabs(step[p]) / steps[p % 6]);
+            if (largest < 1.0) {
+                // Below the derivative steps: converged
+                measure_samples(samples, x, marker, residuals, rotation_errors, translation_errors);
+                rotation_scale = robust_scale(rotation_errors, MIN_ROTATION_SCALE);
+                translation_scale = robust_scale(translation_errors, MIN_TRANSLATION_SCALE);
+                break;
+            }
+        }
+        
+        inliers.assign(n, false);
+        for (int k = 0; k < n; k++) {
+            inliers[k] = rotation_errors[k] <= INLIER_SIGMAS * rotation_scale &&
+                         translation_errors[k] <= INLIER_SIGMAS * translation_scale;
+        }
+    }
+}
+
+RigidTransform rigid_from_rotation_vector(const double rotation[3], const double translation[3]) {
+    RigidTransform pose;
+    double angle = std::sqrt(rotation[0] * rotation[0] + rotation[1] * rotation[1] + rotation[2] * rotation[2]);
+    double k[3] = {0.0, 0.0, 1.0};
+    if (angle > 1e-12) {
+        for (int i = 0; i < 3; i++) k[i] = rotation[i] / angle;
+    }
+    
+    // Rodrigues: R = I cos + (1 - cos) k k^T + sin [k]x
+    double c = std::cos(angle), s = std::sin(angle);
+    double cross[3][3] = {
+        { 0.0, -k[2], k[1] },
+        { k[2], 0.0, -k[0] },
+        { -k[1], k[0], 0.0 },
+    };
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            pose.r[i][j] = (i == j ? c : 0.0) + (1.0 - c) * k[i] * k[j] + s * cross[i][j];
+        }
+        pose.t[i] = translation[i];
+    }
+    return pose;
+}
+
+ArmPoint rigid_apply(const RigidTransform& pose, const ArmPoint& point) {
+    double p[3] = { point.x, point.y, point.z };
+    double q[3];
+    for (int i = 0; i < 3; i++) {
+        q[i] = pose.r[i][0] * p[0] + pose.r[i][1] * p[1] + pose.r[i][2] * p[2] + pose.t[i];
+    }
+    return { static_cast<float>(q[0]), static_cast<float>(q[1]), static_cast<float>(q[2]) };
+}
+
+bool solve_hand_eye(const std::vector<HandEyeSample>& samples, HandEyeResult& result) {
+    // Every pair of poses is a motion; pairs that barely rotate carry no
+    // rotation axis and only add noise
+    std::vector<MotionPair> pairs;
+    for (size_t i = 0; i < samples.size(); i++) {
+        for (size_t j = i + 1; j < samples.size(); j++) {
+            MotionPair pair;
+            pair.a = compose(samples[j].gripper, inverse(samples[i].gripper));
+            pair.b = compose(samples[j].fiducial, inverse(samples[i].fiducial));
+            if (rotation_angle(pair.a.r) * RAD_TO_DEG < HAND_EYE_MIN_ROTATION_DEG) continue;
+            pair.first = static_cast<int>(i);
+            pair.second = static_cast<int>(j);
+            rotation_vector(pair.a.r, pair.alpha);
+            rotation_vector(pair.b.r, pair.beta);
+            pair.weight = 1.0;
+            pairs.push_back(pair);
+        }
+    }
+    result.pairs = static_cast<int>(pairs.size());
+    if (pairs.size() < 3) {
+        std::cerr << "Hand-eye: " << pairs.size() << " usable pose pairs, need 3" << std::endl;
+        return false;
+    }
+    
+    // Robust start: both motions of a pair rotate by the same angle, so a
+    // mismatch marks a bad observation without knowing X. A sample scores
+    // the median mismatch of its pairs, which stays small for a good sample
+    // as long as most others are good too. Fit the pairs between the better
+    // half of the samples first, adding samples in score order until the
+    // pairs constrain the solution.
+    std::vector<std::vector<double>> mismatches(samples.size());
+    for (const MotionPair& pair : pairs) {
+        double mismatch = std::fabs(norm3(pair.alpha) - norm3(pair.beta));
+        mismatches[pair.first].push_back(mismatch);
+        mismatches[pair.second].push_back(mismatch);
+    }
+    std::vector<double> scores(samples.size(), 0.0);
+    for (size_t k = 0; k < samples.size(); k++) {
+        std::vector<double>& own = mismatches[k];
+        if (own.empty()) continue;
+        std::nth_element(own.begin(), own.begin() + own.size() / 2, own.end());
+        scores[k] = own[own.size() / 2];
+    }
+    std::vector<double> ranked_scores = scores;
+    std::sort(ranked_scores.begin(), ranked_scores.end());
+    
+    RigidTransform x;
+    std::vector<double> start_weights(samples.size(), 0.0);
+    bool started = false;
+    for (size_t count = (samples.size() + 1) / 2; count <= samples.size() && !started; count++) {
+        double trim = ranked_scores[count - 1];
+        for (MotionPair& pair : pairs) {
+            pair.weight = (scores[pair.first] <= trim && scores[pair.second] <= trim) ? 1.0 : 0.0;
+        }
+        for (size_t k = 0; k < samples.size(); k++) {
+            start_weights[k] = scores[k] <= trim ? 1.0 : 0.0;
+        }
+        started = solve_pairs(pairs, x);
+    }
+    if (!started) {
+        std::cerr << "Hand-eye: poses do not rotate about two axes" << std::endl;
+        return false;
+    }
+    
+    // Marker from the same samples, then both poses robustly over all of them
+    RigidTransform marker;
+    if (!mean_marker(samples, start_weights, x, marker)) {
+        std::cerr << "Hand-eye: no consistent fiducial mounting" << std::endl;
+        return false;
+    }
+    std::vector<bool> inliers;
+    refine(samples, x, marker, inliers);
+    result.camera = x;
+    result.marker = marker;
+    
+    // Report the AX = XB residual over the pairs between inlying samples
+    measure_residuals(pairs, x);
+    result.inliers = 0;
+    double rotation_sum = 0.0, translation_sum = 0.0;
+    for (const MotionPair& pair : pairs) {
+        if (!inliers[pair.first] || !inliers[pair.second]) continue;
+        result.inliers++;
+        rotation_sum += pair.rotation_error * pair.rotation_error;
+        translation_sum += pair.translation_error * pair.translation_error;
+    }
+    if (result.inliers > 0) {
+        result.rotation_rms_deg = std::sqrt(rotation_sum / result.inliers) * RAD_TO_DEG;
+        result.translation_rms_mm = std::sqrt(translation_sum / result.inliers);
+    }
+    return true;
+}
+
+bool load_hand_eye(const std::string& path, RigidTransform& camera) {
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+    
+    double rotation[3], translation[3];
+    bool have_rotation = false, have_translation = false;
+    std::string line;
+    int line_number = 0;
+    while (std::getline(file, line)) {
+        line_number++;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) line.erase(comment);
+        
+        size_t equals = line.find('=');
+        if (equals == std::string::npos) continue;
+        
+        std::string key;
+        std::istringstream(line.substr(0, equals)) >> key;
+        std::istringstream value(line.substr(equals + 1));
+        
+        if (key == "rotation") {
+            have_rotation = static_cast<bool>(value >> rotation[0] >> rotation[1] >> rotation[2]);
+        } else if (key == "translation") {
+            have_translation = static_cast<bool>(value >> translation[0] >> translation[1] >> translation[2]);
+        } else {
+            std::cerr << path << ":" << line_number << ": unknown key " << key << std::endl;
+            continue;
+        }
+        if (!value) {
+            std::cerr << path << ":" << line_number << ": bad value for " << key << std::endl;
+        }
+    }
+    if (!have_rotation || !have_translation) {
+        std::cerr << path << ": needs rotation and translation" << std::endl;
+        return false;
+    }
+    camera = rigid_from_rotation_vector(rotation, translation);
+    return true;
+}
+
+bool save_hand_eye(const std::string& path, const HandEyeResult& result) {
+    std::ofstream file(path);
+    if (!file) {
+        std::cerr << "Failed to write " << path << std::endl;
+        return false;
+    }
+    
+    double rotation[3];
+    rotation_vector(result.camera.r, rotation);
+    double marker_rotation[3];
+    rotation_vector(result.marker.r, marker_rotation);
+    
+    file << "# Camera pose in the arm frame from HANDEYE (see src/hand_eye.h)\n";
+    file << "# " << result.inliers << "/" << result.pairs << " pose pairs, residual "
+         << result.rotation_rms_deg << " deg, " << result.translation_rms_mm << " mm\n";
+    file << "# fiducial in the gripper frame: rotation " << marker_rotation[0] << " "
+         << marker_rotation[1] << " " << marker_rotation[2] << ", translation "
+         << result.marker.t[0] << " " << result.marker.t[1] << " " << result.marker.t[2] << "\n";
+    file << "rotation = " << rotation[0] << " " << rotation[1] << " " << rotation[2] << "\n";
+    file << "translation = " << result.camera.t[0] << " " << result.camera.t[1] << " " << result.camera.t[2] << "\n";
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,46 @@
+#ifndef HAND_EYE_H
+#define HAND_EYE_H
+
+#include <string>
+#include <vector>
+#include "kinematics.h"
+
+// Hand-eye calibration for the fixed camera: the arm carries a fiducial
+// through a set of poses, the vision node reports where it sees it, and
+// the solver recovers the camera pose in the arm frame (AX = XB, with A
+// the gripper motion between two poses and B the fiducial motion seen by
+// the camera).
+struct HandEyeSample {
+    RigidTransform gripper;   // gripper frame in the arm frame (forward kinematics)
+    RigidTransform fiducial;  // fiducial in the camera frame (vision node)
+};
+
+struct HandEyeResult {
+    RigidTransform camera;    // camera frame in the arm frame
+    RigidTransform marker;    // fiducial in the gripper frame (mounting check)
+    int pairs = 0;            // pose pairs used
+    int inliers = 0;          // pairs between samples the robust fit kept
+    double rotation_rms_deg = 0.0;     // AX = XB residual over the inliers
+    double translation_rms_mm = 0.0;
+};
+
+// Rotation vector (axis * angle, rad) and translation (mm) to a transform
+RigidTransform rigid_from_rotation_vector(const double rotation[3], const double translation[3]);
+
+// Transform a point into the outer frame
+ArmPoint rigid_apply(const RigidTransform& pose, const ArmPoint& point);
+
+// Solve for the camera pose from at least three samples whose motions
+// rotate about two different axes. Starts from the half of the samples
+// whose motions agree best, then refines the camera and fiducial poses over
+// all samples with a redescending (Tukey) loss, so outlying observations (a
+// misdetected fiducial, a joint that missed its target) drop out as long as
+// most samples are good. Returns false if the poses do not constrain the
+// solution.
+bool solve_hand_eye(const std::vector<HandEyeSample>& samples, HandEyeResult& result);
+
+// Camera pose stored as key = value lines (rotation vector and translation)
+bool load_hand_eye(const std::string& path, RigidTransform& camera);
+bool save_hand_eye(const std::string& path, const HandEyeResult& result);
+
+#endif // HAND_EYE_H
@@ -0,0 +1,239 @@
+#include "http_server.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace {
+    const size_t MAX_REQUEST_BYTES = 8192;
+    const int POLL_MS = 200;          // how often the thread checks for stop()
+    const int RECEIVE_TIMEOUT_S = 2;  // slow clients are dropped
+    
+    std::string url_decode(const std::string& text) {
+        std::string out;
+        for (size_t i = 0; i < text.size(); i++) {
+            if (text[i] == '+') {
+                out += ' ';
+            } else if (text[i] == '%' && i + 2 < text.size()) {
+                out += static_cast<char>(std::strtol(text.substr(i + 1, 2).c_str(), nullptr, 16));
+                i += 2;
+            } else {
+                out += text[i];
+            }
+        }
+        return out;
+    }
+    
+    void parse_query(const std::string& query, std::map<std::string, std::string>& params) {
+        size_t start = 0;
+        while (start < query.size()) {
+            size_t end = query.find('&', start);
+            if (end == std::string::npos) end = query.size();
+            std::string pair = query.substr(start, end - start);
+            size_t equals = pair.find('=');
+            if (equals == std::string::npos) {
+                params[url_decode(pair)] = "";
+            } else {
+                params[url_decode(pair.substr(0, equals))] = url_decode(pair.substr(equals + 1));
+            }
+            start = end + 1;
+        }
+    }
+    
+    const char* status_text(int status) {
+        switch (status) {
+            case 200: return "OK";
+            case 400: return "Bad Request";
+            case 404: return "Not Found";
+            case 405: return "Method Not Allowed";
+            case 500: return "Internal Server Error";
+        }
+        return "Unknown";
+    }
+    
+    void send_all(int fd, const char* data, size_t size) {
+        while (size > 0) {
+            ssize_t sent = send(fd, data, size, MSG_NOSIGNAL);
+            if (sent < 0) {
+                if (errno == EINTR) continue;
+                return;
+            }
+            data += sent;
+            size -= sent;
+        }
+    }
+}
+
+HttpServer::HttpServer() : running(false) {
+}
+
+HttpServer::~HttpServer() {
+    stop();
+}
+
+void HttpServer::route(const std::string& path, Handler handler) {
+    routes.push_back(std::make_pair(path, handler));
+}
+
+bool HttpServer::listenTcp(const char* address, int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        std::cerr << "HTTP socket failed: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, address, &addr.sin_addr) != 1) {
+        std::cerr << "Invalid HTTP bind address: " << address << std::endl;
+        close(fd);
+        return false;
+    }
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(fd, 8) < 0) {
+        std::cerr << "HTTP listen on " << address << ":" << port << " failed: " << std::strerror(errno) << std::endl;
+        close(fd);
+        return false;
+    }
+    listeners.push_back(fd);
+    return true;
+}
+
+bool HttpServer::listenUnix(const char* path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        std::cerr << "HTTP socket failed: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (std::strlen(path) >= sizeof(addr.sun_path)) {
+        std::cerr << "Unix socket path too long: " << path << std::endl;
+        close(fd);
+        return false;
+    }
+    std::strcpy(addr.sun_path, path);
+    unlink(path); // Left behind by a previous run
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(fd, 8) < 0) {
+        std::cerr << "HTTP listen on " << path << " failed: " << std::strerror(errno) << std::endl;
+        close(fd);
+        return false;
+    }
+    unix_path = path;
+    listeners.push_back(fd);
+    return true;
+}
+
+bool HttpServer::start() {
+    if (listeners.empty() || running) {
+        return false;
+    }
+    running = true;
+    if (!thread.start([this]() { serve(); })) {
+        running = false;
+        return false;
+    }
+    return true;
+}
+
+void HttpServer::stop() {
+    running = false;
+    if (thread.joinable()) {
+        thread.join();
+    }
+    for (int fd : listeners) {
+        close(fd);
+    }
+    listeners.clear();
+    if (!unix_path.empty()) {
+        unlink(unix_path.c_str());
+        unix_path.clear();
+    }
+}
+
+void HttpServer::serve() {
+    std::vector<pollfd> fds(listeners.size());
+    for (size_t i = 0; i < listeners.size(); i++) {
+        fds[i].fd = listeners[i];
+        fds[i].events = POLLIN;
+    }
+    
+    while (running) {
+        int ready = poll(fds.data(), fds.size(), POLL_MS);
+        if (ready <= 0) continue;
+        for (pollfd& p : fds) {
+            if (!(p.revents & POLLIN)) continue;
+            int client = accept(p.fd, nullptr, nullptr);
+            if (client >= 0) {
+                handleConnection(client);
+                close(client);
+            }
+        }
+    }
+}
+
+void HttpServer::handleConnection(int fd) {
+    timeval timeout;
+    timeout.tv_sec = RECEIVE_TIMEOUT_S;
+    timeout.tv_usec = 0;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    
+    // Only the request line and headers matter, GET has no body
+    std::string request;
+    char buffer[1024];
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < MAX_REQUEST_BYTES) {
+        ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+        if (received <= 0) break;
+        request.append(buffer, received);
+    }
+    
+    HttpRequest parsed;
+    HttpResponse response;
+    size_t method_end = request.find(' ');
+    size_t target_end = method_end == std::string::npos ? std::string::npos : request.find(' ', method_end + 1);
+    if (target_end == std::string::npos) {
+        response.status = 400;
+        response.body = "Bad request\n";
+    } else {
+        parsed.method = request.substr(0, method_end);
+        std::string target = request.substr(method_end + 1, target_end - method_end - 1);
+        size_t question = target.find('?');
+        parsed.path = url_decode(target.substr(0, question));
+        if (question != std::string::npos) {
+            parse_query(target.substr(question + 1), parsed.query);
+        }
+        
+        if (parsed.method != "GET") {
+            response.status = 405;
+            response.body = "Only GET is supported\n";
+        } else {
+            response.status = 404;
+            response.body = "Not found\n";
+            for (const auto& route : routes) {
+                if (route.first == parsed.path) {
+                    response = HttpResponse();
+                    route.second(parsed, response);
+                    break;
+                }
+            }
+        }
+    }
+    
+    std::string header = "HTTP/1.0 " + std::to_string(response.status) + " " + status_text(response.status) +
+                         "\r\nContent-Type: " + response.content_type +
+                         "\r\nContent-Length: " + std::to_string(response.body.size()) +
+                         "\r\nConnection: close\r\n\r\n";
+    send_all(fd, header.data(), header.size());
+    send_all(fd, response.body.data(), response.body.size());
+}
@@ -0,0 +1,58 @@
+#ifndef HTTP_SERVER_H
+#define HTTP_SERVER_H
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include "rt_thread.h"
+
+struct HttpRequest {
+    std::string method;
+    std::string path;                           // without the query string
+    std::map<std::string, std::string> query;   // decoded query parameters
+};
+
+struct HttpResponse {
+    int status = 200;
+    std::string content_type = "text/plain; charset=utf-8";
+    std::string body;
+};
+
+// Minimal HTTP/1.0 server for local tooling (metrics scrapes, queries).
+// One background thread serves GET requests one connection at a time and
+// closes the connection after each response. It listens on a TCP address,
+// a Unix socket, or both. Not meant to face the network.
+class HttpServer {
+public:
+    typedef std::function<void(const HttpRequest&, HttpResponse&)> Handler;
+    
+private:
+    std::vector<int> listeners;
+    std::vector<std::pair<std::string, Handler>> routes;
+    std::string unix_path;
+    RtThread thread;
+    std::atomic<bool> running;
+    
+    void serve();
+    void handleConnection(int fd);
+    
+public:
+    HttpServer();
+    ~HttpServer();
+    
+    HttpServer(const HttpServer&) = delete;
+    HttpServer& operator=(const HttpServer&) = delete;
+    
+    // Add a handler for an exact path; register before start()
+    void route(const std::string& path, Handler handler);
+    
+    bool listenTcp(const char* address, int port);
+    bool listenUnix(const char* path);
+    
+    bool start();
+    void stop();
+};
+
+#endif // HTTP_SERVER_H
@@ -0,0 +1,194 @@
+#include "input_shaper.h"
+#include "clock.h"
+#include "scratch_arena.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    const float PI = 3.14159265f;
+    const float SETTLE_BAND_LN = 3.9f;  // ln(1/0.02), 2% band
+}
+
+InputShaper::InputShaper() :
+    type(SHAPER_NONE),
+    frequency(5.0f),
+    damping(0.05f),
+    impulse_count(1),
+    head(0),
+    count(0) {
+    design();
+    reset(90.0f);
+}
+
+void InputShaper::design() {
+    float root = std::sqrt(1.0f - damping * damping);
+    float k = std::exp(-damping * PI / root);
+    float damped_period = 1.0f / (frequency * root);
+    Duration half = std::chrono::duration_cast<Duration>(std::chrono::duration<float>(damped_period / 2.0f));
+    
+    delay[0] = Duration::zero();
+    amplitude[0] = 1.0f;
+    
+    if (type == SHAPER_ZV) {
+        impulse_count = 2;
+        amplitude[0] = 1.0f / (1.0f + k);
+        amplitude[1] = k / (1.0f + k);
+        delay[1] = half;
+    } else if (type == SHAPER_ZVD) {
+        float norm = (1.0f + k) * (1.0f + k);
+        impulse_count = 3;
+        amplitude[0] = 1.0f / norm;
+        amplitude[1] = 2.0f * k / norm;
+        amplitude[2] = k * k / norm;
+        delay[1] = half;
+        delay[2] = half * 2;
+    } else {
+        impulse_count = 1;
+    }
+}
+
+bool InputShaper::configure(ShaperType new_type, float frequency_hz, float damping_ratio) {
+    if (frequency_hz <= 0.0f || damping_ratio < 0.0f || damping_ratio >= 1.0f) {
+        return false;
+    }
+    
+    // Keep the current output as the held value so reconfiguring never jumps
+    float current = output(arm_clock().now());
+    type = new_type;
+    frequency = frequency_hz;
+    damping = damping_ratio;
+    design();
+    reset(current);
+    return true;
+}
+
+float InputShaper::referenceAt(TimePoint when) const {
+    // Latest change at or before the requested time
+    for (int i = count - 1; i >= 0; i--) {
+        const Sample& sample = history[(head + i) % SHAPER_HISTORY];
+        if (sample.time <= when) {
+            return sample.value;
+        }
+    }
+    return history[head].value;
+}
+
+void InputShaper::setReference(float value, TimePoint now) {
+    // Forget changes that no delayed impulse can reach any more,
+    // keeping the newest of them as the baseline
+    TimePoint horizon = now - delay[impulse_count - 1];
+    while (count >= 2 && history[(head + 1) % SHAPER_HISTORY].time <= horizon) {
+        head = (head + 1) % SHAPER_HISTORY;
+        count--;
+    }
+    
+    if (count == SHAPER_HISTORY) {
+        head = (head + 1) % SHAPER_HISTORY;
+        count--;
+    }
+    
+    history[(head + count) % SHAPER_HISTORY] = { now, value };
+    count++;
+}
+
+void InputShaper::reset(float value) {
+    head = 0;
+    count = 1;
+    history[0] = { TimePoint::min(), value };
+}
+
+float InputShaper::output(TimePoint now) const {
+    float value = 0.0f;
+    for (int i = 0; i < impulse_count; i++) {
+        value += amplitude[i] * referenceAt(now - delay[i]);
+    }
+    return value;
+}
+
+InputShaper::TimePoint InputShaper::settledTime() const {
+    const Sample& newest = history[(head + count - 1) % SHAPER_HISTORY];
+    if (newest.time == TimePoint::min()) {
+        return newest.time;
+    }
+    return newest.time + delay[impulse_count - 1];
+}
+
+InputShaper::Duration InputShaper::shaperDuration() const {
+    return delay[impulse_count - 1];
+}
+
+std::chrono::milliseconds InputShaper::residualSettleTime() const {
+    if (type != SHAPER_NONE || damping <= 0.0f) {
+        return std::chrono::milliseconds(0);
+    }
+    float omega = 2.0f * PI * frequency;
+    return std::chrono::milliseconds(static_cast<int>(SETTLE_BAND_LN / (damping * omega) * 1000.0f));
+}
+
+bool InputShaper::identify(const float* samples, int sample_count, float sample_period,
+                           float& frequency_hz, float& damping_ratio) {
+    if (sample_count < 10 || sample_period <= 0.0f) {
+        return false;
+    }
+    
+    // Light smoothing against ranging noise (scratch lives in the calibration arena)
+    ArenaScope scope;
+    ArenaVector<float> smooth(sample_count);
+    for (int i = 0; i < sample_count; i++) {
+        int lo = std::max(0, i - 1);
+        int hi = std::min(sample_count - 1, i + 1);
+        float sum = 0.0f;
+        for (int j = lo; j <= hi; j++) sum += samples[j];
+        smooth[i] = sum / (hi - lo + 1);
+    }
+    
+    // Final value from the last fifth of the record
+    int tail = std::max(1, sample_count / 5);
+    float final_value = 0.0f;
+    for (int i = sample_count - tail; i < sample_count; i++) final_value += smooth[i];
+    final_value /= tail;
+    
+    float largest = 0.0f;
+    for (float v : smooth) largest = std::max(largest, std::fabs(v - final_value));
+    if (largest <= 0.0f) {
+        return false;
+    }
+    
+    // Alternating extrema of the error signal, ignoring noise-level wiggles
+    ArenaVector<int> peak_index;
+    ArenaVector<float> peak_value;
+    peak_index.reserve(sample_count / 2);
+    peak_value.reserve(sample_count / 2);
+    for (int i = 1; i < sample_count - 1; i++) {
+        float e = smooth[i] - final_value;
+        float prev = smooth[i - 1] - final_value;
+        float next = smooth[i + 1] - final_value;
+        bool extremum = (e > 0 && e >= prev && e > next) || (e < 0 && e <= prev && e < next);
+        if (!extremum || std::fabs(e) < 0.1f * largest) continue;
+        
+        if (!peak_value.empty() && (peak_value.back() > 0) == (e > 0)) {
+            // Same lobe - keep the larger one
+            if (std::fabs(e) > std::fabs(peak_value.back())) {
+                peak_index.back() = i;
+                peak_value.back() = e;
+            }
+            continue;
+        }
+        peak_index.push_back(i);
+        peak_value.push_back(e);
+    }
+    
+    if (peak_index.size() < 3) {
+        return false;
+    }
+    
+    // Consecutive extrema are half a damped period apart
+    int half_periods = static_cast<int>(peak_index.size()) - 1;
+    float damped_period = 2.0f * (peak_index.back() - peak_index.front()) * sample_period / half_periods;
+    float decrement = 2.0f * std::log(std::fabs(peak_value.front() / peak_value.back())) / half_periods;
+    decrement = std::max(0.0f, decrement);
+    
+    damping_ratio = decrement / std::sqrt(4.0f * PI * PI + decrement * decrement);
+    frequency_hz = 1.0f / (damped_period * std::sqrt(1.0f - damping_ratio * damping_ratio));
+    return true;
+}
@@ -0,0 +1,79 @@
+#ifndef INPUT_SHAPER_H
+#define INPUT_SHAPER_H
+
+#include <chrono>
+#include "../include/config.h"
+
+enum ShaperType {
+    SHAPER_NONE = 0,
+    SHAPER_ZV = 1,   // two impulses, duration half a damped period
+    SHAPER_ZVD = 2   // three impulses, more robust to frequency error
+};
+
+// Zero-vibration input shaper for a single joint. The reference angle is
+// convolved with a short impulse sequence tuned to the joint's natural
+// frequency and damping, cancelling the residual oscillation of the link.
+class InputShaper {
+public:
+    typedef std::chrono::steady_clock::time_point TimePoint;
+    typedef std::chrono::steady_clock::duration Duration;
+    
+private:
+    struct Sample {
+        TimePoint time;
+        float value;
+    };
+    
+    ShaperType type;
+    float frequency;     // Hz
+    float damping;       // zeta
+    int impulse_count;
+    float amplitude[3];
+    Duration delay[3];
+    
+    Sample history[SHAPER_HISTORY];  // ring of reference changes
+    int head;
+    int count;
+    
+    void design();
+    float referenceAt(TimePoint when) const;
+    
+public:
+    InputShaper();
+    
+    // Select shaper type and vibration mode (Hz, damping ratio)
+    bool configure(ShaperType type, float frequency_hz, float damping_ratio);
+    
+    ShaperType getType() const { return type; }
+    float getFrequency() const { return frequency; }
+    float getDamping() const { return damping; }
+    
+    // Record a new reference value at the given time
+    void setReference(float value, TimePoint now);
+    
+    // Clear history and hold a value
+    void reset(float value);
+    
+    // Shaped output at the given time
+    float output(TimePoint now) const;
+    
+    // When the last impulse of the last reference change is applied
+    // (TimePoint::min() before any change)
+    TimePoint settledTime() const;
+    
+    // Length of the impulse sequence (added delay)
+    Duration shaperDuration() const;
+    
+    // Expected 2% settling time of the residual vibration after a move.
+    // Zero when shaping is active (the vibration is cancelled by design).
+    std::chrono::milliseconds residualSettleTime() const;
+    
+    // Estimate natural frequency and damping from a recorded step response
+    // (uniformly sampled, sample_period in seconds). Returns false if fewer
+    // than three extrema (peaks and troughs, i.e. one full oscillation) can
+    // be found.
+    static bool identify(const float* samples, int sample_count, float sample_period,
+                         float& frequency_hz, float& damping_ratio);
+};
+
+#endif // INPUT_SHAPER_H
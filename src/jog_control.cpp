@@ -0,0 +1,151 @@
+#include "jog_control.h"
+#include "kinematics.h"
+#include "servo_control.h"
+#include <algorithm>
+#include <cmath>
+
+JogControl::JogControl() : cartesian(false), active(false), seeded(false) {
+    clearTargets();
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        velocity[i] = 0.0f;
+        position[i] = 90.0f;
+        written[i] = -1;
+    }
+}
+
+void JogControl::clearTargets() {
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        target_velocity[i] = 0.0f;
+    }
+    for (int i = 0; i < 3; i++) {
+        cartesian_velocity[i] = 0.0f;
+    }
+}
+
+bool JogControl::setJointVelocity(int servo_id, float deg_per_s) {
+    if (servo_id < 0 || servo_id >= SERVO_COUNT) {
+        return false;
+    }
+    
+    std::lock_guard<std::mutex> lock(mutex);
+    if (cartesian) {
+        clearTargets();
+        cartesian = false;
+    }
+    target_velocity[servo_id] = std::max(-JOG_MAX_VELOCITY, std::min(JOG_MAX_VELOCITY, deg_per_s));
+    last_refresh = arm_clock().now();
+    active = true;
+    return true;
+}
+
+void JogControl::setCartesianVelocity(float vx, float vy, float vz) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!cartesian) {
+        clearTargets();
+        cartesian = true;
+    }
+    
+    // Limit the speed, keeping the direction
+    float speed = std::sqrt(vx * vx + vy * vy + vz * vz);
+    float scale = speed > JOG_MAX_CARTESIAN_SPEED ? JOG_MAX_CARTESIAN_SPEED / speed : 1.0f;
+    cartesian_velocity[0] = vx * scale;
+    cartesian_velocity[1] = vy * scale;
+    cartesian_velocity[2] = vz * scale;
+    last_refresh = arm_clock().now();
+    active = true;
+}
+
+void JogControl::stop() {
+    std::lock_guard<std::mutex> lock(mutex);
+    clearTargets();
+}
+
+void JogControl::halt() {
+    std::lock_guard<std::mutex> lock(mutex);
+    clearTargets();
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        velocity[i] = 0.0f;
+    }
+    active = false;
+    seeded = false;
+}
+
+bool JogControl::update(float dt, ServoControl& servo) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!active) {
+        return false;
+    }
+    
+    // Start integrating from wherever the servos were left
+    if (!seeded) {
+        for (int i = 0; i < SERVO_COUNT; i++) {
+            position[i] = static_cast<float>(servo.getServoAngle(i));
+            written[i] = servo.getServoAngle(i);
+            velocity[i] = 0.0f;
+        }
+        seeded = true;
+    }
+    
+    // Dead-man: no refresh means the operator let go
+    auto elapsed = arm_clock().now() - last_refresh;
+    if (elapsed > std::chrono::milliseconds(JOG_TIMEOUT_MS)) {
+        clearTargets();
+    }
+    
+    float target[SERVO_COUNT];
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        target[i] = cartesian ? 0.0f : target_velocity[i];
+    }
+    
+    if (cartesian) {
+        float joint_velocity[3];
+        if (arm_cartesian_to_joint_velocity(position[0], position[1], position[2],
+                                            cartesian_velocity[0], cartesian_velocity[1],
+                                            cartesian_velocity[2], joint_velocity)) {
+            // Scale all three together so the path stays straight
+            float peak = std::max({std::fabs(joint_velocity[0]), std::fabs(joint_velocity[1]),
+                                   std::fabs(joint_velocity[2])});
+            float scale = peak > JOG_MAX_VELOCITY ? JOG_MAX_VELOCITY / peak : 1.0f;
+            for (int i = 0; i < 3; i++) {
+                target[i] = joint_velocity[i] * scale;
+            }
+        }
+    }
+    
+    bool moving = false;
+    float max_delta_v = JOG_MAX_ACCEL * dt;
+    
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        float delta_v = std::max(-max_delta_v, std::min(max_delta_v, target[i] - velocity[i]));
+        velocity[i] += delta_v;
+        position[i] += velocity[i] * dt;
+        
+        // Stop at the joint limits instead of winding up past them
+        if (position[i] <= MIN_SERVO_ANGLE || position[i] >= MAX_SERVO_ANGLE) {
+            position[i] = std::max(static_cast<float>(MIN_SERVO_ANGLE),
+                                   std::min(static_cast<float>(MAX_SERVO_ANGLE), position[i]));
+            velocity[i] = 0.0f;
+        }
+        
+        int angle = static_cast<int>(std::lround(position[i]));
+        if (angle != written[i] && servo.admitStart(i)) {
+            servo.writeServoAngle(i, angle);
+            written[i] = angle;
+        }
+        
+        if (velocity[i] != 0.0f || target[i] != 0.0f || angle != written[i]) {
+            moving = true;
+        }
+    }
+    
+    if (!moving) {
+        active = false;
+        seeded = false;
+    }
+    return moving;
+}
+
+bool JogControl::isActive() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return active;
+}
@@ -0,0 +1,52 @@
+#ifndef JOG_CONTROL_H
+#define JOG_CONTROL_H
+
+#include <mutex>
+#include <chrono>
+#include "../include/config.h"
+#include "clock.h"
+
+class ServoControl;
+
+// Velocity-mode teleoperation. Commands set a target velocity per joint
+// (or for the wrist in Cartesian space); update() integrates them on the
+// control tick under velocity and acceleration limits. If no command
+// refreshes the target within JOG_TIMEOUT_MS the arm ramps to a stop.
+class JogControl {
+private:
+    mutable std::mutex mutex;
+    float target_velocity[SERVO_COUNT];   // deg/s, joint mode
+    float cartesian_velocity[3];          // mm/s, Cartesian mode
+    bool cartesian;
+    float velocity[SERVO_COUNT];          // current ramped velocity
+    float position[SERVO_COUNT];          // integrated position
+    int written[SERVO_COUNT];             // last angle sent to the servo
+    bool active;
+    bool seeded;
+    Clock::TimePoint last_refresh;
+    
+    void clearTargets();
+    
+public:
+    JogControl();
+    
+    // Set target velocity of a single joint (deg/s), refreshes the dead-man timer
+    bool setJointVelocity(int servo_id, float deg_per_s);
+    
+    // Set target wrist velocity (mm/s), refreshes the dead-man timer
+    void setCartesianVelocity(float vx, float vy, float vz);
+    
+    // Ramp down to a stop under the acceleration limit
+    void stop();
+    
+    // Drop all velocity immediately (emergency stop / mode change)
+    void halt();
+    
+    // Integrate one control tick and write changed angles.
+    // Returns true while the jog is still moving.
+    bool update(float dt, ServoControl& servo);
+    
+    bool isActive() const;
+};
+
+#endif // JOG_CONTROL_H
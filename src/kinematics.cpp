@@ -0,0 +1,104 @@
+#include "kinematics.h"
+#include "../include/config.h"
+#include <cmath>
+
+namespace {
+    const float DEG_TO_RAD = 3.14159265f / 180.0f;
+    const float RAD_TO_DEG = 180.0f / 3.14159265f;
+    const float MIN_DETERMINANT = 0.05f;  // sin(elbow) below ~3 deg is singular
+    const float MIN_RADIUS_MM = 10.0f;
+}
+
+ArmPoint arm_forward_kinematics(float base, float shoulder, float elbow) {
+    float yaw = (base - 90.0f) * DEG_TO_RAD;
+    float q1 = shoulder * DEG_TO_RAD;
+    float q12 = q1 + (elbow - 180.0f) * DEG_TO_RAD;
+    
+    float r = ARM_UPPER_LINK_MM * std::cos(q1) + ARM_FORE_LINK_MM * std::cos(q12);
+    float z = ARM_BASE_HEIGHT_MM + ARM_UPPER_LINK_MM * std::sin(q1) + ARM_FORE_LINK_MM * std::sin(q12);
+    
+    return { r * std::cos(yaw), r * std::sin(yaw), z };
+}
+
+void arm_chain(float base, float shoulder, float elbow, ArmPoint points[4]) {
+    float yaw = (base - 90.0f) * DEG_TO_RAD;
+    float q1 = shoulder * DEG_TO_RAD;
+    float q12 = q1 + (elbow - 180.0f) * DEG_TO_RAD;
+    float c = std::cos(yaw);
+    float s = std::sin(yaw);
+    
+    // Radius and height of each point in the arm plane
+    float r[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    float z[4] = {ARM_BASE_HEIGHT_MM, 0.0f, 0.0f, 0.0f};
+    r[1] = ARM_UPPER_LINK_MM * std::cos(q1);
+    z[1] = z[0] + ARM_UPPER_LINK_MM * std::sin(q1);
+    r[2] = r[1] + ARM_FORE_LINK_MM * std::cos(q12);
+    z[2] = z[1] + ARM_FORE_LINK_MM * std::sin(q12);
+    r[3] = r[2] + ARM_GRIPPER_LINK_MM * std::cos(q12);
+    z[3] = z[2] + ARM_GRIPPER_LINK_MM * std::sin(q12);
+    
+    for (int i = 0; i < 4; i++) {
+        points[i] = { r[i] * c, r[i] * s, z[i] };
+    }
+}
+
+RigidTransform arm_gripper_pose(float base, float shoulder, float elbow, float wrist) {
+    double yaw = (base - 90.0f) * DEG_TO_RAD;
+    double pitch = (shoulder + (elbow - 180.0f) + (wrist - 90.0f)) * DEG_TO_RAD;
+    double cy = std::cos(yaw), sy = std::sin(yaw);
+    double cp = std::cos(pitch), sp = std::sin(pitch);
+    
+    ArmPoint wrist_point = arm_forward_kinematics(base, shoulder, elbow);
+    
+    // Columns are the gripper axes in arm coordinates
+    RigidTransform pose;
+    double x[3] = { cp * cy, cp * sy, sp };
+    double y[3] = { -sy, cy, 0.0 };
+    double z[3] = { -sp * cy, -sp * sy, cp };
+    for (int i = 0; i < 3; i++) {
+        pose.r[i][0] = x[i];
+        pose.r[i][1] = y[i];
+        pose.r[i][2] = z[i];
+    }
+    pose.t[0] = wrist_point.x + ARM_GRIPPER_LINK_MM * x[0];
+    pose.t[1] = wrist_point.y + ARM_GRIPPER_LINK_MM * x[1];
+    pose.t[2] = wrist_point.z + ARM_GRIPPER_LINK_MM * x[2];
+    return pose;
+}
+
+bool arm_cartesian_to_joint_velocity(float base, float shoulder, float elbow,
+                                     float vx, float vy, float vz,
+                                     float joint_velocity[3]) {
+    float q1 = shoulder * DEG_TO_RAD;
+    float q2 = (elbow - 180.0f) * DEG_TO_RAD;
+    float q12 = q1 + q2;
+    
+    ArmPoint p = arm_forward_kinematics(base, shoulder, elbow);
+    float r = std::sqrt(p.x * p.x + p.y * p.y);
+    if (r < MIN_RADIUS_MM) {
+        return false; // Wrist over the base axis, yaw is undefined
+    }
+    
+    // Split the horizontal velocity into radial and tangential parts
+    float r_dot = (p.x * vx + p.y * vy) / r;
+    float yaw_dot = (p.x * vy - p.y * vx) / (r * r);
+    
+    // Invert the 2x2 planar Jacobian (r, z) <- (q1, q2)
+    float j11 = -ARM_UPPER_LINK_MM * std::sin(q1) - ARM_FORE_LINK_MM * std::sin(q12);
+    float j12 = -ARM_FORE_LINK_MM * std::sin(q12);
+    float j21 = ARM_UPPER_LINK_MM * std::cos(q1) + ARM_FORE_LINK_MM * std::cos(q12);
+    float j22 = ARM_FORE_LINK_MM * std::cos(q12);
+    
+    float det = j11 * j22 - j12 * j21; // = L1 * L2 * sin(q2)
+    if (std::fabs(det) < MIN_DETERMINANT * ARM_UPPER_LINK_MM * ARM_FORE_LINK_MM) {
+        return false;
+    }
+    
+    float q1_dot = (j22 * r_dot - j12 * vz) / det;
+    float q2_dot = (-j21 * r_dot + j11 * vz) / det;
+    
+    joint_velocity[0] = yaw_dot * RAD_TO_DEG;
+    joint_velocity[1] = q1_dot * RAD_TO_DEG;
+    joint_velocity[2] = q2_dot * RAD_TO_DEG;
+    return true;
+}
@@ -0,0 +1,39 @@
+#ifndef KINEMATICS_H
+#define KINEMATICS_H
+
+// Simplified arm model: base yaw plus a planar shoulder/elbow chain.
+// Servo angles are in degrees as written to the servos:
+//   base 90      -> arm points along +x
+//   shoulder 90  -> upper link vertical, lower values lean forward
+//   elbow 180    -> forearm in line with upper link, 90 -> right angle
+//   wrist 90     -> gripper in line with the forearm, higher values pitch up
+struct ArmPoint {
+    float x;  // mm, forward
+    float y;  // mm, left
+    float z;  // mm, above table
+};
+
+// Pose of a frame in another: p_outer = r * p_inner + t (mm)
+struct RigidTransform {
+    double r[3][3];
+    double t[3];
+};
+
+// Wrist position for the given base/shoulder/elbow servo angles
+ArmPoint arm_forward_kinematics(float base, float shoulder, float elbow);
+
+// Joint positions along the chain: shoulder axis, elbow, wrist and
+// fingertips (the gripper is modeled in line with the forearm)
+void arm_chain(float base, float shoulder, float elbow, ArmPoint points[4]);
+
+// Gripper frame in the arm frame: origin at the fingertips, x along the
+// gripper, y horizontal to the left of it, z completing the right hand
+RigidTransform arm_gripper_pose(float base, float shoulder, float elbow, float wrist);
+
+// Convert a Cartesian wrist velocity (mm/s) into base/shoulder/elbow
+// servo velocities (deg/s). Returns false near a singular pose.
+bool arm_cartesian_to_joint_velocity(float base, float shoulder, float elbow,
+                                     float vx, float vy, float vz,
+                                     float joint_velocity[3]);
+
+#endif // KINEMATICS_H
@@ -1,21 +1,75 @@
 #include <iostream>
-#include <thread>
 #include <chrono>
 #include <signal.h>
 #include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <vector>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <string>
-#include <sstream>
 #include <mosquitto.h>
 #include "servo_control.h"
 #include "sensor_ultrasonic.h"
+#include "jog_control.h"
+#include "setpoint_stream.h"
+#include "auto_controller.h"
+#include "grab_params.h"
+#include "hand_eye.h"
+#include "telemetry_store.h"
+#include "clock.h"
+#include "rt_memory.h"
+#include "rt_thread.h"
+#include "scratch_arena.h"
+#include "message_pool.h"
+#include "flight_recorder.h"
+#include "probes.h"
+#include "metrics.h"
+#include "http_server.h"
 #include "../include/config.h"
 
 // Global components
 ServoControl servo_control;
 UltrasonicSensor ultrasonic;
+JogControl jog_control;
+SetpointStream setpoint_stream;
+GrabParams grab_params;
+AutoController auto_controller(servo_control, ultrasonic, grab_params);
+MessagePool message_pool;
 struct mosquitto *mosq = nullptr;
+MessageHandle in_flight[MESSAGE_POOL_SIZE];   // published, waiting for on_publish (MQTT thread only)
+int in_flight_mid[MESSAGE_POOL_SIZE];
 std::atomic<bool> running(true);
 std::atomic<bool> auto_mode(true);
+std::atomic<int> shaper_calibration_request(-1);
+std::atomic<bool> hand_eye_request(false);
+std::atomic<long long> control_heartbeat_ms(0);   // arm_clock() time of the last control tick
+std::atomic<int> control_tick_hz(0);              // current control loop rate
+std::mutex control_wake_mutex;
+std::condition_variable control_wake;
+bool control_wake_pending = false;                // a command arrived since the loop last slept
+HttpServer http_server;
+TelemetryStore telemetry_store;
+
+// Hand-eye calibration: latest fiducial report from the vision node
+std::mutex fiducial_mutex;
+std::condition_variable fiducial_ready;
+int fiducial_index = -1;                          // capture the report answers
+bool fiducial_found = false;
+double fiducial_pose[6];                          // rotation vector, translation (mm)
+
+// Controller metrics, registered before the control loop starts
+const char* const command_names[] = {
+    "MODE", "SERVO", "JOG", "JOGXYZ", "SETPOINT", "SERVOCAL", "SHAPER", "SHAPERPARAM",
+    "SHAPERCAL", "HANDEYE", "STREAM_DELAY", "JOGSTOP", "MOTOR", "BELT", "STOP", "HOME", "DUMP"
+};
+const int COMMAND_KINDS = sizeof(command_names) / sizeof(command_names[0]);
+MetricCounter* command_counters[COMMAND_KINDS + 1];   // last counts unknown commands
+MetricHistogram* tick_seconds[2];                     // by mode: manual, auto
+MetricCounter* tick_overruns = nullptr;
 
 // External motor driver functions
 extern "C" {
@@ -31,48 +85,218 @@ void signal_handler(int signal) {
     running = false;
 }
 
-// MQTT message callback
+// Cut the control loop's idle wait short, e.g. when a command arrives
+void wake_control_loop() {
+    {
+        std::lock_guard<std::mutex> lock(control_wake_mutex);
+        control_wake_pending = true;
+    }
+    arm_clock().notifyAll(control_wake);
+}
+
+// Parse up to count floats from the cursor; advances it past what was read
+static int parse_floats(const char*& cursor, float* values, int count) {
+    int parsed = 0;
+    while (parsed < count) {
+        char* end;
+        float value = std::strtof(cursor, &end);
+        if (end == cursor) break;
+        values[parsed++] = value;
+        cursor = end;
+    }
+    return parsed;
+}
+
+// MQTT message callback. Parses in place on the stack: nothing is allocated
+// per message.
 void on_message(struct mosquitto *mosq, void *userdata, const struct mosquitto_message *message) {
-    std::string topic(message->topic);
-    std::string payload((char*)message->payload, message->payloadlen);
+    RtNoAllocScope no_alloc("on_message");
+    ARM_PROBE2(command_receive, message->payload, message->payloadlen);
+    
+    char payload[MQTT_MAX_PAYLOAD];
+    int length = std::min(message->payloadlen, MQTT_MAX_PAYLOAD - 1);
+    std::memcpy(payload, message->payload, length);
+    payload[length] = '\0';
+    flight_record_text(FLIGHT_COMMAND, 0, payload, length);
     
-    std::cout << "Received MQTT message - Topic: " << topic << ", Payload: " << payload << std::endl;
+    std::cout << "Received MQTT message - Topic: " << message->topic << ", Payload: " << payload << std::endl;
     
-    if (topic == MQTT_TOPIC_CONTROL) {
+    if (std::strcmp(message->topic, MQTT_TOPIC_CONTROL) == 0) {
         // Parse control commands
-        std::istringstream iss(payload);
-        std::string command;
-        iss >> command;
+        char command[16];
+        int consumed = 0;
+        if (std::sscanf(payload, "%15s%n", command, &consumed) != 1) {
+            return;
+        }
+        const char* args = payload + consumed;
+        ARM_PROBE2(command_parse, command, args);
         
-        if (command == "MODE") {
-            std::string mode;
-            iss >> mode;
-            auto_mode = (mode == "AUTO");
+        int kind = 0;
+        while (kind < COMMAND_KINDS && std::strcmp(command, command_names[kind]) != 0) kind++;
+        command_counters[kind]->inc();
+        
+        if (std::strcmp(command, "MODE") == 0) {
+            char mode[16] = "";
+            std::sscanf(args, "%15s", mode);
+            auto_mode = (std::strcmp(mode, "AUTO") == 0);
+            flight_record(FLIGHT_EVENT, FLIGHT_EVENT_MODE, auto_mode ? 1 : 0);
+            telemetry_store.recordEvent(TELEMETRY_EVENT_MODE);
+            auto_controller.wake(); // The control loop may be waiting for a part
+            jog_control.halt();
+            setpoint_stream.reset();
             std::cout << "Switched to " << (auto_mode ? "AUTO" : "MANUAL") << " mode" << std::endl;
         }
-        else if (command == "SERVO" && !auto_mode) {
+        else if (std::strcmp(command, "SERVO") == 0 && !auto_mode) {
             int servo_id, angle;
-            if (iss >> servo_id >> angle) {
-                servo_control.setServoAngle(servo_id, angle);
+            if (std::sscanf(args, "%d %d", &servo_id, &angle) == 2) {
+                servo_control.writeServoAngle(servo_id, angle); // Arrival is tracked by the servo model
                 std::cout << "Manual servo control: " << servo_id << " -> " << angle << "°" << std::endl;
             }
         }
-        else if (command == "MOTOR" && !auto_mode) {
+        else if (std::strcmp(command, "JOG") == 0 && !auto_mode) {
+            // JOG <id> <deg/s> - must be refreshed within JOG_TIMEOUT_MS
+            int servo_id;
+            float velocity;
+            if (std::sscanf(args, "%d %f", &servo_id, &velocity) == 2) {
+                setpoint_stream.reset();
+                jog_control.setJointVelocity(servo_id, velocity);
+            }
+        }
+        else if (std::strcmp(command, "JOGXYZ") == 0 && !auto_mode) {
+            // JOGXYZ <vx> <vy> <vz> in mm/s
+            float velocity[3];
+            if (parse_floats(args, velocity, 3) == 3) {
+                setpoint_stream.reset();
+                jog_control.setCartesianVelocity(velocity[0], velocity[1], velocity[2]);
+            }
+        }
+        else if (std::strcmp(command, "SETPOINT") == 0 && !auto_mode) {
+            // SETPOINT <sender_time_ms> <a0> <a1> <a2> <a3> <a4>
+            char* end;
+            long long sender_time = std::strtoll(args, &end, 10);
+            float angles[SERVO_COUNT];
+            if (end != args) {
+                args = end;
+                if (parse_floats(args, angles, SERVO_COUNT) == SERVO_COUNT) {
+                    jog_control.halt();
+                    setpoint_stream.push(sender_time, angles);
+                }
+            }
+        }
+        else if (std::strcmp(command, "SERVOCAL") == 0) {
+            // SERVOCAL <id> <speed deg/s> <deadband deg>
+            int servo_id;
+            float speed, deadband;
+            if (std::sscanf(args, "%d %f %f", &servo_id, &speed, &deadband) == 3 &&
+                servo_control.getModel().setCalibration(servo_id, speed, deadband)) {
+                std::cout << "Servo " << servo_id << " model: " << speed << " deg/s, deadband "
+                          << deadband << "°" << std::endl;
+            }
+        }
+        else if (std::strcmp(command, "SHAPER") == 0) {
+            // SHAPER OFF|ZV|ZVD
+            char type[8] = "";
+            std::sscanf(args, "%7s", type);
+            bool zv = std::strcmp(type, "ZV") == 0;
+            bool zvd = std::strcmp(type, "ZVD") == 0;
+            if (zv || zvd || std::strcmp(type, "OFF") == 0) {
+                servo_control.setShaperType(zv ? SHAPER_ZV : zvd ? SHAPER_ZVD : SHAPER_NONE);
+                std::cout << "Input shaping: " << type << std::endl;
+            }
+        }
+        else if (std::strcmp(command, "SHAPERPARAM") == 0) {
+            // SHAPERPARAM <id> <frequency Hz> <damping ratio>
+            int servo_id;
+            float frequency, damping;
+            if (std::sscanf(args, "%d %f %f", &servo_id, &frequency, &damping) == 3 &&
+                servo_control.configureShaper(servo_id, frequency, damping)) {
+                std::cout << "Servo " << servo_id << " shaper: " << frequency << " Hz, zeta "
+                          << damping << std::endl;
+            }
+        }
+        else if (std::strcmp(command, "SHAPERCAL") == 0 && !auto_mode) {
+            // Runs on the control thread, it takes a few seconds
+            int servo_id;
+            if (std::sscanf(args, "%d", &servo_id) == 1 && servo_id >= 0 && servo_id < SERVO_COUNT) {
+                shaper_calibration_request = servo_id;
+            }
+        }
+        else if (std::strcmp(command, "HANDEYE") == 0 && !auto_mode) {
+            // Runs on the control thread with the vision node answering captures
+            hand_eye_request = true;
+        }
+        else if (std::strcmp(command, "STREAM_DELAY") == 0) {
+            int delay;
+            if (std::sscanf(args, "%d", &delay) == 1) {
+                setpoint_stream.setDelay(delay);
+                std::cout << "Setpoint stream delay: " << setpoint_stream.getDelay() << " ms" << std::endl;
+            }
+        }
+        else if (std::strcmp(command, "JOGSTOP") == 0) {
+            jog_control.stop();
+        }
+        else if (std::strcmp(command, "MOTOR") == 0 && !auto_mode) {
             int speed;
-            if (iss >> speed) {
+            if (std::sscanf(args, "%d", &speed) == 1) {
                 motor_set_speed(speed);
+                servo_control.getBudget().setMotorSpeed(motor_get_speed());
                 std::cout << "Manual motor control: " << speed << std::endl;
             }
         }
-        else if (command == "STOP") {
+        else if (std::strcmp(command, "BELT") == 0) {
+            ConveyorCoordinator& conveyor = auto_controller.getConveyor();
+            char setting[16] = "";
+            int speed;
+            std::sscanf(args, "%15s", setting);
+            if (std::sscanf(setting, "%d", &speed) == 1) {
+                conveyor.setRunSpeed(speed);
+                conveyor.setCoordinated(true);
+                std::cout << "Auto mode belt speed: " << conveyor.getRunSpeed() << std::endl;
+            } else if (std::strcmp(setting, "OFF") == 0) {
+                conveyor.setCoordinated(false);
+                std::cout << "Belt coordination off" << std::endl;
+            }
+        }
+        else if (std::strcmp(command, "STOP") == 0) {
+            jog_control.halt();
+            setpoint_stream.reset();
             servo_control.emergencyStop();
             motor_stop();
+            servo_control.getBudget().setMotorSpeed(0);
             std::cout << "Emergency stop activated" << std::endl;
+            telemetry_store.recordEvent(TELEMETRY_EVENT_STOP);
+            flight_recorder_dump(FLIGHT_DUMP_ESTOP);
+        }
+        else if (std::strcmp(command, "DUMP") == 0) {
+            flight_record(FLIGHT_EVENT, FLIGHT_EVENT_DUMP, FLIGHT_DUMP_REQUEST);
+            if (flight_recorder_dump(FLIGHT_DUMP_REQUEST)) {
+                std::cout << "Flight recorder dumped to " << FLIGHT_RECORDER_DIR << std::endl;
+            } else {
+                std::cerr << "Flight recorder dump failed" << std::endl;
+            }
         }
-        else if (command == "HOME") {
+        else if (std::strcmp(command, "HOME") == 0) {
             servo_control.moveToHome();
+            telemetry_store.recordEvent(TELEMETRY_EVENT_HOME);
             std::cout << "Moving to home position" << std::endl;
         }
+        wake_control_loop(); // Back to the active rate if the command started motion
+        ARM_PROBE1(command_done, command);
+    }
+    else if (std::strcmp(message->topic, MQTT_TOPIC_FIDUCIAL) == 0) {
+        // <capture> <rx> <ry> <rz> <tx> <ty> <tz>, fiducial in the camera
+        // frame, or <capture> none
+        int index;
+        double pose[6];
+        int parsed = std::sscanf(payload, "%d %lf %lf %lf %lf %lf %lf", &index,
+                                 &pose[0], &pose[1], &pose[2], &pose[3], &pose[4], &pose[5]);
+        if (parsed >= 1) {
+            std::lock_guard<std::mutex> lock(fiducial_mutex);
+            fiducial_index = index;
+            fiducial_found = parsed == 7;
+            std::copy(pose, pose + 6, fiducial_pose);
+        }
+        arm_clock().notifyAll(fiducial_ready);
     }
 }
 
@@ -81,11 +305,52 @@ void on_connect(struct mosquitto *mosq, void *userdata, int result) {
     if (result == 0) {
         std::cout << "Connected to MQTT broker" << std::endl;
         mosquitto_subscribe(mosq, nullptr, MQTT_TOPIC_CONTROL, 0);
+        mosquitto_subscribe(mosq, nullptr, MQTT_TOPIC_FIDUCIAL, 0);
     } else {
         std::cerr << "Failed to connect to MQTT broker: " << result << std::endl;
     }
 }
 
+// Send queued messages (MQTT thread). Each buffer is held until libmosquitto
+// reports it written, then goes back to the pool.
+void send_pending_messages() {
+    for (MessageHandle message = message_pool.pop(); message; message = message_pool.pop()) {
+        int slot = 0;
+        while (slot < MESSAGE_POOL_SIZE && in_flight[slot]) slot++;
+        if (slot == MESSAGE_POOL_SIZE) {
+            break; // Cannot happen: there are as many slots as buffers
+        }
+        
+        // The mid is written before the packet goes out, so on_publish can
+        // find the slot even if the send completes inside this call
+        in_flight[slot] = message;
+        int result = mosquitto_publish(mosq, &in_flight_mid[slot], message.topic(), message.length(),
+                                       message.data(), 0, false);
+        ARM_PROBE4(publish_send, message.topic(), message.data(), message.length(), result);
+        if (result != MOSQ_ERR_SUCCESS) {
+            in_flight[slot].reset(); // Not connected - the frame is lost
+        }
+    }
+}
+
+// MQTT publish callback: the message with this mid has been sent
+void on_publish(struct mosquitto *mosq, void *userdata, int mid) {
+    for (int i = 0; i < MESSAGE_POOL_SIZE; i++) {
+        if (in_flight[i] && in_flight_mid[i] == mid) {
+            in_flight[i].reset();
+            return;
+        }
+    }
+}
+
+// MQTT disconnect callback: unsent messages will not be confirmed
+void on_disconnect(struct mosquitto *mosq, void *userdata, int result) {
+    for (int i = 0; i < MESSAGE_POOL_SIZE; i++) {
+        in_flight[i].reset();
+    }
+    std::cerr << "Disconnected from MQTT broker: " << result << std::endl;
+}
+
 // Initialize MQTT
 bool initialize_mqtt() {
     mosquitto_lib_init();
@@ -98,6 +363,8 @@ bool initialize_mqtt() {
     
     mosquitto_connect_callback_set(mosq, on_connect);
     mosquitto_message_callback_set(mosq, on_message);
+    mosquitto_publish_callback_set(mosq, on_publish);
+    mosquitto_disconnect_callback_set(mosq, on_disconnect);
     
     int result = mosquitto_connect(mosq, MQTT_BROKER_HOST, MQTT_BROKER_PORT, 60);
     if (result != MOSQ_ERR_SUCCESS) {
@@ -108,73 +375,561 @@ bool initialize_mqtt() {
     return true;
 }
 
-// Publish status data
+// Append formatted text to a fixed buffer, truncating at its end
+static void append(char* buffer, size_t size, size_t& length, const char* format, ...) {
+    if (length >= size) return;
+    va_list args;
+    va_start(args, format);
+    int written = std::vsnprintf(buffer + length, size - length, format, args);
+    va_end(args);
+    if (written > 0) {
+        length = std::min(size, length + written);
+    }
+}
+
+// Publish status data, serialized straight into a pooled message buffer
 void publish_status() {
     if (!mosq) return;
     
-    std::ostringstream status;
-    status << "{"
-           << "\"mode\":\"" << (auto_mode ? "AUTO" : "MANUAL") << "\","
-           << "\"distance\":" << ultrasonic.getDistance() << ","
-           << "\"servos\":[";
+    RtNoAllocScope no_alloc("publish_status");
+    MessageHandle message = message_pool.acquire(MESSAGE_TELEMETRY);
+    if (!message) {
+        return; // Pool exhausted by unsent messages - skip this frame
+    }
+    char* status = message.data();
+    const size_t size = message.capacity();
+    size_t length = 0;
     
-    auto angles = servo_control.getAllAngles();
+    // The ranging thread owns the sensor in both modes; never wait for an echo here
+    float distance = auto_controller.getMonitor().getLastDistance();
+    append(status, size, length, "{\"mode\":\"%s\",\"distance\":%g,\"servos\":[",
+           auto_mode ? "AUTO" : "MANUAL", distance);
+    
+    const std::vector<int>& angles = servo_control.getAllAngles();
     for (size_t i = 0; i < angles.size(); i++) {
-        status << angles[i];
-        if (i < angles.size() - 1) status << ",";
+        append(status, size, length, i < angles.size() - 1 ? "%d," : "%d", angles[i]);
     }
     
-    status << "],"
-           << "\"motor_speed\":" << motor_get_speed()
-           << "}";
+    append(status, size, length, "],\"servos_est\":[");
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        append(status, size, length, i < SERVO_COUNT - 1 ? "%d," : "%d",
+               static_cast<int>(servo_control.getEstimatedAngle(i) + 0.5f));
+    }
     
-    std::string status_str = status.str();
-    mosquitto_publish(mosq, nullptr, MQTT_TOPIC_STATUS, status_str.length(), status_str.c_str(), 0, false);
+    append(status, size, length, "],\"moving\":[");
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        append(status, size, length, i < SERVO_COUNT - 1 ? "%s," : "%s",
+               servo_control.hasArrived(i) ? "false" : "true");
+    }
+    
+    append(status, size, length, "],\"settle_ms\":[");
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        append(status, size, length, i < SERVO_COUNT - 1 ? "%lld," : "%lld",
+               static_cast<long long>(servo_control.getSettleTime(i).count()));
+    }
+    
+    append(status, size, length, "],\"energized\":[");
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        append(status, size, length, i < SERVO_COUNT - 1 ? "%s," : "%s",
+               servo_control.isEnergized(i) ? "true" : "false");
+    }
+    
+    append(status, size, length, "],\"duty\":[");
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        append(status, size, length, i < SERVO_COUNT - 1 ? "%.3f," : "%.3f", servo_control.getDuty(i));
+    }
+    append(status, size, length, "],\"idle_saving_ma\":%g,\"idle_saved_mah\":%.1f",
+           servo_control.getIdleSavingMa(), servo_control.getIdleSavedMah());
+    
+    ConveyorCoordinator& conveyor = auto_controller.getConveyor();
+    append(status, size, length, ",\"belt\":{\"coordinated\":%s,\"run_speed\":%d,\"slowdowns\":%lu,\"stops\":%lu}",
+           conveyor.isEngaged() ? "true" : "false", conveyor.getRunSpeed(), conveyor.getSlowdowns(),
+           conveyor.getStops());
+    
+    CurrentBudget& budget = servo_control.getBudget();
+    append(status, size, length, ",\"supply\":{\"ma\":%.0f,\"peak_ma\":%.0f,\"deferrals\":%lu,\"overloads\":%lu}",
+           budget.supplyAt(arm_clock().now()), budget.getPeak(), budget.getDeferrals(), budget.getOverloads());
+    
+    ShaperType shaper = servo_control.getShaperType();
+    append(status, size, length,
+           ",\"shaper\":\"%s\",\"motor_speed\":%d,\"jog\":%s,\"stream\":%s,\"tick_hz\":%d,"
+           "\"messages\":{\"free\":%d,\"dropped\":%lu,\"refused\":%lu}}",
+           shaper == SHAPER_ZV ? "ZV" : shaper == SHAPER_ZVD ? "ZVD" : "OFF",
+           motor_get_speed(),
+           jog_control.isActive() ? "true" : "false",
+           setpoint_stream.isActive() ? "true" : "false",
+           control_tick_hz.load(),
+           message_pool.freeCount(), message_pool.droppedCount(), message_pool.refusedCount());
+    
+    if (length >= size) {
+        std::cerr << "Status message truncated, raise MESSAGE_BUFFER_SIZE" << std::endl;
+        return;
+    }
+    message.setLength(length);
+    ARM_PROBE3(publish_submit, MQTT_TOPIC_STATUS, message.data(), length);
+    message_pool.submit(message, MQTT_TOPIC_STATUS); // Sent by the MQTT thread
+}
+
+// Publish the phase breakdown of the grab cycle that just finished
+void publish_cycle_profile() {
+    if (!mosq) return;
+    
+    RtNoAllocScope no_alloc("publish_cycle_profile");
+    MessageHandle message = message_pool.acquire(MESSAGE_TELEMETRY);
+    if (!message) {
+        return;
+    }
+    size_t length = auto_controller.getProfiler().formatCycle(message.data(), message.capacity());
+    if (length >= message.capacity()) {
+        std::cerr << "Cycle profile truncated, raise MESSAGE_BUFFER_SIZE" << std::endl;
+        return;
+    }
+    message.setLength(length);
+    ARM_PROBE3(publish_submit, MQTT_TOPIC_DATA, message.data(), length);
+    message_pool.submit(message, MQTT_TOPIC_DATA);
+}
+
+// Identify a joint's vibration mode from a step move. The ultrasonic
+// sensor must see the moving link (or a target fixed to it).
+void calibrate_shaper(int servo_id) {
+    const int sample_period_ms = 40;
+    const int sample_count = SHAPER_CAL_DURATION_MS / sample_period_ms;
+    
+    std::cout << "Calibrating input shaper for servo " << servo_id << "..." << std::endl;
+    ShaperType type = servo_control.getShaperType();
+    servo_control.setShaperType(SHAPER_NONE);
+    
+    int start_angle = servo_control.getServoAngle(servo_id);
+    int step_angle = start_angle + SHAPER_CAL_STEP_DEG <= MAX_SERVO_ANGLE
+                         ? start_angle + SHAPER_CAL_STEP_DEG
+                         : start_angle - SHAPER_CAL_STEP_DEG;
+    
+    // Step and record the response once the servo reaches the target
+    servo_control.setServoAngle(servo_id, step_angle);
+    
+    float samples[sample_count];
+    auto next_sample = arm_clock().now();
+    for (int i = 0; i < sample_count; i++) {
+        float distance = ultrasonic.getDistance();
+        if (distance < 0) {
+            distance = i == 0 ? 0.0f : samples[i - 1]; // Hold over a missed echo
+        }
+        samples[i] = distance;
+        next_sample += std::chrono::milliseconds(sample_period_ms);
+        arm_clock().sleepUntil(next_sample);
+    }
+    
+    float frequency, damping;
+    if (InputShaper::identify(samples, sample_count, sample_period_ms / 1000.0f, frequency, damping) &&
+        servo_control.configureShaper(servo_id, frequency, damping)) {
+        std::cout << "Servo " << servo_id << " identified: " << frequency << " Hz, zeta " << damping << std::endl;
+    } else {
+        std::cerr << "Shaper calibration failed for servo " << servo_id << " (no oscillation seen)" << std::endl;
+    }
+    
+    servo_control.setServoAngle(servo_id, start_angle);
+    servo_control.setShaperType(type);
+}
+
+// Publish a capture request or result on the calibration topic
+static void publish_calibration(const char* format, ...) {
+    if (!mosq) return;
+    
+    MessageHandle message = message_pool.acquire(MESSAGE_CRITICAL);
+    if (!message) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    int length = std::vsnprintf(message.data(), message.capacity(), format, args);
+    va_end(args);
+    if (length < 0 || static_cast<size_t>(length) >= message.capacity()) {
+        return;
+    }
+    message.setLength(length);
+    message_pool.submit(message, MQTT_TOPIC_CALIBRATION);
+}
+
+// Locate the camera: carry the gripper's fiducial through HAND_EYE_POSES,
+// have the vision node report where it sees it at each pose, and solve
+// AX = XB for the camera pose in the arm frame
+void calibrate_hand_eye() {
+    const float poses[][4] = HAND_EYE_POSES;
+    const int pose_count = sizeof(poses) / sizeof(poses[0]);
+    
+    std::cout << "Hand-eye calibration over " << pose_count << " poses..." << std::endl;
+    std::vector<int> start(SERVO_COUNT);
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        start[i] = servo_control.getServoAngle(i);
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(fiducial_mutex);
+        fiducial_index = -1; // Ignore late answers from an earlier run
+    }
+    
+    std::vector<HandEyeSample> samples;
+    for (int index = 0; index < pose_count && running; index++) {
+        std::vector<int> angles = start;
+        for (int joint = 0; joint < 4; joint++) {
+            angles[joint] = static_cast<int>(poses[index][joint]);
+        }
+        servo_control.setServoAngles(angles);
+        servo_control.waitForSettle();
+        arm_clock().sleepFor(std::chrono::milliseconds(HAND_EYE_SETTLE_MS));
+        control_heartbeat_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            arm_clock().now().time_since_epoch()).count(); // Each pose is well within the watchdog timeout
+        
+        publish_calibration("CAPTURE %d", index);
+        std::unique_lock<std::mutex> lock(fiducial_mutex);
+        auto deadline = arm_clock().now() + std::chrono::milliseconds(HAND_EYE_CAPTURE_TIMEOUT_MS);
+        if (!arm_clock().waitUntil(fiducial_ready, lock, deadline, [index]() { return fiducial_index == index; })) {
+            std::cerr << "Hand-eye pose " << index << ": no answer from the vision node" << std::endl;
+            continue;
+        }
+        if (!fiducial_found) {
+            std::cerr << "Hand-eye pose " << index << ": fiducial not visible" << std::endl;
+            continue;
+        }
+        
+        // Angles as driven rather than as requested
+        HandEyeSample sample;
+        sample.gripper = arm_gripper_pose(servo_control.getServoAngle(0), servo_control.getServoAngle(1),
+                                          servo_control.getServoAngle(2), servo_control.getServoAngle(3));
+        sample.fiducial = rigid_from_rotation_vector(fiducial_pose, fiducial_pose + 3);
+        samples.push_back(sample);
+    }
+    servo_control.setServoAngles(start);
+    
+    HandEyeResult result;
+    if (static_cast<int>(samples.size()) < HAND_EYE_MIN_SAMPLES) {
+        std::cerr << "Hand-eye calibration failed: fiducial seen in " << samples.size() << " of "
+                  << pose_count << " poses, need " << HAND_EYE_MIN_SAMPLES << std::endl;
+        publish_calibration("FAILED %d of %d poses seen", static_cast<int>(samples.size()), pose_count);
+        return;
+    }
+    if (!solve_hand_eye(samples, result)) {
+        publish_calibration("FAILED no solution from %d poses", static_cast<int>(samples.size()));
+        return;
+    }
+    
+    std::cout << "Hand-eye calibration: camera at (" << result.camera.t[0] << ", " << result.camera.t[1]
+              << ", " << result.camera.t[2] << ") mm, " << result.inliers << "/" << result.pairs
+              << " pose pairs within " << result.rotation_rms_deg << " deg, " << result.translation_rms_mm
+              << " mm" << std::endl;
+    if (save_hand_eye(HAND_EYE_FILE, result)) {
+        std::cout << "Saved camera pose to " << HAND_EYE_FILE << std::endl;
+    }
+    publish_calibration("RESULT %s %d %d %.3f %.2f", HAND_EYE_FILE, result.inliers, result.pairs,
+                        result.rotation_rms_deg, result.translation_rms_mm);
+}
+
+// Register controller metrics and serve them over HTTP
+bool initialize_metrics() {
+    MetricsRegistry& registry = metrics();
+    for (int i = 0; i <= COMMAND_KINDS; i++) {
+        std::string labels = std::string("command=\"") + (i < COMMAND_KINDS ? command_names[i] : "other") + "\"";
+        command_counters[i] = &registry.counter("smartarm_commands_total", "MQTT control commands received", labels);
+    }
+    const char* tick_help = "Control tick time (auto mode: waiting for a part plus the grab)";
+    tick_seconds[0] = &registry.histogram("smartarm_tick_duration_seconds", tick_help,
+                                          {0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.02, 0.05, 0.1},
+                                          "mode=\"manual\"");
+    tick_seconds[1] = &registry.histogram("smartarm_tick_duration_seconds", tick_help,
+                                          {0.05, 0.1, 0.2, 0.5, 1.0, 2.0, 5.0, 10.0}, "mode=\"auto\"");
+    tick_overruns = &registry.counter("smartarm_tick_overruns_total", "Manual ticks longer than their period");
+    
+    registry.gaugeCallback("smartarm_auto_mode", "1 in auto mode, 0 in manual", "", []() {
+        return auto_mode ? 1.0 : 0.0;
+    });
+    registry.gaugeCallback("smartarm_servo_idle_saving_ma", "Estimated holding current saved by detached servos", "",
+                           []() { return static_cast<double>(servo_control.getIdleSavingMa()); });
+    registry.gaugeCallback("smartarm_servo_idle_saved_mah", "Estimated charge saved by detaching parked servos", "",
+                           []() { return static_cast<double>(servo_control.getIdleSavedMah()); });
+    registry.gaugeCallback("smartarm_conveyor_speed", "Belt motor speed (-100 to 100)", "", []() {
+        return static_cast<double>(motor_get_speed());
+    });
+    registry.gaugeCallback("smartarm_supply_current_ma", "Modeled supply current", "", []() {
+        return static_cast<double>(servo_control.getBudget().supplyAt(arm_clock().now()));
+    });
+    registry.gaugeCallback("smartarm_supply_peak_ma", "Highest modeled supply current since start", "", []() {
+        return static_cast<double>(servo_control.getBudget().getPeak());
+    });
+    registry.gaugeCallback("smartarm_control_tick_hz", "Current control loop rate", "", []() {
+        return static_cast<double>(control_tick_hz.load());
+    });
+    registry.gaugeCallback("smartarm_telemetry_disk_bytes", "Telemetry segments on disk, all tiers", "", []() {
+        return static_cast<double>(telemetry_store.getDiskBytes());
+    });
+    registry.gaugeCallback("smartarm_messages_free", "Free outbound message buffers", "", []() {
+        return static_cast<double>(message_pool.freeCount());
+    });
+    
+    http_server.route("/metrics", [](const HttpRequest&, HttpResponse& response) {
+        response.content_type = "text/plain; version=0.0.4; charset=utf-8";
+        response.body = metrics().render();
+    });
+    bool listening = false;
+    if (HTTP_PORT > 0) {
+        listening = http_server.listenTcp(HTTP_BIND_ADDRESS, HTTP_PORT) || listening;
+    }
+    if (HTTP_UNIX_SOCKET[0] != '\0') {
+        listening = http_server.listenUnix(HTTP_UNIX_SOCKET) || listening;
+    }
+    return listening && http_server.start();
+}
+
+// from/to query parameters of the telemetry routes (UTC ms, default the
+// last 24 h); answers 400 and returns false for an empty range
+bool parse_time_range(const HttpRequest& request, HttpResponse& response, int64_t& from_ms, int64_t& to_ms) {
+    to_ms = telemetry_store.nowMs() + 1;
+    from_ms = to_ms - 24LL * 3600 * 1000;
+    auto to = request.query.find("to");
+    if (to != request.query.end()) to_ms = std::strtoll(to->second.c_str(), nullptr, 10);
+    auto from = request.query.find("from");
+    if (from != request.query.end()) from_ms = std::strtoll(from->second.c_str(), nullptr, 10);
+    if (from_ms >= to_ms) {
+        response.status = 400;
+        response.body = "from must be before to\n";
+        return false;
+    }
+    return true;
+}
+
+// Sample joints, distance and mode into the telemetry store and serve
+// time ranges of it as Arrow files and downsampled chart series.
+// Registers its routes, so it runs before initialize_metrics() starts
+// the HTTP server.
+bool initialize_telemetry() {
+    if (!telemetry_store.initialize()) {
+        return false;
+    }
+    
+    // GET /telemetry/export?from=<ms>&to=<ms>&resolution=raw|1s|1m (UTC,
+    // default the last 24 h at full rate)
+    http_server.route("/telemetry/export", [](const HttpRequest& request, HttpResponse& response) {
+        int64_t from_ms, to_ms;
+        if (!parse_time_range(request, response, from_ms, to_ms)) {
+            return;
+        }
+        static const char* const resolutions[TELEMETRY_TIERS] = {"raw", "1s", "1m"};
+        int tier = TELEMETRY_TIER_RAW;
+        auto resolution = request.query.find("resolution");
+        if (resolution != request.query.end()) {
+            while (tier < TELEMETRY_TIERS && resolution->second != resolutions[tier]) tier++;
+            if (tier == TELEMETRY_TIERS) {
+                response.status = 400;
+                response.body = "resolution must be raw, 1s or 1m\n";
+                return;
+            }
+        }
+        
+        // One file, replaced by each export, so repeated exports cannot
+        // fill the disk outside the store's TELEMETRY_MAX_MB budget
+        std::string path = TELEMETRY_EXPORT_FILE;
+        TelemetryExport result;
+        if (!telemetry_store.exportArrow(from_ms, to_ms, path, result, static_cast<TelemetryTier>(tier))) {
+            response.status = 500;
+            response.body = "Export failed\n";
+            return;
+        }
+        char body[512];
+        std::snprintf(body, sizeof(body),
+                      "{\"file\":\"%s\",\"resolution\":\"%s\",\"from\":%lld,\"to\":%lld,\"rows\":%zu,"
+                      "\"batches\":%d,\"bytes\":%lld,\"ms\":%.1f}\n",
+                      path.c_str(), resolutions[tier], static_cast<long long>(from_ms), static_cast<long long>(to_ms),
+                      result.rows, result.batches, static_cast<long long>(result.bytes), result.milliseconds);
+        response.content_type = "application/json";
+        response.body = body;
+    });
+    
+    // GET /telemetry/history?from=<ms>&to=<ms>&points=<n>&method=lttb|minmax
+    //     &channels=base,...,distance_cm (default all)
+    http_server.route("/telemetry/history", [](const HttpRequest& request, HttpResponse& response) {
+        int64_t from_ms, to_ms;
+        if (!parse_time_range(request, response, from_ms, to_ms)) {
+            return;
+        }
+        int points = TELEMETRY_HISTORY_POINTS;
+        auto points_param = request.query.find("points");
+        if (points_param != request.query.end()) points = std::atoi(points_param->second.c_str());
+        TelemetryDownsample method = TELEMETRY_DOWNSAMPLE_LTTB;
+        auto method_param = request.query.find("method");
+        if (method_param != request.query.end() && method_param->second == "minmax") {
+            method = TELEMETRY_DOWNSAMPLE_MINMAX;
+        } else if (method_param != request.query.end() && method_param->second != "lttb") {
+            points = 0; // Rejected below
+        }
+        
+        std::vector<TelemetrySeries> series;
+        auto channels = request.query.find("channels");
+        std::string names = channels != request.query.end() ? channels->second : "";
+        for (int channel = 0; channel < TELEMETRY_CHANNELS; channel++) {
+            std::string name = telemetry_channel_name(channel);
+            if (names.empty() || ("," + names + ",").find("," + name + ",") != std::string::npos) {
+                series.push_back({channel, {}, {}});
+            }
+        }
+        if (points < 2 || points > TELEMETRY_HISTORY_MAX_POINTS || series.empty()) {
+            response.status = 400;
+            response.body = "Expected points 2-" + std::to_string(TELEMETRY_HISTORY_MAX_POINTS) +
+                            ", method lttb or minmax and known channels\n";
+            return;
+        }
+        
+        auto started = std::chrono::steady_clock::now();
+        size_t rows = telemetry_store.queryHistory(from_ms, to_ms, points, method, series);
+        double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+        
+        // {"from":..,"to":..,"rows":..,"ms":..,"series":{"base":{"t":[..],"v":[..]},..}}
+        std::string& body = response.body;
+        char number[64];
+        std::snprintf(number, sizeof(number), "%.1f", elapsed_ms);
+        body = "{\"from\":" + std::to_string(from_ms) + ",\"to\":" + std::to_string(to_ms) +
+               ",\"method\":\"" + (method == TELEMETRY_DOWNSAMPLE_LTTB ? "lttb" : "minmax") +
+               "\",\"rows\":" + std::to_string(rows) + ",\"ms\":" + number + ",\"series\":{";
+        for (size_t i = 0; i < series.size(); i++) {
+            body += std::string(i > 0 ? "," : "") + "\"" + telemetry_channel_name(series[i].channel) + "\":{\"t\":[";
+            for (size_t p = 0; p < series[i].time.size(); p++) {
+                body += (p > 0 ? "," : "") + std::to_string(series[i].time[p]);
+            }
+            body += "],\"v\":[";
+            for (size_t p = 0; p < series[i].value.size(); p++) {
+                std::snprintf(number, sizeof(number), p > 0 ? ",%.2f" : "%.2f", series[i].value[p]);
+                body += number;
+            }
+            body += "]}";
+        }
+        body += "}}\n";
+        response.content_type = "application/json";
+    });
+    
+    return telemetry_store.start([](TelemetrySample& sample) {
+        for (int i = 0; i < SERVO_COUNT; i++) {
+            sample.joints[i] = servo_control.getEstimatedAngle(i);
+        }
+        // Latest reading of the ranging thread, in either mode
+        sample.distance_cm = auto_controller.getMonitor().getLastDistance();
+        sample.mode = auto_mode ? 1 : 0;
+    });
+}
+
+// Dump the flight recorder once when the control loop stops ticking; re-arms
+// when ticks resume
+void watchdog_loop() {
+    flight_thread_name("watchdog");
+    bool tripped = false;
+    while (running) {
+        arm_clock().sleepFor(std::chrono::milliseconds(WATCHDOG_TIMEOUT_MS / 4));
+        long long now = std::chrono::duration_cast<std::chrono::milliseconds>(
+            arm_clock().now().time_since_epoch()).count();
+        long long stalled = now - control_heartbeat_ms;
+        if (stalled < WATCHDOG_TIMEOUT_MS) {
+            tripped = false;
+        } else if (!tripped) {
+            tripped = true;
+            std::cerr << "Watchdog: control loop stalled for " << stalled << " ms" << std::endl;
+            flight_record(FLIGHT_EVENT, FLIGHT_EVENT_WATCHDOG, static_cast<int>(stalled));
+            flight_recorder_dump(FLIGHT_DUMP_WATCHDOG);
+        }
+    }
 }
 
 // Main control loop
 void control_loop() {
+    const int active_hz = 1000000 / CONTROL_ACTIVE_TICK_US;
+    const int idle_hz = 1000 / CONTROL_IDLE_TICK_MS;
+    auto last_tick = arm_clock().now();
+    
     while (running) {
-        if (auto_mode) {
-            // Automatic vision-based control logic
-            float distance = ultrasonic.getAverageDistance(3);
+        auto tick_start = arm_clock().now();
+        int mode = auto_mode ? 1 : 0;
+        ARM_PROBE1(tick_start, mode);
+        float dt = std::chrono::duration<float>(tick_start - last_tick).count();
+        last_tick = tick_start;
+        control_heartbeat_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            tick_start.time_since_epoch()).count();
+        bool active = false;
+        
+        if (mode) {
+            // Sleeps until the ranging thread reports a part, waking at
+            // least every AUTO_IDLE_WAKE_MS for status and the watchdog
+            control_tick_hz = 1000 / AUTO_IDLE_WAKE_MS;
+            bool summary_due = false;
+            {
+                RtNoAllocScope no_alloc("auto poll");
+                const AutoCycle& cycle = auto_controller.poll(tick_start + std::chrono::milliseconds(AUTO_IDLE_WAKE_MS));
+                if (cycle.grabbed) {
+                    telemetry_store.recordEvent(cycle.report.success ? TELEMETRY_EVENT_GRAB : TELEMETRY_EVENT_GRAB_FAILED);
+                    publish_cycle_profile();
+                    summary_due = auto_controller.getProfiler().getCycles() % PROFILE_SUMMARY_CYCLES == 0;
+                }
+                servo_control.update(); // Idle power policy while parked between parts
+            }
+            
+            // Logged between cycles, outside the allocation-free section
+            if (summary_due) {
+                auto_controller.getProfiler().printSummary(std::cout, PROFILE_TOP_PHASES);
+            }
+        }
+        else {
+            auto_controller.suspend(); // Belt off, slow ranging for status
+            
+            int calibration = shaper_calibration_request.exchange(-1);
+            if (calibration >= 0) {
+                telemetry_store.recordEvent(TELEMETRY_EVENT_CALIBRATION);
+                auto_controller.releaseSensor(); // Calibration pings from this thread
+                calibrate_shaper(calibration); // Maintenance procedure, may allocate
+            }
+            if (hand_eye_request.exchange(false)) {
+                telemetry_store.recordEvent(TELEMETRY_EVENT_CALIBRATION);
+                calibrate_hand_eye();
+            }
+            
+            RtNoAllocScope no_alloc("control tick");
             
-            if (distance > 0 && distance < 20.0f) {
-                // Object detected within range - perform grab sequence
-                std::cout << "Object detected at " << distance << "cm - executing grab sequence" << std::endl;
-                
-                // Move arm to grab position
-                servo_control.smoothMove(1, 45, 5);  // Shoulder down
-                servo_control.smoothMove(2, 120, 5); // Elbow extend
-                servo_control.smoothMove(4, 0, 3);   // Open gripper
-                
-                std::this_thread::sleep_for(std::chrono::milliseconds(500));
-                
-                // Close gripper
-                servo_control.smoothMove(4, 180, 3); // Close gripper
-                
-                std::this_thread::sleep_for(std::chrono::milliseconds(500));
-                
-                // Lift object
-                servo_control.smoothMove(1, 90, 5);  // Shoulder up
-                servo_control.smoothMove(2, 90, 5);  // Elbow retract
-                
-                std::cout << "Grab sequence completed" << std::endl;
-                
-                // Wait before next detection
-                std::this_thread::sleep_for(std::chrono::seconds(3));
+            // Integrate jog velocities or play back streamed setpoints on the control tick
+            if (!jog_control.update(std::min(dt, 0.1f), servo_control)) {
+                setpoint_stream.update(servo_control);
             }
+            servo_control.update();
+            
+            // Fast ticks only while something is in motion
+            active = jog_control.isActive() || setpoint_stream.isActive() || servo_control.isMoving();
+            control_tick_hz = active ? active_hz : idle_hz;
+        }
+        int tick_us = static_cast<int>(
+            std::chrono::duration_cast<std::chrono::microseconds>(arm_clock().now() - tick_start).count());
+        flight_record(FLIGHT_TICK, mode, tick_us);
+        ARM_PROBE2(tick_end, mode, tick_us);
+        tick_seconds[mode]->observe(tick_us / 1e6);
+        if (!mode && tick_us > (active ? CONTROL_ACTIVE_TICK_US : CONTROL_IDLE_TICK_MS * 1000)) {
+            tick_overruns->inc();
         }
         
         // Publish status every second
-        static auto last_status = std::chrono::steady_clock::now();
-        auto now = std::chrono::steady_clock::now();
+        static auto last_status = arm_clock().now();
+        auto now = arm_clock().now();
         if (std::chrono::duration_cast<std::chrono::seconds>(now - last_status).count() >= 1) {
             publish_status();
             last_status = now;
         }
         
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if (mode) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(control_wake_mutex);
+        if (active) {
+            control_wake_pending = false; // Already ticking fast
+            lock.unlock();
+            arm_clock().sleepUntil(tick_start + std::chrono::microseconds(CONTROL_ACTIVE_TICK_US));
+        } else {
+            // Parked: sleep until the idle period ends or a command arrives
+            arm_clock().waitUntil(control_wake, lock, tick_start + std::chrono::milliseconds(CONTROL_IDLE_TICK_MS),
+                                  []() { return control_wake_pending; });
+            control_wake_pending = false;
+            last_tick = arm_clock().now(); // Nothing moved while parked, do not integrate the wait
+        }
     }
 }
 
@@ -186,6 +941,18 @@ int main() {
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
     
+    // Crash dumps and the recorder rings are set up before anything can fail
+    flight_thread_name("control");
+    if (!flight_recorder_init()) {
+        std::cerr << "Flight recorder dumps disabled" << std::endl;
+    }
+    
+    if (load_grab_params(GRAB_PARAMS_FILE, grab_params)) {
+        std::cout << "Loaded grab parameters from " << GRAB_PARAMS_FILE << std::endl;
+    }
+    auto_controller.prepare();
+    scratch_arena(); // Calibration runs on the control thread; allocate its scratch up front
+    
     // Initialize hardware components
     std::cout << "Initializing hardware components..." << std::endl;
     
@@ -204,6 +971,18 @@ int main() {
         return 1;
     }
     
+    if (initialize_telemetry()) {
+        std::cout << "Recording telemetry to " << TELEMETRY_DIR << std::endl;
+    } else {
+        std::cerr << "Telemetry recording disabled" << std::endl;
+    }
+    
+    if (initialize_metrics()) {
+        std::cout << "Metrics at http://" << HTTP_BIND_ADDRESS << ":" << HTTP_PORT << "/metrics" << std::endl;
+    } else {
+        std::cerr << "Metrics endpoint disabled" << std::endl;
+    }
+    
     // Initialize MQTT communication
     std::cout << "Initializing MQTT communication..." << std::endl;
     if (!initialize_mqtt()) {
@@ -211,26 +990,67 @@ int main() {
         return 1;
     }
     
+    if (!auto_controller.start()) {
+        std::cerr << "Failed to start ranging thread" << std::endl;
+        return 1;
+    }
+    
     std::cout << "System initialized successfully!" << std::endl;
     std::cout << "Mode: " << (auto_mode ? "AUTO" : "MANUAL") << std::endl;
     std::cout << "Press Ctrl+C to stop..." << std::endl;
     
     // Start MQTT loop in separate thread
-    std::thread mqtt_thread([&]() {
+    RtThread mqtt_thread;
+    bool started = mqtt_thread.start([&]() {
+        flight_thread_name("mqtt");
         while (running) {
-            mosquitto_loop(mosq, 100, 1);
+            mosquitto_loop(mosq, MQTT_LOOP_MS, 1);
+            send_pending_messages();
         }
     });
     
+    control_heartbeat_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        arm_clock().now().time_since_epoch()).count();
+    RtThread watchdog_thread;
+    started = started && watchdog_thread.start(watchdog_loop);
+    if (!started) {
+        std::cerr << "Failed to start MQTT and watchdog threads" << std::endl;
+        running = false;
+        return 1;
+    }
+    
+#if RT_MEMORY_MODE
+    // Everything is allocated now: pin it, and fault in the stack and heap
+    // the control loop will use so steady state never page faults. Every
+    // helper thread runs on an RT_THREAD_STACK_KB stack, so locking pins
+    // that much per thread instead of the 8 MB default.
+    if (!rt_memory_lock()) {
+        std::cerr << "Continuing without locked memory" << std::endl;
+    }
+    rt_prefault_stack();
+    rt_prefault_heap();
+    rt_allocation_tracking(true);
+    std::cout << "Real-time memory mode enabled" << std::endl;
+#endif
+    
     // Run main control loop
     control_loop();
     
     // Cleanup
     std::cout << "Shutting down..." << std::endl;
+    if (auto_controller.getProfiler().getCycles() > 0) {
+        auto_controller.getProfiler().printSummary(std::cout, PROFILE_TOP_PHASES);
+    }
     
     if (mqtt_thread.joinable()) {
         mqtt_thread.join();
     }
+    if (watchdog_thread.joinable()) {
+        watchdog_thread.join();
+    }
+    auto_controller.stop();
+    http_server.stop();
+    telemetry_store.stop();
     
     servo_control.emergencyStop();
     motor_stop();
@@ -0,0 +1,185 @@
+#include "message_pool.h"
+#include "clock.h"
+#include "metrics.h"
+#include <algorithm>
+#include <utility>
+
+namespace {
+    MetricCounter& dropped_count = metrics().counter("smartarm_messages_dropped_total",
+                                                     "Telemetry frames dropped for a full pool");
+    MetricCounter& refused_count = metrics().counter("smartarm_messages_refused_total",
+                                                     "Messages refused for a full pool");
+}
+
+MessageHandle::MessageHandle() : pool(nullptr), index(-1) {
+}
+
+MessageHandle::MessageHandle(MessagePool* owner, int buffer_index) : pool(owner), index(buffer_index) {
+}
+
+MessageHandle::MessageHandle(const MessageHandle& other) : pool(other.pool), index(other.index) {
+    if (pool) pool->addRef(index);
+}
+
+MessageHandle::MessageHandle(MessageHandle&& other) noexcept : pool(other.pool), index(other.index) {
+    other.pool = nullptr;
+    other.index = -1;
+}
+
+MessageHandle& MessageHandle::operator=(MessageHandle other) noexcept {
+    std::swap(pool, other.pool);
+    std::swap(index, other.index);
+    return *this;
+}
+
+MessageHandle::~MessageHandle() {
+    reset();
+}
+
+void MessageHandle::reset() {
+    if (pool) {
+        pool->release(index);
+        pool = nullptr;
+        index = -1;
+    }
+}
+
+char* MessageHandle::data() {
+    return pool ? pool->buffers[index].data : nullptr;
+}
+
+const char* MessageHandle::data() const {
+    return pool ? pool->buffers[index].data : nullptr;
+}
+
+size_t MessageHandle::length() const {
+    return pool ? pool->buffers[index].length : 0;
+}
+
+void MessageHandle::setLength(size_t length) {
+    if (pool) pool->buffers[index].length = std::min(length, static_cast<size_t>(MESSAGE_BUFFER_SIZE));
+}
+
+const char* MessageHandle::topic() const {
+    return pool ? pool->buffers[index].topic : nullptr;
+}
+
+MessagePool::MessagePool() :
+    free_count(MESSAGE_POOL_SIZE),
+    queue_head(0),
+    queue_count(0),
+    dropped(0),
+    refused(0) {
+    for (int i = 0; i < MESSAGE_POOL_SIZE; i++) {
+        buffers[i].refs = 0;
+        free_list[i] = i;
+    }
+}
+
+void MessagePool::addRef(int index) {
+    buffers[index].refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MessagePool::release(int index) {
+    if (buffers[index].refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        std::lock_guard<std::mutex> lock(mutex);
+        free_list[free_count++] = index;
+        arm_clock().notifyAll(released);
+    }
+}
+
+void MessagePool::dropRef(int index) {
+    if (buffers[index].refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        free_list[free_count++] = index;
+    }
+}
+
+bool MessagePool::dropOldestTelemetry() {
+    int i = 0;
+    while (i < queue_count) {
+        int slot = (queue_head + i) % MESSAGE_POOL_SIZE;
+        int index = queue[slot];
+        if (buffers[index].priority != MESSAGE_TELEMETRY) {
+            i++;
+            continue;
+        }
+        
+        // Close the gap, keeping the queue in order. The entries before i
+        // move up a slot, so the next one to look at is at i again.
+        for (int j = i; j > 0; j--) {
+            queue[(queue_head + j) % MESSAGE_POOL_SIZE] = queue[(queue_head + j - 1) % MESSAGE_POOL_SIZE];
+        }
+        queue_head = (queue_head + 1) % MESSAGE_POOL_SIZE;
+        queue_count--;
+        dropped++;
+        dropped_count.inc();
+        dropRef(index);
+        if (free_count > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+MessageHandle MessagePool::acquire(MessagePriority priority) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (free_count == 0 && !dropOldestTelemetry() && priority == MESSAGE_CRITICAL) {
+        // Backpressure: wait for the network thread to finish a send
+        Clock::TimePoint deadline = arm_clock().now() + std::chrono::milliseconds(MESSAGE_POOL_WAIT_MS);
+        arm_clock().waitUntil(released, lock, deadline, [this]() { return free_count > 0; });
+    }
+    if (free_count == 0) {
+        refused++;
+        refused_count.inc();
+        return MessageHandle();
+    }
+    
+    int index = free_list[--free_count];
+    Buffer& buffer = buffers[index];
+    buffer.refs.store(1, std::memory_order_relaxed);
+    buffer.priority = priority;
+    buffer.topic = nullptr;
+    buffer.length = 0;
+    return MessageHandle(this, index);
+}
+
+bool MessagePool::submit(const MessageHandle& message, const char* topic) {
+    if (!message || message.pool != this) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    if (queue_count == MESSAGE_POOL_SIZE) {
+        return false;
+    }
+    buffers[message.index].topic = topic;
+    addRef(message.index); // The queue's reference
+    queue[(queue_head + queue_count) % MESSAGE_POOL_SIZE] = message.index;
+    queue_count++;
+    return true;
+}
+
+MessageHandle MessagePool::pop() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (queue_count == 0) {
+        return MessageHandle();
+    }
+    int index = queue[queue_head];
+    queue_head = (queue_head + 1) % MESSAGE_POOL_SIZE;
+    queue_count--;
+    return MessageHandle(this, index); // Takes over the queue's reference
+}
+
+int MessagePool::freeCount() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return free_count;
+}
+
+unsigned long MessagePool::droppedCount() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return dropped;
+}
+
+unsigned long MessagePool::refusedCount() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return refused;
+}
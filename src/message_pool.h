@@ -0,0 +1,101 @@
+#ifndef MESSAGE_POOL_H
+#define MESSAGE_POOL_H
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+#include "../include/config.h"
+
+// Telemetry frames may be dropped when the pool runs dry; critical
+// messages wait for a buffer instead
+enum MessagePriority { MESSAGE_TELEMETRY, MESSAGE_CRITICAL };
+
+class MessagePool;
+
+// Reference-counted handle to a pooled message buffer. The buffer goes back
+// to the pool when the last handle to it is destroyed or reset.
+class MessageHandle {
+private:
+    MessagePool* pool;
+    int index;
+    
+    friend class MessagePool;
+    MessageHandle(MessagePool* owner, int buffer_index);  // adopts a reference
+    
+public:
+    MessageHandle();
+    MessageHandle(const MessageHandle& other);
+    MessageHandle(MessageHandle&& other) noexcept;
+    MessageHandle& operator=(MessageHandle other) noexcept;
+    ~MessageHandle();
+    
+    explicit operator bool() const { return pool != nullptr; }
+    void reset();
+    
+    // Serializers write straight into the buffer, then set the length
+    char* data();
+    const char* data() const;
+    size_t capacity() const { return MESSAGE_BUFFER_SIZE; }
+    size_t length() const;
+    void setLength(size_t length);
+    
+    const char* topic() const;
+};
+
+// Fixed set of preallocated outbound message buffers. Producers acquire a
+// buffer, serialize into it and submit it; the network thread pops queued
+// messages and holds them until the send completes. When every buffer is
+// taken, acquiring drops the oldest queued telemetry frame; if there is
+// none, telemetry is refused (the producer skips the frame) and critical
+// messages wait up to MESSAGE_POOL_WAIT_MS.
+class MessagePool {
+private:
+    struct Buffer {
+        std::atomic<int> refs;
+        MessagePriority priority;
+        const char* topic;
+        size_t length;
+        char data[MESSAGE_BUFFER_SIZE];
+    };
+    
+    Buffer buffers[MESSAGE_POOL_SIZE];
+    std::mutex mutex;
+    std::condition_variable released;
+    int free_list[MESSAGE_POOL_SIZE];
+    int free_count;
+    int queue[MESSAGE_POOL_SIZE];     // submitted, not yet popped (ring)
+    int queue_head;
+    int queue_count;
+    unsigned long dropped;            // telemetry frames dropped for space
+    unsigned long refused;            // acquires that got no buffer
+    
+    friend class MessageHandle;
+    void addRef(int index);
+    void release(int index);
+    
+    // With the mutex held
+    void dropRef(int index);
+    bool dropOldestTelemetry();
+    
+public:
+    MessagePool();
+    
+    MessagePool(const MessagePool&) = delete;
+    MessagePool& operator=(const MessagePool&) = delete;
+    
+    // Empty handle if no buffer could be had
+    MessageHandle acquire(MessagePriority priority);
+    
+    // Queue a filled buffer for sending
+    bool submit(const MessageHandle& message, const char* topic);
+    
+    // Next queued message (network thread), empty handle if none
+    MessageHandle pop();
+    
+    int freeCount();
+    unsigned long droppedCount();
+    unsigned long refusedCount();
+};
+
+#endif // MESSAGE_POOL_H
@@ -0,0 +1,177 @@
+#include "metrics.h"
+#include <cstdio>
+
+namespace {
+    // Threads take shards round-robin on first use; with more threads than
+    // shards some share a cell, which stays correct (CAS) but may contend
+    std::atomic<int> next_shard(0);
+    
+    int thread_shard() {
+        thread_local int shard = next_shard.fetch_add(1, std::memory_order_relaxed) % METRICS_SHARDS;
+        return shard;
+    }
+    
+    void atomic_add(std::atomic<double>& target, double amount) {
+        double current = target.load(std::memory_order_relaxed);
+        while (!target.compare_exchange_weak(current, current + amount, std::memory_order_relaxed)) {
+        }
+    }
+    
+    void append_sample(std::string& out, const std::string& name, const std::string& labels, double value) {
+        char number[32];
+        std::snprintf(number, sizeof(number), "%.17g", value);
+        out += name;
+        if (!labels.empty()) {
+            out += "{" + labels + "}";
+        }
+        out += " ";
+        out += number;
+        out += "\n";
+    }
+    
+    std::string with_label(const std::string& labels, const std::string& extra) {
+        return labels.empty() ? extra : labels + "," + extra;
+    }
+}
+
+void MetricCounter::inc(double amount) {
+    atomic_add(cells[thread_shard()].value, amount);
+}
+
+double MetricCounter::value() const {
+    double total = 0.0;
+    for (const MetricCell& cell : cells) {
+        total += cell.value.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+MetricHistogram::MetricHistogram(std::initializer_list<double> upper_bounds) : bound_count(0) {
+    for (double bound : upper_bounds) {
+        if (bound_count == METRICS_MAX_BUCKETS) break;
+        bounds[bound_count++] = bound;
+    }
+    for (Shard& shard : shards) {
+        for (std::atomic<uint64_t>& bucket : shard.buckets) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+        shard.sum.store(0.0, std::memory_order_relaxed);
+    }
+}
+
+void MetricHistogram::observe(double value) {
+    int bucket = 0;
+    while (bucket < bound_count && value > bounds[bucket]) bucket++;
+    Shard& shard = shards[thread_shard()];
+    shard.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    atomic_add(shard.sum, value);
+}
+
+void MetricHistogram::snapshot(uint64_t* cumulative, double& sum) const {
+    sum = 0.0;
+    for (int i = 0; i <= bound_count; i++) {
+        cumulative[i] = 0;
+    }
+    for (const Shard& shard : shards) {
+        for (int i = 0; i <= bound_count; i++) {
+            cumulative[i] += shard.buckets[i].load(std::memory_order_relaxed);
+        }
+        sum += shard.sum.load(std::memory_order_relaxed);
+    }
+    for (int i = 1; i <= bound_count; i++) {
+        cumulative[i] += cumulative[i - 1];
+    }
+}
+
+MetricsRegistry::Entry& MetricsRegistry::add(const std::string& name, const std::string& help,
+                                             const std::string& labels, Type type) {
+    Entry entry;
+    entry.name = name;
+    entry.help = help;
+    entry.labels = labels;
+    entry.type = type;
+    entry.counter = nullptr;
+    entry.gauge = nullptr;
+    entry.histogram = nullptr;
+    entries.push_back(entry);
+    return entries.back();
+}
+
+MetricCounter& MetricsRegistry::counter(const std::string& name, const std::string& help,
+                                        const std::string& labels) {
+    std::lock_guard<std::mutex> lock(mutex);
+    counters.emplace_back();
+    add(name, help, labels, COUNTER).counter = &counters.back();
+    return counters.back();
+}
+
+MetricGauge& MetricsRegistry::gauge(const std::string& name, const std::string& help,
+                                    const std::string& labels) {
+    std::lock_guard<std::mutex> lock(mutex);
+    gauges.emplace_back();
+    add(name, help, labels, GAUGE).gauge = &gauges.back();
+    return gauges.back();
+}
+
+MetricHistogram& MetricsRegistry::histogram(const std::string& name, const std::string& help,
+                                            std::initializer_list<double> upper_bounds,
+                                            const std::string& labels) {
+    std::lock_guard<std::mutex> lock(mutex);
+    histograms.emplace_back(upper_bounds);
+    add(name, help, labels, HISTOGRAM).histogram = &histograms.back();
+    return histograms.back();
+}
+
+void MetricsRegistry::gaugeCallback(const std::string& name, const std::string& help,
+                                    const std::string& labels, std::function<double()> callback) {
+    std::lock_guard<std::mutex> lock(mutex);
+    add(name, help, labels, GAUGE).callback = callback;
+}
+
+std::string MetricsRegistry::render() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::string out;
+    std::vector<bool> done(entries.size(), false);
+    
+    // Samples of one metric name must be grouped under a single HELP/TYPE
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (done[i]) continue;
+        const Entry& first = entries[i];
+        const char* type = first.type == COUNTER ? "counter" : first.type == GAUGE ? "gauge" : "histogram";
+        out += "# HELP " + first.name + " " + first.help + "\n";
+        out += "# TYPE " + first.name + " " + type + "\n";
+        
+        for (size_t j = i; j < entries.size(); j++) {
+            const Entry& entry = entries[j];
+            if (done[j] || entry.name != first.name) continue;
+            done[j] = true;
+            
+            if (entry.type == COUNTER) {
+                append_sample(out, entry.name, entry.labels, entry.counter->value());
+            } else if (entry.type == GAUGE) {
+                append_sample(out, entry.name, entry.labels,
+                              entry.callback ? entry.callback() : entry.gauge->value());
+            } else {
+                const MetricHistogram& histogram = *entry.histogram;
+                uint64_t cumulative[METRICS_MAX_BUCKETS + 1];
+                double sum;
+                histogram.snapshot(cumulative, sum);
+                char bound[32];
+                for (int b = 0; b < histogram.getBoundCount(); b++) {
+                    std::snprintf(bound, sizeof(bound), "le=\"%g\"", histogram.getBound(b));
+                    append_sample(out, entry.name + "_bucket", with_label(entry.labels, bound), cumulative[b]);
+                }
+                uint64_t count = cumulative[histogram.getBoundCount()];
+                append_sample(out, entry.name + "_bucket", with_label(entry.labels, "le=\"+Inf\""), count);
+                append_sample(out, entry.name + "_sum", entry.labels, sum);
+                append_sample(out, entry.name + "_count", entry.labels, count);
+            }
+        }
+    }
+    return out;
+}
+
+MetricsRegistry& metrics() {
+    static MetricsRegistry registry;
+    return registry;
+}
@@ -0,0 +1,102 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "../include/config.h"
+
+// In-process metrics in Prometheus text format. Counters and histograms
+// keep METRICS_SHARDS cache-line sized cells; each thread updates its own
+// cell with relaxed atomics, so hot paths never contend or allocate. Cells
+// are summed only when the registry is rendered for a scrape. Register
+// metrics at startup: references stay valid for the life of the process.
+
+struct alignas(64) MetricCell {
+    std::atomic<double> value{0.0};
+};
+
+class MetricCounter {
+private:
+    MetricCell cells[METRICS_SHARDS];
+    
+public:
+    void inc(double amount = 1.0);
+    double value() const;
+};
+
+// Last value set wins; no sharding needed
+class MetricGauge {
+private:
+    std::atomic<double> current{0.0};
+    
+public:
+    void set(double value) { current.store(value, std::memory_order_relaxed); }
+    double value() const { return current.load(std::memory_order_relaxed); }
+};
+
+class MetricHistogram {
+private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> buckets[METRICS_MAX_BUCKETS + 1];  // last is +Inf
+        std::atomic<double> sum;
+    };
+    
+    double bounds[METRICS_MAX_BUCKETS];
+    int bound_count;
+    Shard shards[METRICS_SHARDS];
+    
+public:
+    explicit MetricHistogram(std::initializer_list<double> upper_bounds);
+    
+    void observe(double value);
+    
+    int getBoundCount() const { return bound_count; }
+    double getBound(int index) const { return bounds[index]; }
+    // Cumulative count of observations <= bound index (bound_count = +Inf)
+    void snapshot(uint64_t* cumulative, double& sum) const;
+};
+
+class MetricsRegistry {
+private:
+    enum Type { COUNTER, GAUGE, HISTOGRAM };
+    
+    struct Entry {
+        std::string name;
+        std::string help;
+        std::string labels;    // rendered label pairs without braces, e.g. servo="0"
+        Type type;
+        MetricCounter* counter;
+        MetricGauge* gauge;
+        MetricHistogram* histogram;
+        std::function<double()> callback;   // gauges computed at scrape time
+    };
+    
+    std::mutex mutex;
+    std::vector<Entry> entries;
+    std::deque<MetricCounter> counters;
+    std::deque<MetricGauge> gauges;
+    std::deque<MetricHistogram> histograms;
+    
+    Entry& add(const std::string& name, const std::string& help, const std::string& labels, Type type);
+    
+public:
+    MetricCounter& counter(const std::string& name, const std::string& help, const std::string& labels = "");
+    MetricGauge& gauge(const std::string& name, const std::string& help, const std::string& labels = "");
+    MetricHistogram& histogram(const std::string& name, const std::string& help,
+                               std::initializer_list<double> upper_bounds, const std::string& labels = "");
+    void gaugeCallback(const std::string& name, const std::string& help, const std::string& labels,
+                       std::function<double()> callback);
+    
+    // Prometheus text exposition format 0.0.4
+    std::string render();
+};
+
+// Process-wide registry
+MetricsRegistry& metrics();
+
+#endif // METRICS_H
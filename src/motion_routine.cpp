@@ -0,0 +1,69 @@
+#include "motion_routine.h"
+#include <algorithm>
+#include <iostream>
+
+int routine_step_angle(int start, int target, int steps, int step) {
+    if (step >= steps) return target;
+    return start + ((target - start) / steps) * step;
+}
+
+bool MotionRoutine::dependsOn(int later, int earlier) const {
+    for (int dep : actions[later].depends_on) {
+        if (dep == earlier || dependsOn(dep, earlier)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int MotionRoutine::addMove(const std::string& name, int servo_id, int target_angle, int steps,
+                           const std::vector<int>& depends_on, int offset_ms, bool wait_settle) {
+    int index = static_cast<int>(actions.size());
+    for (int dep : depends_on) {
+        if (dep < 0 || dep >= index) {
+            std::cerr << "Routine action " << name << " has invalid dependency " << dep << std::endl;
+            return -1;
+        }
+    }
+    actions.push_back({name, servo_id, target_angle, std::max(1, steps), 0, std::max(0, offset_ms),
+                       wait_settle, 0.0f, 0.0f, depends_on});
+    return index;
+}
+
+int MotionRoutine::addDwell(const std::string& name, int dwell_ms, const std::vector<int>& depends_on) {
+    int index = addMove(name, -1, 0, 1, depends_on);
+    if (index >= 0) {
+        actions[index].dwell_ms = std::max(0, dwell_ms);
+    }
+    return index;
+}
+
+bool MotionRoutine::setSpeed(int index, float speed_dps) {
+    if (index < 0 || index >= static_cast<int>(actions.size()) || speed_dps < 0.0f) {
+        return false;
+    }
+    actions[index].speed_dps = speed_dps;
+    return true;
+}
+
+bool MotionRoutine::setBlend(int index, float blend_deg) {
+    if (index < 0 || index >= static_cast<int>(actions.size()) || blend_deg < 0.0f) {
+        return false;
+    }
+    actions[index].blend_deg = blend_deg;
+    return true;
+}
+
+bool MotionRoutine::validate() const {
+    for (size_t i = 0; i < actions.size(); i++) {
+        if (actions[i].servo_id < 0) continue;
+        for (size_t j = 0; j < i; j++) {
+            if (actions[j].servo_id == actions[i].servo_id && !dependsOn(i, j)) {
+                std::cerr << "Routine actions " << actions[j].name << " and " << actions[i].name
+                          << " drive servo " << actions[i].servo_id << " concurrently" << std::endl;
+                return false;
+            }
+        }
+    }
+    return true;
+}
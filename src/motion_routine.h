@@ -0,0 +1,53 @@
+#ifndef MOTION_ROUTINE_H
+#define MOTION_ROUTINE_H
+
+#include <vector>
+#include <string>
+
+// One stage of a routine: a stepped joint move or a plain dwell.
+struct MotionAction {
+    std::string name;
+    int servo_id;                 // -1 for a dwell
+    int target_angle;
+    int steps;                    // intermediate setpoints (smoothMove style)
+    int dwell_ms;                 // dwell length, or extra hold after a move
+    int offset_ms;                // start delay after all dependencies finish
+    bool wait_settle;             // finished only once residual vibration died out
+    float speed_dps;              // step pacing limit, 0 = as fast as the servo
+    float blend_deg;              // finished once within this distance of the target
+    std::vector<int> depends_on;  // indices of earlier actions
+};
+
+// A small dependency graph of motion actions. Actions may only depend on
+// actions added before them, so insertion order is a topological order.
+// Execution lives in RoutineRunner.
+class MotionRoutine {
+private:
+    std::vector<MotionAction> actions;
+    
+    // Whether action 'later' transitively depends on action 'earlier'
+    bool dependsOn(int later, int earlier) const;
+    
+public:
+    // Add a stepped move, returns its index (-1 if a dependency is invalid)
+    int addMove(const std::string& name, int servo_id, int target_angle, int steps,
+                const std::vector<int>& depends_on = {}, int offset_ms = 0, bool wait_settle = false);
+    
+    // Add a fixed dwell, returns its index
+    int addDwell(const std::string& name, int dwell_ms, const std::vector<int>& depends_on = {});
+    
+    // Limit the stepping speed / allow blending into dependents for a move
+    bool setSpeed(int index, float speed_dps);
+    bool setBlend(int index, float blend_deg);
+    
+    // Safety check: every pair of actions on the same joint must be ordered
+    bool validate() const;
+    
+    const std::vector<MotionAction>& getActions() const { return actions; }
+    void clear() { actions.clear(); }
+};
+
+// Angle of the given step of a stepped move (same stepping as smoothMove)
+int routine_step_angle(int start, int target, int steps, int step);
+
+#endif // MOTION_ROUTINE_H
@@ -0,0 +1,124 @@
+#include "occlusion_map.h"
+#include "kinematics.h"
+#include "../include/config.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    const float DEG_TO_RAD = 3.14159265f / 180.0f;
+    const float SAMPLE_MM = 5.0f;     // spacing of the link samples
+    const float MOUNT[3] = ULTRASONIC_MOUNT_MM;
+    const float AIM[3] = ULTRASONIC_AIM;
+    
+    static_assert(180 % OCCLUSION_STEP_DEG == 0, "occlusion cells must tile 0-180 degrees");
+    
+    // Distance from a point to the beam cone surface (negative inside)
+    float cone_distance(float x, float y, float z) {
+        float half_angle = ULTRASONIC_BEAM_DEG * DEG_TO_RAD;
+        float v[3] = { x - MOUNT[0], y - MOUNT[1], z - MOUNT[2] };
+        float along = v[0] * AIM[0] + v[1] * AIM[1] + v[2] * AIM[2];
+        float length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+        float perp = std::sqrt(std::max(0.0f, length * length - along * along));
+        if (along * std::cos(half_angle) + perp * std::sin(half_angle) < 0.0f) {
+            return length; // Behind the sensor, nearest to the apex
+        }
+        return perp * std::cos(half_angle) - along * std::sin(half_angle);
+    }
+    
+    // Nearest range (cm) of the link capsules inside the beam, -1 if none.
+    // Each sample is grown by pad_mm plus the distance it can move when
+    // every joint turns by up to cell_rad.
+    float chain_beam_range(float base, float shoulder, float elbow, float pad_mm, float cell_rad) {
+        ArmPoint points[4];
+        arm_chain(base, shoulder, elbow, points);
+        
+        float nearest = -1.0f;
+        float from_shoulder = 0.0f;   // chain length to the sample
+        float from_elbow = 0.0f;
+        for (int link = 0; link < 3; link++) {
+            const ArmPoint& a = points[link];
+            const ArmPoint& b = points[link + 1];
+            float dx = b.x - a.x;
+            float dy = b.y - a.y;
+            float dz = b.z - a.z;
+            float length = std::sqrt(dx * dx + dy * dy + dz * dz);
+            int samples = std::max(1, static_cast<int>(std::ceil(length / SAMPLE_MM)));
+            
+            for (int i = 0; i <= samples; i++) {
+                float t = static_cast<float>(i) / samples;
+                float x = a.x + dx * t;
+                float y = a.y + dy * t;
+                float z = a.z + dz * t;
+                float along_chain = length * t;
+                float radial = std::sqrt(x * x + y * y);
+                float lever = radial + from_shoulder + along_chain + (link > 0 ? from_elbow + along_chain : 0.0f);
+                float radius = ARM_LINK_RADIUS_MM + pad_mm + lever * cell_rad;
+                
+                if (cone_distance(x, y, z) < radius) {
+                    float rx = x - MOUNT[0];
+                    float ry = y - MOUNT[1];
+                    float rz = z - MOUNT[2];
+                    float range = std::max(0.0f, std::sqrt(rx * rx + ry * ry + rz * rz) - radius) / 10.0f;
+                    if (nearest < 0.0f || range < nearest) {
+                        nearest = range;
+                    }
+                }
+            }
+            from_shoulder += length;
+            if (link > 0) {
+                from_elbow += length;
+            }
+        }
+        return nearest;
+    }
+}
+
+float arm_beam_range(float base, float shoulder, float elbow, float pad_mm) {
+    return chain_beam_range(base, shoulder, elbow, pad_mm, 0.0f);
+}
+
+OcclusionMap::OcclusionMap() : steps(180 / OCCLUSION_STEP_DEG + 1) {
+    build();
+}
+
+void OcclusionMap::build() {
+    table.assign(static_cast<size_t>(steps) * steps * steps, 0);
+    float cell_rad = 0.5f * OCCLUSION_STEP_DEG * DEG_TO_RAD;
+    
+    size_t cell = 0;
+    for (int b = 0; b < steps; b++) {
+        for (int s = 0; s < steps; s++) {
+            for (int e = 0; e < steps; e++, cell++) {
+                float range = chain_beam_range(b * OCCLUSION_STEP_DEG, s * OCCLUSION_STEP_DEG,
+                                               e * OCCLUSION_STEP_DEG, 0.0f, cell_rad);
+                if (range >= 0.0f) {
+                    table[cell] = static_cast<uint8_t>(std::min(255.0f, std::max(1.0f, std::floor(range))));
+                }
+            }
+        }
+    }
+}
+
+int OcclusionMap::index(float angle) const {
+    int i = static_cast<int>(std::lround(angle / OCCLUSION_STEP_DEG));
+    return std::min(steps - 1, std::max(0, i));
+}
+
+float OcclusionMap::armRange(float base, float shoulder, float elbow) const {
+    uint8_t range = table[(static_cast<size_t>(index(base)) * steps + index(shoulder)) * steps + index(elbow)];
+    return range == 0 ? -1.0f : static_cast<float>(range);
+}
+
+bool OcclusionMap::occludes(float base, float shoulder, float elbow, float distance) const {
+    float arm = armRange(base, shoulder, elbow);
+    if (arm < 0.0f) {
+        return false;
+    }
+    return distance < 0.0f || distance >= arm - OCCLUSION_MARGIN_CM;
+}
+
+float OcclusionMap::coverage() const {
+    if (table.empty()) return 0.0f;
+    size_t occluded = std::count_if(table.begin(), table.end(), [](uint8_t range) { return range != 0; });
+    return static_cast<float>(occluded) / table.size();
+}
@@ -0,0 +1,42 @@
+#ifndef OCCLUSION_MAP_H
+#define OCCLUSION_MAP_H
+
+#include <vector>
+#include <cstdint>
+
+// Range (cm) at which the arm itself sits in the ultrasonic beam for the
+// given base/shoulder/elbow angles, -1 if the beam is clear. Links are
+// modeled as capsules of ARM_LINK_RADIUS_MM grown by pad_mm.
+float arm_beam_range(float base, float shoulder, float elbow, float pad_mm = 0.0f);
+
+// Self-occlusion table over pose space. The arm's range in the beam is
+// precomputed for every OCCLUSION_STEP_DEG cell of base/shoulder/elbow,
+// with the links grown by the distance a point can move within a cell,
+// so looking up the nearest cell never misses the arm. One byte per cell
+// (37^3 cells at 5 degrees); lookups are O(1) and lock free.
+class OcclusionMap {
+private:
+    int steps;                     // cells per joint
+    std::vector<uint8_t> table;    // arm range in cm, 0 = beam clear
+    
+    int index(float angle) const;
+    
+public:
+    OcclusionMap();
+    
+    // Fill the table (tens of milliseconds); called by the constructor
+    void build();
+    
+    // Arm range in the beam for a pose (cm), -1 if clear
+    float armRange(float base, float shoulder, float elbow) const;
+    
+    // Whether a reading taken in this pose may be an echo off the arm:
+    // the arm is in the beam and the reading is not clearly in front of it.
+    // A missing echo (-1) while the arm is in the beam is also discarded.
+    bool occludes(float base, float shoulder, float elbow, float distance) const;
+    
+    // Fraction of pose space in which the arm is in the beam
+    float coverage() const;
+};
+
+#endif // OCCLUSION_MAP_H
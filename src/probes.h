@@ -0,0 +1,39 @@
+#ifndef PROBES_H
+#define PROBES_H
+
+// USDT probes on the controller hot paths, provider "smartarm". Built with
+// sys/sdt.h (systemtap-sdt-dev) each probe is a single nop plus an ELF note
+// describing its arguments; perf and bpftrace patch the nop only while they
+// are attached. Without sys/sdt.h the macros compile to nothing.
+//
+//   sudo bpftrace -l 'usdt:./build/SmartArm-Vision:smartarm:*'
+//
+// Probes and arguments:
+//   command_receive(payload, length)       on_message entry
+//   command_parse(command, args)           command word split off the payload
+//   command_done(command)                  command handled
+//   servo_write(servo, pwm, angle)         each PWM write
+//   sensor_ping()                          trigger pulse sent
+//   sensor_echo_start()                    echo line went high
+//   sensor_echo_end(echo_us, distance_mm)  echo over (or beyond range); echo_us -1 on timeout
+//   tick_start(mode)                       control tick begins (0 manual, 1 auto)
+//   tick_end(mode, duration_us)
+//   publish_submit(topic, data, length)    message queued for the MQTT thread
+//   publish_send(topic, data, length, rc)  handed to libmosquitto
+
+#ifdef SMARTARM_USDT
+#include <sys/sdt.h>
+#define ARM_PROBE(name) DTRACE_PROBE(smartarm, name)
+#define ARM_PROBE1(name, a) DTRACE_PROBE1(smartarm, name, a)
+#define ARM_PROBE2(name, a, b) DTRACE_PROBE2(smartarm, name, a, b)
+#define ARM_PROBE3(name, a, b, c) DTRACE_PROBE3(smartarm, name, a, b, c)
+#define ARM_PROBE4(name, a, b, c, d) DTRACE_PROBE4(smartarm, name, a, b, c, d)
+#else
+#define ARM_PROBE(name) do {} while (0)
+#define ARM_PROBE1(name, a) do {} while (0)
+#define ARM_PROBE2(name, a, b) do {} while (0)
+#define ARM_PROBE3(name, a, b, c) do {} while (0)
+#define ARM_PROBE4(name, a, b, c, d) do {} while (0)
+#endif
+
+#endif // PROBES_H
@@ -0,0 +1,297 @@
+#include "range_monitor.h"
+#include "sensor_ultrasonic.h"
+#include "servo_control.h"
+#include "flight_recorder.h"
+#include "metrics.h"
+#include "../include/config.h"
+#include <iostream>
+
+namespace {
+    // Echoes from beyond the exit threshold do not matter to the detector
+    const float MONITOR_RANGE_CM = AUTO_DETECT_DISTANCE_CM + AUTO_HYSTERESIS_CM;
+    
+    // Re-check interval of waits that have no natural deadline
+    const std::chrono::hours IDLE_WAIT(1);
+    
+    MetricCounter& occluded_pings = metrics().counter("smartarm_range_occluded_total",
+                                                      "Auto-mode pings discarded with the arm in the beam");
+}
+
+RangeMonitor::RangeMonitor(UltrasonicSensor& ultrasonic, ServoControl& servo_control) :
+    sensor(ultrasonic),
+    servo(servo_control),
+    running(false),
+    active(false),
+    slow(false),
+    pinging(false),
+    event(false),
+    interrupted(false),
+    in_zone(false),
+    enter_count(0),
+    exit_count(0),
+    enter_distance(-1.0f),
+    event_distance(-1.0f),
+    occupied(false),
+    clear_count(0),
+    last_distance(-1.0f),
+    pings(0),
+    detections(0),
+    occluded(0) {
+}
+
+RangeMonitor::~RangeMonitor() {
+    stop();
+}
+
+bool RangeMonitor::start() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (running) {
+        return false;
+    }
+    running = true;
+    active = false;
+    arm_clock().attach(); // The thread sleeps on the clock
+    if (!thread.start([this]() { run(); })) {
+        arm_clock().detach();
+        running = false;
+        return false;
+    }
+    return true;
+}
+
+void RangeMonitor::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running) return;
+        running = false;
+    }
+    arm_clock().notifyAll(changed);
+    if (thread.joinable()) {
+        // Joining blocks outside the clock; let simulated time run meanwhile
+        arm_clock().detach();
+        thread.join();
+        arm_clock().attach();
+    }
+}
+
+void RangeMonitor::resume() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (active && !slow) return;
+        active = true;
+        slow = false;
+        event = false;
+        in_zone = false;
+        enter_count = 0;
+        exit_count = 0;
+        occupied = false;
+        clear_count = 0;
+    }
+    arm_clock().notifyAll(changed);
+}
+
+void RangeMonitor::resumeSlow() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (active && slow) return;
+        active = true;
+        slow = true;
+        event = false;
+        in_zone = false;
+        enter_count = 0;
+        occupied = false;
+    }
+    arm_clock().notifyAll(changed);
+}
+
+void RangeMonitor::pause() {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!active) return;
+    active = false;
+    lock.unlock();
+    arm_clock().notifyAll(changed);
+    lock.lock();
+    while (!arm_clock().waitUntil(changed, lock, arm_clock().now() + IDLE_WAIT, [this]() { return !pinging; })) {
+    }
+}
+
+bool RangeMonitor::isActive() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return active;
+}
+
+void RangeMonitor::rearm() {
+    bool raised = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        bool pending = event;   // entered while the last one was handled, already counted
+        event = false;
+        in_zone = false;
+        exit_count = 0;
+        if (active && enter_count >= AUTO_ENTER_SAMPLES) {
+            in_zone = true;
+            event = true;
+            event_distance = enter_distance;
+            event_first_seen = first_seen;
+            if (!pending) detections++;
+            raised = true;
+        }
+    }
+    if (raised) {
+        arm_clock().notifyAll(changed);
+    }
+}
+
+bool RangeMonitor::update(float distance, Clock::TimePoint when) {
+    // A short-range ping cannot tell a missed echo from an empty zone,
+    // so anything but an in-zone reading ends the in-zone run
+    if (distance > 0.0f && distance < AUTO_DETECT_DISTANCE_CM) {
+        if (enter_count == 0) first_seen = when;
+        enter_count++;
+        enter_distance = distance;
+    } else {
+        enter_count = 0;
+    }
+    
+    if (distance > 0.0f && distance < AUTO_DETECT_DISTANCE_CM) {
+        if (!occupied) occupied_since = when;
+        occupied = true;
+        clear_count = 0;
+    } else if ((distance < 0.0f || distance > MONITOR_RANGE_CM) && ++clear_count >= AUTO_EXIT_SAMPLES) {
+        occupied = false;
+    }
+    
+    if (!in_zone) {
+        if (enter_count >= AUTO_ENTER_SAMPLES) {
+            in_zone = true;
+            exit_count = 0;
+            return true;
+        }
+    } else {
+        if (distance < 0.0f || distance > MONITOR_RANGE_CM) {
+            exit_count++;
+        } else {
+            exit_count = 0;
+        }
+        if (exit_count >= AUTO_EXIT_SAMPLES) {
+            in_zone = false;
+        }
+    }
+    return false;
+}
+
+void RangeMonitor::readPose(float pose[3]) const {
+    for (int i = 0; i < 3; i++) {
+        pose[i] = servo.getEstimatedAngle(i);
+    }
+}
+
+bool RangeMonitor::armInBeam(const float start_pose[3], float distance) const {
+    // The arm may move during the ping; check both ends of it
+    float end_pose[3];
+    readPose(end_pose);
+    return occlusion.occludes(start_pose[0], start_pose[1], start_pose[2], distance) ||
+           occlusion.occludes(end_pose[0], end_pose[1], end_pose[2], distance);
+}
+
+void RangeMonitor::run() {
+    flight_thread_name("ranging");
+    std::unique_lock<std::mutex> lock(mutex);
+    Clock::TimePoint next_ping = arm_clock().now();
+    
+    while (running) {
+        if (!active) {
+            arm_clock().waitUntil(changed, lock, arm_clock().now() + IDLE_WAIT,
+                                  [this]() { return active || !running; });
+            next_ping = arm_clock().now();
+            continue;
+        }
+        
+        pinging = true;
+        bool slow_ping = slow;
+        lock.unlock();
+        float pose[3];
+        readPose(pose);
+        float distance = sensor.getDistance(slow_ping ? ULTRASONIC_MAX_DISTANCE : MONITOR_RANGE_CM);
+        Clock::TimePoint when = arm_clock().now();
+        bool masked = !slow_ping && armInBeam(pose, distance);
+        lock.lock();
+        pinging = false;
+        pings++;
+        
+        bool entered = false;
+        if (slow_ping) {
+            last_distance = distance; // Manual mode only reports the reading
+        } else if (masked) {
+            // An echo off the arm says nothing about the conveyor. It ends
+            // an in-zone run (the part may be in the gripper by now) but
+            // does not count towards leaving the zone.
+            occluded++;
+            occluded_pings.inc();
+            enter_count = 0;
+        } else {
+            last_distance = distance;
+            entered = active && update(distance, when);
+        }
+        if (entered) {
+            event = true;
+            event_distance = distance;
+            event_first_seen = first_seen;
+            detections++;
+        }
+        if (entered || !active) {
+            // Wake the pick logic, or a pause() waiting for this ping
+            lock.unlock();
+            arm_clock().notifyAll(changed);
+            lock.lock();
+        }
+        
+        next_ping += std::chrono::milliseconds(slow_ping ? RANGE_SLOW_PING_MS : RANGE_PING_MS);
+        if (next_ping < when) {
+            next_ping = when; // Ping overran the interval, do not burst to catch up
+        }
+        arm_clock().waitUntil(changed, lock, next_ping, [this]() { return !active || !running; });
+    }
+    
+    lock.unlock();
+    arm_clock().detach();
+}
+
+bool RangeMonitor::waitForTarget(Clock::TimePoint deadline, float& distance, Clock::TimePoint& seen) {
+    std::unique_lock<std::mutex> lock(mutex);
+    arm_clock().waitUntil(changed, lock, deadline, [this]() { return event || interrupted || !running; });
+    if (interrupted || !event) {
+        interrupted = false;
+        return false;
+    }
+    event = false;
+    distance = event_distance;
+    seen = event_first_seen;
+    return true;
+}
+
+bool RangeMonitor::waitForEntry(Clock::TimePoint deadline, Clock::TimePoint& seen) {
+    std::unique_lock<std::mutex> lock(mutex);
+    arm_clock().waitUntil(changed, lock, deadline, [this]() { return event || interrupted || !running; });
+    if (interrupted || !event) {
+        return false; // An interrupt is left for the next waitForTarget()
+    }
+    seen = event_first_seen;
+    return true;
+}
+
+bool RangeMonitor::occupiedSince(Clock::TimePoint& since) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (occupied) {
+        since = occupied_since;
+    }
+    return occupied;
+}
+
+void RangeMonitor::interrupt() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        interrupted = true;
+    }
+    arm_clock().notifyAll(changed);
+}
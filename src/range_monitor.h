@@ -0,0 +1,122 @@
+#ifndef RANGE_MONITOR_H
+#define RANGE_MONITOR_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include "clock.h"
+#include "occlusion_map.h"
+#include "rt_thread.h"
+
+class UltrasonicSensor;
+class ServoControl;
+
+// Background ranging for auto mode. A thread pings the ultrasonic sensor
+// every RANGE_PING_MS with a short-range measurement and runs the readings
+// through hysteresis and debounce: AUTO_ENTER_SAMPLES consecutive readings
+// inside AUTO_DETECT_DISTANCE_CM raise a "target entered zone" event, and
+// the zone is only left after AUTO_EXIT_SAMPLES readings beyond the
+// detection distance plus AUTO_HYSTERESIS_CM. waitForTarget() sleeps on a
+// condition variable until the event, so the pick logic reacts within a
+// ping of the target settling instead of polling.
+//
+// Ranging continues while the arm moves. Readings taken while the modeled
+// arm pose puts a link in the beam are looked up in an OcclusionMap and
+// discarded, so the arm never counts as a part.
+//
+// In manual mode resumeSlow() keeps a full-range reading every
+// RANGE_SLOW_PING_MS for status and telemetry, without zone detection, so
+// the control thread never waits for an echo.
+//
+// The thread owns the sensor while monitoring; pause() returns only once
+// the ping in flight is done, after which others may use the sensor.
+class RangeMonitor {
+private:
+    UltrasonicSensor& sensor;
+    ServoControl& servo;
+    OcclusionMap occlusion;
+    RtThread thread;
+    std::mutex mutex;
+    std::condition_variable changed;   // event, pause/resume, stop
+    bool running;
+    bool active;                       // pinging, not paused
+    bool slow;                         // manual-mode ranging (resumeSlow())
+    bool pinging;                      // a measurement is in flight
+    bool event;                        // zone entry not yet consumed
+    bool interrupted;                  // interrupt() not yet seen by a waiter
+    bool in_zone;                      // debounced presence
+    int enter_count;                   // consecutive in-zone readings
+    int exit_count;
+    float enter_distance;              // latest in-zone reading
+    float event_distance;
+    Clock::TimePoint first_seen;       // first reading of the in-zone run
+    bool occupied;                     // something may be in the zone (see occupiedSince())
+    int clear_count;
+    Clock::TimePoint occupied_since;
+    Clock::TimePoint event_first_seen;
+    std::atomic<float> last_distance;
+    std::atomic<unsigned long> pings;
+    std::atomic<unsigned long> detections;
+    std::atomic<unsigned long> occluded;
+    
+    void run();
+    
+    // Whether the arm may have been in the beam at either end of a ping
+    bool armInBeam(const float start_pose[3], float distance) const;
+    void readPose(float pose[3]) const;
+    
+    // Feed one reading through debounce and hysteresis; true on zone entry.
+    // Called with the mutex held.
+    bool update(float distance, Clock::TimePoint when);
+    
+public:
+    RangeMonitor(UltrasonicSensor& ultrasonic, ServoControl& servo_control);
+    ~RangeMonitor();
+    
+    RangeMonitor(const RangeMonitor&) = delete;
+    RangeMonitor& operator=(const RangeMonitor&) = delete;
+    
+    // Start the ranging thread, paused; stop() joins it
+    bool start();
+    void stop();
+    
+    // Start pinging with a fresh zone state
+    void resume();
+    // Ping the full range every RANGE_SLOW_PING_MS for getLastDistance() only
+    void resumeSlow();
+    // Stop pinging and wait for the measurement in flight to finish
+    void pause();
+    bool isActive();
+    
+    // Forget a consumed detection: a target still (or newly) in the zone
+    // raises a fresh event, at once if it has already been seen long enough
+    void rearm();
+    
+    // Block until a target enters the zone or the deadline passes. On an
+    // event returns true with its distance and the time the target was
+    // first seen (debounce and wake-up latency end at the return).
+    bool waitForTarget(Clock::TimePoint deadline, float& distance, Clock::TimePoint& seen);
+    
+    // Like waitForTarget() but leaves the event pending, for noting an
+    // arrival while the arm cannot act on it yet
+    bool waitForEntry(Clock::TimePoint deadline, Clock::TimePoint& seen);
+    
+    // Whether the zone has held something since its last clear reading, and
+    // since when. Readings masked by the arm leave it as it is, so a part
+    // that stayed in the zone behind the one just picked is dated to the
+    // first reading of that one.
+    bool occupiedSince(Clock::TimePoint& since);
+    
+    // Make a current or the next waitForTarget() return false early
+    void interrupt();
+    
+    // Latest reading, -1 without an echo inside the monitored range (the
+    // detection range in auto mode, ULTRASONIC_MAX_DISTANCE in manual mode)
+    float getLastDistance() const { return last_distance.load(std::memory_order_relaxed); }
+    unsigned long getPings() const { return pings.load(std::memory_order_relaxed); }
+    unsigned long getDetections() const { return detections.load(std::memory_order_relaxed); }
+    unsigned long getOccluded() const { return occluded.load(std::memory_order_relaxed); }
+    const OcclusionMap& getOcclusionMap() const { return occlusion; }
+};
+
+#endif // RANGE_MONITOR_H
@@ -0,0 +1,248 @@
+#include "routine_runner.h"
+#include "servo_control.h"
+#include "clock.h"
+#include "../include/config.h"
+#include <algorithm>
+
+namespace {
+    // Time allotted to one step: servo travel, or longer under a speed limit
+    std::chrono::milliseconds step_time(const ServoModel& model, const MotionAction& action, int from, int to) {
+        std::chrono::milliseconds travel = model.travelTime(action.servo_id, from, to);
+        if (action.speed_dps > 0.0f) {
+            int paced = static_cast<int>(std::abs(to - from) / action.speed_dps * 1000.0f);
+            travel = std::max(travel, std::chrono::milliseconds(paced));
+        }
+        return travel;
+    }
+    
+    // How early a blended move may hand over to its dependents
+    std::chrono::milliseconds blend_time(const ServoModel& model, const MotionAction& action) {
+        if (action.blend_deg <= 0.0f) return std::chrono::milliseconds(0);
+        return std::chrono::milliseconds(static_cast<int>(action.blend_deg / model.getSpeed(action.servo_id) * 1000.0f));
+    }
+}
+
+RoutineRunner::RoutineRunner(ServoControl& servo_control) : servo(servo_control) {
+}
+
+void RoutineRunner::tracePath(const std::vector<int>& parents, int last, std::vector<int>& path) {
+    path.clear();
+    for (int i = last; i >= 0; i = parents[i]) {
+        path.push_back(i);
+    }
+    std::reverse(path.begin(), path.end());
+}
+
+void RoutineRunner::reserve(size_t actions, RoutineReport& report) {
+    state.reserve(actions);
+    finish.reserve(actions);
+    parent.reserve(actions);
+    report.critical_path.reserve(actions);
+    report.action_start.reserve(actions);
+    report.action_finish.reserve(actions);
+}
+
+void RoutineRunner::estimate(const MotionRoutine& routine, RoutineReport& report) {
+    const std::vector<MotionAction>& actions = routine.getActions();
+    const ServoModel& model = servo.getModel();
+    int n = static_cast<int>(actions.size());
+    finish.assign(n, 0);
+    parent.assign(n, -1);
+    int angle[SERVO_COUNT];
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        angle[i] = servo.getServoAngle(i);
+    }
+    
+    int last = -1;
+    for (int i = 0; i < n; i++) {
+        const MotionAction& action = actions[i];
+        long start = 0;
+        for (int dep : action.depends_on) {
+            if (finish[dep] >= start) {
+                start = finish[dep];
+                parent[i] = dep;
+            }
+        }
+        start += action.offset_ms;
+        
+        long duration = action.dwell_ms;
+        if (action.servo_id >= 0) {
+            // Same-joint actions are ordered, so index order gives the start angle
+            int from = angle[action.servo_id];
+            long shaper_delay = servo.getShaperDelay(action.servo_id).count();
+            for (int step = 1; step <= action.steps; step++) {
+                int to = routine_step_angle(from, action.target_angle, action.steps, step);
+                int prev = routine_step_angle(from, action.target_angle, action.steps, step - 1);
+                duration += step_time(model, action, prev, to).count();
+            }
+            duration += shaper_delay; // The shaped tail of the final step
+            if (action.blend_deg > 0.0f) {
+                duration = std::max(0L, duration - static_cast<long>(blend_time(model, action).count()));
+            } else if (action.wait_settle) {
+                duration += servo.getSettleTime(action.servo_id).count() - shaper_delay;
+            }
+            angle[action.servo_id] = action.target_angle;
+        }
+        
+        finish[i] = start + duration;
+        if (last < 0 || finish[i] >= finish[last]) {
+            last = i;
+        }
+    }
+    
+    report.estimated = std::chrono::milliseconds(last >= 0 ? finish[last] : 0);
+    report.actual = std::chrono::milliseconds(0);
+    report.critical_path.clear();
+    if (last >= 0) {
+        tracePath(parent, last, report.critical_path);
+    }
+    report.success = true;
+}
+
+bool RoutineRunner::run(const MotionRoutine& routine, RoutineReport& report) {
+    const std::vector<MotionAction>& actions = routine.getActions();
+    estimate(routine, report);
+    if (!routine.validate()) {
+        report.success = false;
+        return false;
+    }
+    
+    int n = static_cast<int>(actions.size());
+    state.resize(n);
+    report.action_start.assign(n, std::chrono::milliseconds(-1));
+    report.action_finish.assign(n, std::chrono::milliseconds(-1));
+    for (ActionState& s : state) {
+        s.status = PENDING;
+        s.step = 0;
+        s.start_angle = 0;
+        s.critical_parent = -1;
+    }
+    
+    auto started = arm_clock().now();
+    int remaining = n;
+    int last = -1;
+    
+    while (remaining > 0 && report.success) {
+        servo.update();
+        auto now = arm_clock().now();
+        
+        // Sleep until the next modeled event, ticking at least every control period
+        auto wake = now + std::chrono::milliseconds(CONTROL_TICK_MS);
+        
+        for (int i = 0; i < n; i++) {
+            const MotionAction& action = actions[i];
+            ActionState& s = state[i];
+            
+            if (s.status == PENDING) {
+                // Ready once every dependency is done and the offset has passed
+                Clock::TimePoint ready = started;
+                bool deps_done = true;
+                for (int dep : action.depends_on) {
+                    if (state[dep].status != DONE) {
+                        deps_done = false;
+                        break;
+                    }
+                    if (state[dep].finish_time >= ready) {
+                        ready = state[dep].finish_time;
+                        s.critical_parent = dep;
+                    }
+                }
+                if (!deps_done) continue;
+                ready += std::chrono::milliseconds(action.offset_ms);
+                if (now < ready) {
+                    wake = std::min(wake, ready);
+                    continue;
+                }
+                
+                // Stagger the start while the supply cannot take its surge
+                Clock::TimePoint retry;
+                if (action.servo_id >= 0 && !servo.admitMove(action.servo_id, retry)) {
+                    wake = std::min(wake, retry);
+                    continue;
+                }
+                
+                s.status = RUNNING;
+                report.action_start[i] = std::chrono::duration_cast<std::chrono::milliseconds>(now - started);
+                if (action.servo_id < 0) {
+                    s.hold_until = now + std::chrono::milliseconds(action.dwell_ms);
+                    s.step = action.steps;
+                } else {
+                    s.start_angle = servo.getServoAngle(action.servo_id);
+                    s.step = 1;
+                    int angle = routine_step_angle(s.start_angle, action.target_angle, action.steps, 1);
+                    if (!servo.writeServoAngle(action.servo_id, angle)) {
+                        report.success = false;
+                        break;
+                    }
+                    s.step_due = now + step_time(servo.getModel(), action, s.start_angle, angle);
+                    s.hold_until = Clock::TimePoint::max();
+                }
+            }
+            
+            if (s.status != RUNNING) continue;
+            
+            if (action.servo_id >= 0 && s.hold_until == Clock::TimePoint::max()) {
+                // Issue the next step once the current one has arrived; only the
+                // final step waits for the shaped tail, less any blend allowance
+                auto arrival = s.step < action.steps
+                                   ? s.step_due
+                                   : std::max(s.step_due, servo.arrivalTime(action.servo_id)) -
+                                         blend_time(servo.getModel(), action);
+                if (now < arrival) {
+                    wake = std::min(wake, arrival);
+                    continue;
+                }
+                
+                if (s.step < action.steps) {
+                    Clock::TimePoint retry;
+                    if (!servo.admitMove(action.servo_id, retry)) {
+                        wake = std::min(wake, retry);
+                        continue;
+                    }
+                    int previous = routine_step_angle(s.start_angle, action.target_angle, action.steps, s.step);
+                    s.step++;
+                    int angle = routine_step_angle(s.start_angle, action.target_angle, action.steps, s.step);
+                    if (!servo.writeServoAngle(action.servo_id, angle)) {
+                        report.success = false;
+                        break;
+                    }
+                    s.step_due = now + step_time(servo.getModel(), action, previous, angle);
+                    wake = std::min(wake, std::max(s.step_due, servo.arrivalTime(action.servo_id)));
+                    continue;
+                }
+                
+                // Final step arrived - hold for residual vibration and any extra dwell
+                std::chrono::milliseconds hold(action.dwell_ms);
+                if (action.wait_settle && action.blend_deg <= 0.0f) {
+                    hold += servo.getSettleTime(action.servo_id) - servo.getShaperDelay(action.servo_id);
+                }
+                s.hold_until = now + hold;
+            }
+            
+            if (now < s.hold_until) {
+                wake = std::min(wake, s.hold_until);
+            } else {
+                s.status = DONE;
+                s.finish_time = now;
+                report.action_finish[i] = std::chrono::duration_cast<std::chrono::milliseconds>(now - started);
+                remaining--;
+                if (last < 0 || s.finish_time >= state[last].finish_time) {
+                    last = i;
+                }
+            }
+        }
+        
+        if (remaining > 0) {
+            arm_clock().sleepUntil(wake);
+        }
+    }
+    
+    report.actual = std::chrono::duration_cast<std::chrono::milliseconds>(arm_clock().now() - started);
+    if (last >= 0 && report.success) {
+        for (int i = 0; i < n; i++) {
+            parent[i] = state[i].critical_parent;
+        }
+        tracePath(parent, last, report.critical_path);
+    }
+    return report.success;
+}
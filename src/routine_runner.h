@@ -0,0 +1,59 @@
+#ifndef ROUTINE_RUNNER_H
+#define ROUTINE_RUNNER_H
+
+#include <vector>
+#include <chrono>
+#include "motion_routine.h"
+#include "clock.h"
+
+class ServoControl;
+
+// Result of running (or estimating) a routine
+struct RoutineReport {
+    std::chrono::milliseconds estimated;  // critical path from the servo model
+    std::chrono::milliseconds actual;     // wall time of the run
+    std::vector<int> critical_path;       // action indices, first to last
+    std::vector<std::chrono::milliseconds> action_start;   // per action, from run start (run only)
+    std::vector<std::chrono::milliseconds> action_finish;
+    bool success;
+};
+
+// Executes a MotionRoutine on the servos. Every action starts as soon as
+// its dependencies (plus offset) allow, overlapping independent joints
+// instead of moving them one after another. Scratch state is kept between
+// runs, so after reserve() repeated runs do not allocate.
+class RoutineRunner {
+private:
+    enum ActionStatus { PENDING, RUNNING, DONE };
+    
+    struct ActionState {
+        ActionStatus status;
+        int step;              // steps issued so far
+        int start_angle;
+        int critical_parent;   // dependency that finished last
+        Clock::TimePoint finish_time;
+        Clock::TimePoint hold_until;
+        Clock::TimePoint step_due;  // intermediate steps are paced by travel time
+    };
+    
+    ServoControl& servo;
+    std::vector<ActionState> state;
+    std::vector<long> finish;
+    std::vector<int> parent;
+    
+    static void tracePath(const std::vector<int>& parents, int last, std::vector<int>& path);
+    
+public:
+    explicit RoutineRunner(ServoControl& servo_control);
+    
+    // Preallocate scratch space for routines of up to this many actions
+    void reserve(size_t actions, RoutineReport& report);
+    
+    // Critical path estimate from the slew model, starting at the current angles
+    void estimate(const MotionRoutine& routine, RoutineReport& report);
+    
+    // Execute the routine; returns report.success
+    bool run(const MotionRoutine& routine, RoutineReport& report);
+};
+
+#endif // ROUTINE_RUNNER_H
@@ -0,0 +1,103 @@
+#include "rt_memory.h"
+#include "../include/config.h"
+#include <sys/mman.h>
+#include <malloc.h>
+#include <unistd.h>
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+namespace {
+    std::atomic<bool> tracking(false);
+    
+#ifdef DEBUG_MODE
+    thread_local unsigned long thread_allocations = 0;
+    
+    void* tracked_alloc(std::size_t size) {
+        thread_allocations++;
+        void* ptr = std::malloc(size ? size : 1);
+        if (!ptr) throw std::bad_alloc();
+        return ptr;
+    }
+#endif
+}
+
+#ifdef DEBUG_MODE
+// Count every allocation made through operator new
+void* operator new(std::size_t size) { return tracked_alloc(size); }
+void* operator new[](std::size_t size) { return tracked_alloc(size); }
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { std::free(ptr); }
+
+RtNoAllocScope::RtNoAllocScope(const char* scope_name) :
+    name(scope_name),
+    start(thread_allocations) {
+}
+
+RtNoAllocScope::~RtNoAllocScope() {
+    unsigned long allocations = thread_allocations - start;
+    if (tracking.load(std::memory_order_relaxed) && allocations > 0) {
+        // stdio rather than iostream, which could allocate again
+        std::fprintf(stderr, "RT memory: %lu heap allocation(s) in %s after init\n", allocations, name);
+        assert(allocations == 0);
+    }
+}
+#endif
+
+bool rt_memory_lock() {
+#ifdef __GLIBC__
+    // Keep freed memory in the (locked) heap and serve large blocks from it
+    // instead of fresh mmap()s that would fault on first touch
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+#endif
+    
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        std::cerr << "mlockall failed: " << std::strerror(errno)
+                  << " (needs CAP_IPC_LOCK or a higher RLIMIT_MEMLOCK)" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void rt_prefault_stack() {
+    volatile unsigned char stack[RT_STACK_PREFAULT_KB * 1024];
+    long page = sysconf(_SC_PAGESIZE);
+    for (size_t i = 0; i < sizeof(stack); i += page) {
+        stack[i] = 0;
+    }
+}
+
+void rt_prefault_heap() {
+    size_t size = RT_HEAP_PREFAULT_KB * 1024;
+    void* heap = std::malloc(size);
+    if (!heap) {
+        std::cerr << "Heap prefault of " << RT_HEAP_PREFAULT_KB << " KB failed" << std::endl;
+        return;
+    }
+    volatile unsigned char* bytes = static_cast<unsigned char*>(heap);
+    long page = sysconf(_SC_PAGESIZE);
+    for (size_t i = 0; i < size; i += page) {
+        bytes[i] = 0;
+    }
+    std::free(heap); // Stays in the heap, trimming is off
+}
+
+void rt_allocation_tracking(bool enabled) {
+    tracking.store(enabled, std::memory_order_relaxed);
+}
+
+unsigned long rt_allocation_count() {
+#ifdef DEBUG_MODE
+    return thread_allocations;
+#else
+    return 0;
+#endif
+}
@@ -0,0 +1,46 @@
+#ifndef RT_MEMORY_H
+#define RT_MEMORY_H
+
+// Real-time memory mode: once initialization is done the control path must
+// not allocate or page fault. rt_memory_lock() pins all current and future
+// pages, the prefault helpers touch the stack and heap the loop will use,
+// and DEBUG_MODE builds count heap allocations so RtNoAllocScope can
+// assert that steady-state code stays allocation free.
+
+// Lock memory (mlockall) and stop the allocator returning memory to the kernel
+bool rt_memory_lock();
+
+// Touch RT_STACK_PREFAULT_KB of the calling thread's stack
+void rt_prefault_stack();
+
+// Fault in RT_HEAP_PREFAULT_KB of heap and keep it in the allocator
+void rt_prefault_heap();
+
+// Start (or stop) enforcing RtNoAllocScope; call when initialization is done
+void rt_allocation_tracking(bool enabled);
+
+// Heap allocations made by the calling thread (always 0 without DEBUG_MODE)
+unsigned long rt_allocation_count();
+
+// Asserts that no heap allocation happens on this thread while in scope.
+// Compiles to nothing without DEBUG_MODE.
+class RtNoAllocScope {
+private:
+#ifdef DEBUG_MODE
+    const char* name;
+    unsigned long start;
+#endif
+    
+public:
+#ifdef DEBUG_MODE
+    explicit RtNoAllocScope(const char* scope_name);
+    ~RtNoAllocScope();
+#else
+    explicit RtNoAllocScope(const char*) {}
+#endif
+    
+    RtNoAllocScope(const RtNoAllocScope&) = delete;
+    RtNoAllocScope& operator=(const RtNoAllocScope&) = delete;
+};
+
+#endif // RT_MEMORY_H
@@ -0,0 +1,48 @@
+#include "rt_thread.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <iostream>
+#include <utility>
+
+RtThread::RtThread() : handle(), started(false) {
+}
+
+RtThread::~RtThread() {
+    join();
+}
+
+void* RtThread::entry(void* self) {
+    static_cast<RtThread*>(self)->body();
+    return nullptr;
+}
+
+bool RtThread::start(std::function<void()> thread_body, size_t stack_kb) {
+    if (started || !thread_body) {
+        return false;
+    }
+    body = std::move(thread_body);
+    
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    size_t stack = std::max(static_cast<size_t>(PTHREAD_STACK_MIN), stack_kb * 1024);
+    int error = pthread_attr_setstacksize(&attr, stack);
+    if (error == 0) {
+        error = pthread_create(&handle, &attr, &RtThread::entry, this);
+    }
+    pthread_attr_destroy(&attr);
+    if (error != 0) {
+        std::cerr << "Failed to start thread (" << stack_kb << " KB stack): " << std::strerror(error) << std::endl;
+        body = nullptr;
+        return false;
+    }
+    started = true;
+    return true;
+}
+
+void RtThread::join() {
+    if (started) {
+        pthread_join(handle, nullptr);
+        started = false;
+    }
+}
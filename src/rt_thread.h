@@ -0,0 +1,36 @@
+#ifndef RT_THREAD_H
+#define RT_THREAD_H
+
+#include <pthread.h>
+#include <cstddef>
+#include <functional>
+#include "../include/config.h"
+
+// Thread created with an explicit stack size. std::thread always gets the
+// 8 MB default, and RT_MEMORY_MODE's mlockall faults in and pins every
+// page of it; the controller's helper threads (MQTT, watchdog, ranging,
+// telemetry, HTTP) need a small fraction of that. Used like std::thread,
+// except that start() reports failure instead of throwing.
+class RtThread {
+private:
+    pthread_t handle;
+    bool started;
+    std::function<void()> body;
+    
+    static void* entry(void* self);
+    
+public:
+    RtThread();
+    ~RtThread();
+    
+    RtThread(const RtThread&) = delete;
+    RtThread& operator=(const RtThread&) = delete;
+    
+    // Run body on a new thread with a stack of stack_kb
+    bool start(std::function<void()> thread_body, size_t stack_kb = RT_THREAD_STACK_KB);
+    
+    bool joinable() const { return started; }
+    void join();
+};
+
+#endif // RT_THREAD_H
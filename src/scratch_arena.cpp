@@ -0,0 +1,70 @@
+#include "scratch_arena.h"
+#include "metrics.h"
+#include "../include/config.h"
+#include <cstdio>
+#include <cstdint>
+#include <algorithm>
+#include <new>
+
+namespace {
+    MetricGauge& high_water_bytes = metrics().gauge("smartarm_scratch_arena_high_water_bytes",
+                                                    "Most scratch arena bytes a calibration pass needed");
+    MetricCounter& overflow_count = metrics().counter("smartarm_scratch_arena_overflows_total",
+                                                      "Scratch arena passes that fell back to the heap");
+}
+
+ScratchArena::ScratchArena(size_t bytes) :
+    buffer(static_cast<unsigned char*>(::operator new(bytes))),
+    capacity(bytes),
+    used(0),
+    overflow_bytes(0),
+    high_water(0),
+    overflows(0) {
+}
+
+ScratchArena::~ScratchArena() {
+    ::operator delete(buffer);
+}
+
+void* ScratchArena::allocate(size_t bytes, size_t alignment) {
+    uintptr_t base = reinterpret_cast<uintptr_t>(buffer);
+    size_t offset = ((base + used + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base;
+    if (offset + bytes <= capacity) {
+        used = offset + bytes;
+        high_water = std::max(high_water, used + overflow_bytes);
+        return buffer + offset;
+    }
+    
+    // Out of scratch space - fall back to the heap for this request
+    overflow_bytes += bytes;
+    high_water = std::max(high_water, used + overflow_bytes);
+    return ::operator new(bytes, std::align_val_t(alignment));
+}
+
+void ScratchArena::deallocate(void* ptr, size_t bytes, size_t alignment) {
+    if (!owns(ptr)) {
+        ::operator delete(ptr, bytes, std::align_val_t(alignment));
+    }
+}
+
+void ScratchArena::release(size_t mark) {
+    used = mark;
+    if (used > 0) {
+        return;
+    }
+    if (high_water > high_water_bytes.value()) {
+        high_water_bytes.set(static_cast<double>(high_water));
+    }
+    if (overflow_bytes > 0) {
+        std::fprintf(stderr, "Scratch arena overflow: %zu bytes from the heap (arena %zu bytes, raise SCRATCH_ARENA_KB)\n",
+                     overflow_bytes, capacity);
+        overflows++;
+        overflow_count.inc();
+        overflow_bytes = 0;
+    }
+}
+
+ScratchArena& scratch_arena() {
+    thread_local ScratchArena arena(SCRATCH_ARENA_KB * 1024);
+    return arena;
+}
@@ -0,0 +1,88 @@
+#ifndef SCRATCH_ARENA_H
+#define SCRATCH_ARENA_H
+
+#include <cstddef>
+#include <vector>
+
+// Bump-pointer scratch memory for the calibration procedures (shaper
+// identification). Allocation is a pointer increment, deallocation is a
+// no-op, and an ArenaScope releases everything allocated inside it at once.
+// Requests that do not fit fall back to the heap and are logged when the
+// outermost scope closes, so a too-small arena shows up instead of failing.
+// The most scratch any pass needed and the passes that overflowed are
+// exported as metrics, to size SCRATCH_ARENA_KB. Not thread safe: each
+// thread gets its own arena through scratch_arena().
+class ScratchArena {
+private:
+    unsigned char* buffer;
+    size_t capacity;
+    size_t used;
+    size_t overflow_bytes;        // heap fallback since the arena was last empty
+    size_t high_water;            // most bytes needed at once, heap fallback included
+    unsigned long overflows;      // passes (outermost scopes) that needed the heap
+    
+public:
+    explicit ScratchArena(size_t bytes);
+    ~ScratchArena();
+    
+    ScratchArena(const ScratchArena&) = delete;
+    ScratchArena& operator=(const ScratchArena&) = delete;
+    
+    void* allocate(size_t bytes, size_t alignment);
+    void deallocate(void* ptr, size_t bytes, size_t alignment);
+    
+    // Release everything allocated since getUsed() returned mark
+    void release(size_t mark);
+    
+    bool owns(const void* ptr) const { return ptr >= buffer && ptr < buffer + capacity; }
+    size_t getCapacity() const { return capacity; }
+    size_t getUsed() const { return used; }
+    size_t getHighWater() const { return high_water; }
+    unsigned long getOverflows() const { return overflows; }
+};
+
+// The calling thread's arena (SCRATCH_ARENA_KB, created on first use)
+ScratchArena& scratch_arena();
+
+// Releases the scratch allocated while it is alive; declare it before the
+// containers that use the arena so they are destroyed first
+class ArenaScope {
+private:
+    ScratchArena& arena;
+    size_t mark;
+    
+public:
+    explicit ArenaScope(ScratchArena& scratch = scratch_arena()) : arena(scratch), mark(scratch.getUsed()) {}
+    ~ArenaScope() { arena.release(mark); }
+    
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+};
+
+// STL allocator adapter over the calling thread's scratch arena
+template <typename T>
+class ArenaAllocator {
+private:
+    ScratchArena* arena;
+    
+    template <typename U> friend class ArenaAllocator;
+    
+public:
+    typedef T value_type;
+    
+    ArenaAllocator() : arena(&scratch_arena()) {}
+    explicit ArenaAllocator(ScratchArena& scratch) : arena(&scratch) {}
+    template <typename U> ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+    
+    T* allocate(size_t n) { return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T))); }
+    void deallocate(T* ptr, size_t n) { arena->deallocate(ptr, n * sizeof(T), alignof(T)); }
+    
+    template <typename U> bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+    template <typename U> bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
+};
+
+// Scratch vector; must not outlive the ArenaScope it was filled in
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+#endif // SCRATCH_ARENA_H
@@ -1,11 +1,26 @@
 #include "sensor_ultrasonic.h"
 #include "../include/config.h"
+#include "clock.h"
+#include "flight_recorder.h"
+#include "probes.h"
+#include "metrics.h"
 #include <wiringPi.h>
 #include <iostream>
 #include <chrono>
-#include <thread>
-#include <vector>
-#include <numeric>
+
+namespace {
+    MetricCounter& readings_ok = metrics().counter("smartarm_ultrasonic_readings_total",
+                                                   "Ultrasonic readings by result", "result=\"ok\"");
+    MetricCounter& readings_timeout = metrics().counter("smartarm_ultrasonic_readings_total",
+                                                        "Ultrasonic readings by result", "result=\"timeout\"");
+    MetricCounter& readings_out_of_range = metrics().counter("smartarm_ultrasonic_readings_total",
+                                                             "Ultrasonic readings by result",
+                                                             "result=\"out_of_range\"");
+    MetricHistogram& echo_seconds = metrics().histogram("smartarm_ultrasonic_echo_seconds",
+                                                        "Echo pulse width of valid readings",
+                                                        {0.0002, 0.0005, 0.001, 0.002, 0.005, 0.01, 0.025});
+    MetricGauge& last_distance = metrics().gauge("smartarm_ultrasonic_distance_cm", "Last valid distance reading");
+}
 
 UltrasonicSensor::UltrasonicSensor() : 
     trig_pin(ULTRASONIC_TRIG_PIN), 
@@ -28,56 +43,73 @@ bool UltrasonicSensor::initialize() {
     
     // Ensure trigger is low initially
     digitalWrite(trig_pin, LOW);
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    arm_clock().sleepFor(std::chrono::milliseconds(10));
     
     initialized = true;
     std::cout << "Ultrasonic sensor initialized successfully" << std::endl;
     return true;
 }
 
-float UltrasonicSensor::getDistance() {
+float UltrasonicSensor::getDistance(float max_distance) {
     if (!initialized) {
         std::cerr << "Ultrasonic sensor not initialized" << std::endl;
         return -1.0f;
     }
     
     // Send trigger pulse
+    ARM_PROBE(sensor_ping);
     digitalWrite(trig_pin, HIGH);
-    std::this_thread::sleep_for(std::chrono::microseconds(10));
+    arm_clock().sleepFor(std::chrono::microseconds(10));
     digitalWrite(trig_pin, LOW);
     
     // Wait for echo start
-    auto start_time = std::chrono::high_resolution_clock::now();
+    auto start_time = arm_clock().now();
     auto timeout = start_time + std::chrono::milliseconds(30);
     
     while (digitalRead(echo_pin) == LOW) {
-        if (std::chrono::high_resolution_clock::now() > timeout) {
+        if (arm_clock().now() > timeout) {
             std::cerr << "Ultrasonic sensor timeout (echo start)" << std::endl;
+            flight_record(FLIGHT_SENSOR, 0, -1);
+            ARM_PROBE2(sensor_echo_end, -1, 0);
+            readings_timeout.inc();
             return -1.0f;
         }
+        arm_clock().spinPause();
     }
     
-    // Measure echo duration
-    auto echo_start = std::chrono::high_resolution_clock::now();
-    timeout = echo_start + std::chrono::milliseconds(30);
+    // Measure echo duration, giving up once it means a target beyond max_distance
+    auto echo_start = arm_clock().now();
+    ARM_PROBE(sensor_echo_start);
+    timeout = echo_start + std::chrono::microseconds(static_cast<long>(max_distance * 2.0f / 0.0343f) + 100);
     
     while (digitalRead(echo_pin) == HIGH) {
-        if (std::chrono::high_resolution_clock::now() > timeout) {
-            std::cerr << "Ultrasonic sensor timeout (echo end)" << std::endl;
-            return -1.0f;
+        if (arm_clock().now() > timeout) {
+            int echo_us = static_cast<int>(
+                std::chrono::duration_cast<std::chrono::microseconds>(arm_clock().now() - echo_start).count());
+            flight_record(FLIGHT_SENSOR, 0, echo_us, echo_us * 0.0343f / 2.0f);
+            ARM_PROBE2(sensor_echo_end, echo_us, static_cast<int>(echo_us * 0.343f / 2.0f));
+            readings_out_of_range.inc();
+            return -1.0f; // Beyond max_distance, or no object at all
         }
+        arm_clock().spinPause();
     }
     
-    auto echo_end = std::chrono::high_resolution_clock::now();
+    auto echo_end = arm_clock().now();
     
     // Calculate distance (speed of sound = 343 m/s = 0.0343 cm/μs)
     auto duration = std::chrono::duration_cast<std::chrono::microseconds>(echo_end - echo_start);
     float distance = (duration.count() * 0.0343f) / 2.0f; // Divide by 2 for round trip
+    flight_record(FLIGHT_SENSOR, 0, static_cast<int>(duration.count()), distance);
+    ARM_PROBE2(sensor_echo_end, static_cast<int>(duration.count()), static_cast<int>(distance * 10.0f));
     
     // Validate reading
-    if (distance < 2.0f || distance > ULTRASONIC_MAX_DISTANCE) {
+    if (distance < 2.0f || distance > max_distance) {
+        readings_out_of_range.inc();
         return -1.0f; // Invalid reading
     }
+    readings_ok.inc();
+    echo_seconds.observe(std::chrono::duration<double>(duration).count());
+    last_distance.set(distance);
     
     return distance;
 }
@@ -85,23 +117,24 @@ float UltrasonicSensor::getDistance() {
 float UltrasonicSensor::getAverageDistance(int samples) {
     if (samples <= 0) samples = 1;
     
-    std::vector<float> readings;
-    readings.reserve(samples);
+    // Running sum, no buffer to allocate
+    float sum = 0.0f;
+    int valid = 0;
     
     for (int i = 0; i < samples; i++) {
         float distance = getDistance();
         if (distance > 0) {
-            readings.push_back(distance);
+            sum += distance;
+            valid++;
         }
-        std::this_thread::sleep_for(std::chrono::milliseconds(60)); // Delay between readings
+        arm_clock().sleepFor(std::chrono::milliseconds(60)); // Delay between readings
     }
     
-    if (readings.empty()) {
+    if (valid == 0) {
         return -1.0f;
     }
     
-    float sum = std::accumulate(readings.begin(), readings.end(), 0.0f);
-    return sum / readings.size();
+    return sum / valid;
 }
 
 bool UltrasonicSensor::isObjectInRange(float min_distance, float max_distance) {
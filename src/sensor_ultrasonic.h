@@ -1,6 +1,8 @@
 #ifndef SENSOR_ULTRASONIC_H
 #define SENSOR_ULTRASONIC_H
 
+#include "../include/config.h"
+
 class UltrasonicSensor {
 private:
     int trig_pin;
@@ -14,8 +16,10 @@ public:
     // Initialize ultrasonic sensor
     bool initialize();
     
-    // Get distance measurement in centimeters
-    float getDistance();
+    // Get distance measurement in centimeters, -1 without a valid echo.
+    // Stops listening once the echo is longer than max_distance, so a
+    // short-range ping costs little CPU.
+    float getDistance(float max_distance = ULTRASONIC_MAX_DISTANCE);
     
     // Get multiple readings and return average
     float getAverageDistance(int samples = 5);
@@ -1,11 +1,43 @@
 #include "servo_control.h"
+#include "flight_recorder.h"
+#include "probes.h"
+#include "metrics.h"
 #include "../include/config.h"
 #include <wiringPi.h>
 #include <softPwm.h>
 #include <iostream>
-#include <thread>
 #include <chrono>
 #include <algorithm>
+#include <cmath>
+#include <string>
+
+namespace {
+    // Modeled travel time accumulates into a duty counter: its rate is the
+    // fraction of time the joint is moving
+    struct ServoMetrics {
+        MetricCounter* writes[SERVO_COUNT];
+        MetricCounter* travel[SERVO_COUNT];
+        MetricCounter* energized_seconds[SERVO_COUNT];
+        MetricGauge* energized[SERVO_COUNT];
+        
+        ServoMetrics() {
+            for (int i = 0; i < SERVO_COUNT; i++) {
+                std::string labels = "servo=\"" + std::to_string(i) + "\"";
+                writes[i] = &metrics().counter("smartarm_servo_writes_total", "PWM writes per servo", labels);
+                travel[i] = &metrics().counter("smartarm_servo_travel_seconds_total",
+                                               "Modeled time spent moving per servo", labels);
+                energized_seconds[i] = &metrics().counter("smartarm_servo_energized_seconds_total",
+                                                          "Time with PWM pulses per servo", labels);
+                energized[i] = &metrics().gauge("smartarm_servo_energized",
+                                                "1 while a servo receives pulses, 0 detached or stopped", labels);
+            }
+        }
+    };
+    
+    const float HOLD_CURRENT_MA[SERVO_COUNT] = SERVO_HOLD_CURRENT_MA;
+    
+    ServoMetrics servo_metrics;
+}
 
 ServoControl::ServoControl() : initialized(false) {
     servo_pins = {
@@ -16,6 +48,20 @@ ServoControl::ServoControl() : initialized(false) {
         SERVO_GRIPPER_PIN
     };
     current_angles.resize(servo_pins.size(), 90); // Initialize to middle position
+    
+    const float frequencies[SERVO_COUNT] = SHAPER_FREQ_HZ;
+    const float dampings[SERVO_COUNT] = SHAPER_DAMPING;
+    const int hold[SERVO_COUNT] = SERVO_HOLD_TORQUE;
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        shapers[i].configure(static_cast<ShaperType>(SHAPER_DEFAULT_TYPE), frequencies[i], dampings[i]);
+        output_angles[i] = -1;
+        hold_torque[i] = hold[i] != 0;
+        energized[i] = false;
+        detached[i] = false;
+        start_held[i] = false;
+        energized_time[i] = Clock::Duration::zero();
+        detached_time[i] = Clock::Duration::zero();
+    }
 }
 
 ServoControl::~ServoControl() {
@@ -39,6 +85,10 @@ bool ServoControl::initialize() {
         }
     }
     
+    power_start = arm_clock().now();
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        power_mark[i] = power_start;
+    }
     initialized = true;
     moveToHome();
     
@@ -47,6 +97,17 @@ bool ServoControl::initialize() {
 }
 
 bool ServoControl::setServoAngle(int servo_id, int angle) {
+    if (!writeServoAngle(servo_id, angle)) {
+        return false;
+    }
+    
+    // Wait for the modeled servo movement
+    waitForArrival(servo_id);
+    
+    return true;
+}
+
+bool ServoControl::writeServoAngle(int servo_id, int angle) {
     if (!initialized) {
         std::cerr << "Servo control not initialized" << std::endl;
         return false;
@@ -62,18 +123,241 @@ bool ServoControl::setServoAngle(int servo_id, int angle) {
         return false;
     }
     
-    // Convert angle to PWM value (typical servo: 1ms-2ms pulse width)
-    // PWM range 0-200, servo range 0-180 degrees
-    int pwm_value = (angle * 200) / 180;
+    current_angles[servo_id] = angle;
+    flight_record(FLIGHT_SETPOINT, servo_id, angle);
+    
+    std::lock_guard<std::mutex> lock(shaper_mutex);
+    InputShaper& shaper = shapers[servo_id];
+    if (shaper.getType() == SHAPER_NONE) {
+        writeOutput(servo_id, angle);
+    } else {
+        // First impulse goes out now, the rest on later update() ticks
+        auto now = arm_clock().now();
+        shaper.setReference(static_cast<float>(angle), now);
+        writeOutput(servo_id, static_cast<int>(std::lround(shaper.output(now))));
+    }
+    
+    return true;
+}
+
+void ServoControl::writeOutput(int servo_id, int angle) {
+    if (angle == output_angles[servo_id] && !detached[servo_id]) {
+        return;
+    }
+    
+    auto now = arm_clock().now();
+    bool from_rest = startsFromRest(servo_id, now);
+    accountPower(servo_id, now);
+    if (detached[servo_id]) {
+        // The horn stayed where the last pulse left it; resuming pulses
+        // holds it again from the next PWM frame
+        detached[servo_id] = false;
+        model.reset(servo_id, static_cast<float>(output_angles[servo_id]));
+        flight_record(FLIGHT_EVENT, FLIGHT_EVENT_SERVO_POWER, servo_id, 1.0f);
+    }
+    energized[servo_id] = true;
+    servo_metrics.energized[servo_id]->set(1.0);
+    
+    // Convert angle to PWM value (typical servo: 0.5ms-2.5ms pulse width)
+    // PWM range 0-200 = 20ms frame in 0.1ms units, servo range 0-180 degrees
+    int pwm_value = 5 + (angle * 20) / 180;
     pwm_value = std::max(5, std::min(25, pwm_value)); // Clamp to safe range
     
     softPwmWrite(servo_pins[servo_id], pwm_value);
-    current_angles[servo_id] = angle;
+    flight_record(FLIGHT_OUTPUT, servo_id, pwm_value, static_cast<float>(angle));
+    ARM_PROBE3(servo_write, servo_id, pwm_value, angle);
+    servo_metrics.writes[servo_id]->inc();
+    servo_metrics.travel[servo_id]->inc(std::chrono::duration<double>(
+        model.travelTime(servo_id, model.estimatePosition(servo_id), static_cast<float>(angle))).count());
+    output_angles[servo_id] = angle;
+    model.command(servo_id, static_cast<float>(angle));
+    
+    float pose[3];
+    drivenPose(pose);
+    budget.recordMove(servo_id, now, model.arrivalTime(servo_id), from_rest,
+                      CurrentBudget::holdCurrent(servo_id, pose));
+    if (servo_id == 1 || servo_id == 2) {
+        // Shoulder and elbow share the gravity load of the forearm
+        int other = 3 - servo_id;
+        if (energized[other]) {
+            budget.setHolding(other, CurrentBudget::holdCurrent(other, pose));
+        }
+    }
+}
+
+void ServoControl::drivenPose(float pose[3]) const {
+    for (int i = 0; i < 3; i++) {
+        pose[i] = static_cast<float>(output_angles[i] >= 0 ? output_angles[i] : current_angles[i]);
+    }
+}
+
+bool ServoControl::admitMove(int servo_id, Clock::TimePoint& retry) {
+    if (servo_id < 0 || servo_id >= SERVO_COUNT) return true;
+    std::lock_guard<std::mutex> lock(shaper_mutex);
+    auto now = arm_clock().now();
+    return budget.admit(servo_id, startsFromRest(servo_id, now), now, retry);
+}
+
+bool ServoControl::admitStart(int servo_id) {
+    if (servo_id < 0 || servo_id >= SERVO_COUNT) return true;
+    std::lock_guard<std::mutex> lock(shaper_mutex);
+    auto now = arm_clock().now();
+    if (!startsFromRest(servo_id, now)) {
+        start_held[servo_id] = false;
+        return true;
+    }
     
-    // Small delay for servo movement
-    std::this_thread::sleep_for(std::chrono::milliseconds(SERVO_DELAY_MS));
+    // A hold long past its limit belongs to a start that was abandoned
+    const std::chrono::milliseconds wait(SUPPLY_START_WAIT_MS);
+    bool held = start_held[servo_id] && now < start_limit[servo_id] + wait;
+    if (held && now < start_retry[servo_id]) {
+        return false;
+    }
+    if (held && now >= start_limit[servo_id]) {
+        // Waited as long as the operator won't notice; start over budget,
+        // which recordMove() counts as an overload
+        start_held[servo_id] = false;
+        return true;
+    }
     
-    return true;
+    Clock::TimePoint retry;
+    if (budget.admit(servo_id, true, now, retry)) {
+        start_held[servo_id] = false;
+        return true;
+    }
+    if (!held) {
+        start_held[servo_id] = true;
+        start_limit[servo_id] = now + wait;
+    }
+    start_retry[servo_id] = std::min(retry, start_limit[servo_id]);
+    return false;
+}
+
+bool ServoControl::startsFromRest(int servo_id, Clock::TimePoint now) const {
+    // Stepped moves issue the next step as the previous one arrives, which
+    // continues the motion; only a joint parked for longer than the
+    // surge starts again from rest
+    return detached[servo_id] || !energized[servo_id] ||
+           now >= model.arrivalTime(servo_id) + std::chrono::milliseconds(SERVO_ACCEL_MS);
+}
+
+void ServoControl::update() {
+    if (!initialized) return;
+    
+    std::lock_guard<std::mutex> lock(shaper_mutex);
+    auto now = arm_clock().now();
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        if (shapers[i].getType() == SHAPER_NONE) {
+            continue;
+        }
+        int shaped = static_cast<int>(std::lround(shapers[i].output(now)));
+        if (shaped != output_angles[i]) {
+            writeOutput(i, shaped); // An unchanged output must not re-engage a detached servo
+        }
+    }
+    detachIdle(now);
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        accountPower(i, now);
+    }
+}
+
+void ServoControl::accountPower(int servo_id, Clock::TimePoint now) {
+    Clock::Duration elapsed = now - power_mark[servo_id];
+    if (energized[servo_id]) {
+        energized_time[servo_id] += elapsed;
+        servo_metrics.energized_seconds[servo_id]->inc(std::chrono::duration<double>(elapsed).count());
+    } else if (detached[servo_id]) {
+        detached_time[servo_id] += elapsed;
+    }
+    power_mark[servo_id] = now;
+}
+
+void ServoControl::detachIdle(Clock::TimePoint now) {
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        if (hold_torque[i] || !energized[i]) {
+            continue;
+        }
+        auto parked = std::max(shapers[i].settledTime(), model.arrivalTime(i));
+        if (now < parked + std::chrono::milliseconds(SERVO_IDLE_DETACH_MS)) {
+            continue;
+        }
+        accountPower(i, now);
+        softPwmWrite(servo_pins[i], 0);
+        budget.release(i);
+        energized[i] = false;
+        detached[i] = true;
+        servo_metrics.energized[i]->set(0.0);
+        flight_record(FLIGHT_EVENT, FLIGHT_EVENT_SERVO_POWER, i, 0.0f);
+    }
+}
+
+bool ServoControl::isEnergized(int servo_id) {
+    if (servo_id < 0 || servo_id >= SERVO_COUNT) return false;
+    std::lock_guard<std::mutex> lock(shaper_mutex);
+    return energized[servo_id];
+}
+
+float ServoControl::getDuty(int servo_id) {
+    if (servo_id < 0 || servo_id >= SERVO_COUNT || !initialized) return 0.0f;
+    std::lock_guard<std::mutex> lock(shaper_mutex);
+    auto now = arm_clock().now();
+    accountPower(servo_id, now);
+    double total = std::chrono::duration<double>(now - power_start).count();
+    return total > 0.0 ? static_cast<float>(std::chrono::duration<double>(energized_time[servo_id]).count() / total)
+                       : 0.0f;
+}
+
+float ServoControl::getIdleSavingMa() {
+    std::lock_guard<std::mutex> lock(shaper_mutex);
+    float saving = 0.0f;
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        if (detached[i]) saving += HOLD_CURRENT_MA[i];
+    }
+    return saving;
+}
+
+float ServoControl::getIdleSavedMah() {
+    if (!initialized) return 0.0f;
+    std::lock_guard<std::mutex> lock(shaper_mutex);
+    auto now = arm_clock().now();
+    double saved = 0.0;
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        accountPower(i, now);
+        saved += std::chrono::duration<double>(detached_time[i]).count() / 3600.0 * HOLD_CURRENT_MA[i];
+    }
+    return static_cast<float>(saved);
+}
+
+bool ServoControl::configureShaper(int servo_id, float frequency_hz, float damping_ratio) {
+    if (servo_id < 0 || servo_id >= SERVO_COUNT) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(shaper_mutex);
+    InputShaper& shaper = shapers[servo_id];
+    return shaper.configure(shaper.getType(), frequency_hz, damping_ratio);
+}
+
+void ServoControl::setShaperType(ShaperType type) {
+    std::lock_guard<std::mutex> lock(shaper_mutex);
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        shapers[i].configure(type, shapers[i].getFrequency(), shapers[i].getDamping());
+        shapers[i].reset(static_cast<float>(current_angles[i]));
+    }
+}
+
+ShaperType ServoControl::getShaperType() {
+    std::lock_guard<std::mutex> lock(shaper_mutex);
+    return shapers[0].getType();
+}
+
+std::chrono::milliseconds ServoControl::getSettleTime(int servo_id) {
+    if (servo_id < 0 || servo_id >= SERVO_COUNT) {
+        return std::chrono::milliseconds(0);
+    }
+    std::lock_guard<std::mutex> lock(shaper_mutex);
+    const InputShaper& shaper = shapers[servo_id];
+    return std::chrono::duration_cast<std::chrono::milliseconds>(shaper.shaperDuration()) +
+           shaper.residualSettleTime();
 }
 
 bool ServoControl::setServoAngles(const std::vector<int>& angles) {
@@ -82,12 +366,19 @@ bool ServoControl::setServoAngles(const std::vector<int>& angles) {
         return false;
     }
     
+    // Command all joints so they move together, as far as the supply allows,
+    // then wait for the slowest
     bool success = true;
     for (size_t i = 0; i < angles.size(); i++) {
-        if (!setServoAngle(i, angles[i])) {
+        Clock::TimePoint retry;
+        while (initialized && !admitMove(i, retry)) {
+            tickUntil(retry);
+        }
+        if (!writeServoAngle(i, angles[i])) {
             success = false;
         }
     }
+    waitForArrival();
     
     return success;
 }
@@ -99,22 +390,98 @@ int ServoControl::getServoAngle(int servo_id) const {
     return current_angles[servo_id];
 }
 
-std::vector<int> ServoControl::getAllAngles() const {
+const std::vector<int>& ServoControl::getAllAngles() const {
     return current_angles;
 }
 
+ServoModel::TimePoint ServoControl::arrivalTime(int servo_id) {
+    if (servo_id < 0 || servo_id >= SERVO_COUNT) {
+        return arm_clock().now();
+    }
+    std::lock_guard<std::mutex> lock(shaper_mutex);
+    return std::max(shapers[servo_id].settledTime(), model.arrivalTime(servo_id));
+}
+
+void ServoControl::tickUntil(ServoModel::TimePoint when) {
+    while (true) {
+        update();
+        auto now = arm_clock().now();
+        if (now >= when) break;
+        arm_clock().sleepUntil(std::min(when, now + std::chrono::milliseconds(CONTROL_TICK_MS)));
+    }
+}
+
+bool ServoControl::isMoving() {
+    auto now = arm_clock().now();
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        if (now < arrivalTime(i)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ServoControl::waitForArrival(int servo_id) {
+    if (servo_id < 0 || servo_id >= SERVO_COUNT) return;
+    
+    // Keep ticking the shaper until its last impulse is out and the servo got there
+    ServoModel::TimePoint done = arrivalTime(servo_id);
+    while (arm_clock().now() < done) {
+        tickUntil(done);
+        done = arrivalTime(servo_id);
+    }
+}
+
+void ServoControl::waitForArrival() {
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        waitForArrival(i);
+    }
+}
+
+void ServoControl::waitForSettle(int servo_id) {
+    if (servo_id < 0 || servo_id >= SERVO_COUNT) return;
+    waitForArrival(servo_id);
+    
+    std::chrono::milliseconds residual;
+    {
+        std::lock_guard<std::mutex> lock(shaper_mutex);
+        residual = shapers[servo_id].residualSettleTime();
+    }
+    arm_clock().sleepUntil(arrivalTime(servo_id) + residual);
+}
+
+void ServoControl::waitForSettle() {
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        waitForSettle(i);
+    }
+}
+
 void ServoControl::moveToHome() {
-    std::vector<int> home_position = {90, 90, 90, 90, 90}; // Middle positions
+    static const std::vector<int> home_position = {90, 90, 90, 90, 90}; // Middle positions
     setServoAngles(home_position);
     std::cout << "Moved to home position" << std::endl;
 }
 
 void ServoControl::emergencyStop() {
     if (!initialized) return;
+    flight_record(FLIGHT_EVENT, FLIGHT_EVENT_ESTOP, 0);
     
     for (int pin : servo_pins) {
         softPwmWrite(pin, 0); // Stop PWM signal
     }
+    
+    // Drop pending shaped impulses so nothing moves after the stop
+    std::lock_guard<std::mutex> lock(shaper_mutex);
+    auto now = arm_clock().now();
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        shapers[i].reset(static_cast<float>(current_angles[i]));
+        output_angles[i] = -1;
+        accountPower(i, now);
+        budget.release(i);
+        energized[i] = false;
+        detached[i] = false;
+        servo_metrics.energized[i]->set(0.0);
+    }
     std::cout << "Emergency stop activated" << std::endl;
 }
 
@@ -125,13 +492,23 @@ bool ServoControl::smoothMove(int servo_id, int target_angle, int steps) {
     
     int current = current_angles[servo_id];
     int step_size = (target_angle - current) / steps;
+    int previous = current;
     
     for (int i = 1; i <= steps; i++) {
         int intermediate_angle = current + (step_size * i);
         if (i == steps) intermediate_angle = target_angle; // Ensure exact final position
         
-        setServoAngle(servo_id, intermediate_angle);
-        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        if (!writeServoAngle(servo_id, intermediate_angle)) {
+            return false;
+        }
+        
+        // Pace intermediate steps by travel time; only the last one waits for the shaper tail
+        if (i < steps) {
+            tickUntil(arm_clock().now() + model.travelTime(servo_id, previous, intermediate_angle));
+        } else {
+            waitForArrival(servo_id);
+        }
+        previous = intermediate_angle;
     }
     
     return true;
@@ -140,3 +517,11 @@ bool ServoControl::smoothMove(int servo_id, int target_angle, int steps) {
 bool ServoControl::isValidAngle(int angle) const {
     return angle >= MIN_SERVO_ANGLE && angle <= MAX_SERVO_ANGLE;
 }
+
+std::chrono::milliseconds ServoControl::getShaperDelay(int servo_id) {
+    if (servo_id < 0 || servo_id >= SERVO_COUNT) {
+        return std::chrono::milliseconds(0);
+    }
+    std::lock_guard<std::mutex> lock(shaper_mutex);
+    return std::chrono::duration_cast<std::chrono::milliseconds>(shapers[servo_id].shaperDuration());
+}
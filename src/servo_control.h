@@ -3,12 +3,55 @@
 
 #include <vector>
 #include <string>
+#include <mutex>
+#include "servo_model.h"
+#include "input_shaper.h"
+#include "current_budget.h"
+#include "clock.h"
 
 class ServoControl {
 private:
     std::vector<int> servo_pins;
     std::vector<int> current_angles;
     bool initialized;
+    ServoModel model;
+    std::mutex shaper_mutex;
+    InputShaper shapers[SERVO_COUNT];
+    int output_angles[SERVO_COUNT];   // angle currently driven on each pin
+    
+    // Idle power management (guarded by shaper_mutex)
+    bool hold_torque[SERVO_COUNT];    // stays energized when parked
+    bool energized[SERVO_COUNT];      // pulses are being sent
+    bool detached[SERVO_COUNT];       // pulses stopped by the idle policy, pose remembered
+    Clock::TimePoint power_start;
+    Clock::TimePoint power_mark[SERVO_COUNT];        // power time accounted up to here
+    Clock::Duration energized_time[SERVO_COUNT];
+    Clock::Duration detached_time[SERVO_COUNT];
+    
+    CurrentBudget budget;
+    
+    // Jog and stream starts held for the budget (guarded by shaper_mutex)
+    bool start_held[SERVO_COUNT];
+    Clock::TimePoint start_retry[SERVO_COUNT];       // ask the budget again from here
+    Clock::TimePoint start_limit[SERVO_COUNT];       // start regardless from here
+    
+    // Base/shoulder/elbow angles being driven, for the holding current model
+    void drivenPose(float pose[3]) const;
+    
+    // Whether a segment starting now draws the start-up surge
+    bool startsFromRest(int servo_id, Clock::TimePoint now) const;
+    
+    // Drive the PWM pin and feed the slew model; re-engages a detached servo
+    void writeOutput(int servo_id, int angle);
+    
+    // Add the time since the last mark to the servo's power totals
+    void accountPower(int servo_id, Clock::TimePoint now);
+    
+    // Stop pulses on parked joints that need no holding torque
+    void detachIdle(Clock::TimePoint now);
+    
+    // Sleep until the given time while advancing input shaping
+    void tickUntil(ServoModel::TimePoint when);
     
 public:
     ServoControl();
@@ -20,14 +63,75 @@ public:
     // Set individual servo angle (0-180 degrees)
     bool setServoAngle(int servo_id, int angle);
     
-    // Set multiple servo angles at once
+    // Write servo angle without waiting for the servo to move (for tick-driven control)
+    bool writeServoAngle(int servo_id, int angle);
+    
+    // Whether a new segment of this joint fits the supply current budget
+    // now; if not, retry is the earliest time worth asking again
+    bool admitMove(int servo_id, Clock::TimePoint& retry);
+    
+    // Budget gate for writers that issue a new angle every tick (jog,
+    // setpoint stream): false while a start from rest is held for other
+    // joints' surges to end, for at most SUPPLY_START_WAIT_MS. Leave the
+    // joint unwritten and ask again on the next tick.
+    bool admitStart(int servo_id);
+    
+    // Set multiple servo angles at once, staggering starts the supply cannot take together
     bool setServoAngles(const std::vector<int>& angles);
     
     // Get current servo angle
     int getServoAngle(int servo_id) const;
     
-    // Get all current angles
-    std::vector<int> getAllAngles() const;
+    // Get all current angles (no copy, valid for the lifetime of the object)
+    const std::vector<int>& getAllAngles() const;
+    
+    // Modeled (estimated) position of a servo while it is moving
+    float getEstimatedAngle(int servo_id) const { return model.estimatePosition(servo_id); }
+    
+    // Modeled time the servo reaches its last command, including pending shaped impulses
+    ServoModel::TimePoint arrivalTime(int servo_id);
+    
+    // Whether the servo has reached its last command according to the model
+    bool hasArrived(int servo_id) { return arm_clock().now() >= arrivalTime(servo_id); }
+    
+    // Whether any servo is still moving or has shaped impulses pending
+    bool isMoving();
+    
+    // Block until the modeled completion time of one / all servos
+    void waitForArrival(int servo_id);
+    void waitForArrival();
+    
+    // Block until arrival plus the residual vibration has died out
+    void waitForSettle(int servo_id);
+    void waitForSettle();
+    
+    // Advance input shaping and the idle power policy; call every control tick
+    void update();
+    
+    // Idle power: whether a servo is energized, the fraction of time since
+    // initialize() it was, and the estimated supply current (mA) and charge
+    // (mAh) saved by detaching parked joints
+    bool isEnergized(int servo_id);
+    float getDuty(int servo_id);
+    float getIdleSavingMa();
+    float getIdleSavedMah();
+    
+    // Supply current model fed by every servo write
+    CurrentBudget& getBudget() { return budget; }
+    
+    // Input shaping configuration (type applies to all joints)
+    bool configureShaper(int servo_id, float frequency_hz, float damping_ratio);
+    void setShaperType(ShaperType type);
+    ShaperType getShaperType();
+    
+    // Expected settling time after a move of this joint (shaper delay or residual decay)
+    std::chrono::milliseconds getSettleTime(int servo_id);
+    
+    // Delay added by input shaping alone
+    std::chrono::milliseconds getShaperDelay(int servo_id);
+    
+    // Slew model used for arrival estimates
+    ServoModel& getModel() { return model; }
     
     // Move to home position
     void moveToHome();
@@ -0,0 +1,126 @@
+#include "servo_model.h"
+#include "clock.h"
+#include <algorithm>
+#include <cmath>
+
+ServoModel::ServoModel() {
+    const float speeds[SERVO_COUNT] = SERVO_SLEW_DPS;
+    const float deadbands[SERVO_COUNT] = SERVO_DEADBAND_DEG;
+    TimePoint now = arm_clock().now();
+    
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        joints[i].start = 90.0f;
+        joints[i].target = 90.0f;
+        joints[i].speed = speeds[i];
+        joints[i].deadband = deadbands[i];
+        joints[i].start_time = now;
+        joints[i].arrival_time = now;
+    }
+}
+
+float ServoModel::positionAt(const Joint& joint, TimePoint when) {
+    if (when >= joint.arrival_time) {
+        return joint.target;
+    }
+    float elapsed = std::chrono::duration<float>(when - joint.start_time).count();
+    float travelled = std::max(0.0f, elapsed) * joint.speed;
+    return joint.target > joint.start ? joint.start + travelled : joint.start - travelled;
+}
+
+bool ServoModel::setCalibration(int servo_id, float speed_dps, float deadband_deg) {
+    if (servo_id < 0 || servo_id >= SERVO_COUNT || speed_dps <= 0.0f || deadband_deg < 0.0f) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    joints[servo_id].speed = speed_dps;
+    joints[servo_id].deadband = deadband_deg;
+    return true;
+}
+
+float ServoModel::getSpeed(int servo_id) const {
+    if (servo_id < 0 || servo_id >= SERVO_COUNT) {
+        return 0.0f;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    return joints[servo_id].speed;
+}
+
+void ServoModel::command(int servo_id, float target) {
+    if (servo_id < 0 || servo_id >= SERVO_COUNT) {
+        return;
+    }
+    
+    std::lock_guard<std::mutex> lock(mutex);
+    Joint& joint = joints[servo_id];
+    TimePoint now = arm_clock().now();
+    float position = positionAt(joint, now);
+    float distance = std::fabs(target - position);
+    
+    joint.start_time = now;
+    if (distance <= joint.deadband && now >= joint.arrival_time) {
+        // Too small to overcome the servo deadband from rest
+        joint.start = position;
+        joint.target = position;
+        joint.arrival_time = now;
+        return;
+    }
+    
+    joint.start = position;
+    joint.target = target;
+    joint.arrival_time = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<float>(distance / joint.speed));
+}
+
+void ServoModel::reset(int servo_id, float angle) {
+    if (servo_id < 0 || servo_id >= SERVO_COUNT) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    Joint& joint = joints[servo_id];
+    joint.start = angle;
+    joint.target = angle;
+    joint.start_time = arm_clock().now();
+    joint.arrival_time = joint.start_time;
+}
+
+float ServoModel::estimatePosition(int servo_id) const {
+    if (servo_id < 0 || servo_id >= SERVO_COUNT) {
+        return -1.0f;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    return positionAt(joints[servo_id], arm_clock().now());
+}
+
+ServoModel::TimePoint ServoModel::arrivalTime(int servo_id) const {
+    if (servo_id < 0 || servo_id >= SERVO_COUNT) {
+        return arm_clock().now();
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    return joints[servo_id].arrival_time;
+}
+
+ServoModel::TimePoint ServoModel::arrivalTime() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    TimePoint latest = joints[0].arrival_time;
+    for (int i = 1; i < SERVO_COUNT; i++) {
+        latest = std::max(latest, joints[i].arrival_time);
+    }
+    return latest;
+}
+
+bool ServoModel::hasArrived(int servo_id) const {
+    return arm_clock().now() >= arrivalTime(servo_id);
+}
+
+std::chrono::milliseconds ServoModel::travelTime(int servo_id, float from, float to) const {
+    if (servo_id < 0 || servo_id >= SERVO_COUNT) {
+        return std::chrono::milliseconds(0);
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    const Joint& joint = joints[servo_id];
+    float distance = std::fabs(to - from);
+    if (distance <= joint.deadband) {
+        return std::chrono::milliseconds(0);
+    }
+    return std::chrono::milliseconds(static_cast<int>(std::ceil(distance / joint.speed * 1000.0f)));
+}
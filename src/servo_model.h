@@ -0,0 +1,60 @@
+#ifndef SERVO_MODEL_H
+#define SERVO_MODEL_H
+
+#include <mutex>
+#include <chrono>
+#include "../include/config.h"
+
+// Open-loop position estimate for hobby servos without feedback.
+// Each joint slews towards its last command at a calibrated speed; commands
+// smaller than the deadband are assumed not to move the horn. The model
+// gives the estimated angle at any instant and the modeled arrival time,
+// so callers can wait exactly as long as the move needs.
+class ServoModel {
+public:
+    typedef std::chrono::steady_clock::time_point TimePoint;
+    
+private:
+    struct Joint {
+        float start;          // estimated angle when the command was issued
+        float target;
+        float speed;          // deg/s
+        float deadband;       // deg
+        TimePoint start_time;
+        TimePoint arrival_time;
+    };
+    
+    mutable std::mutex mutex;
+    Joint joints[SERVO_COUNT];
+    
+    static float positionAt(const Joint& joint, TimePoint when);
+    
+public:
+    ServoModel();
+    
+    // Per-joint calibration
+    bool setCalibration(int servo_id, float speed_dps, float deadband_deg);
+    float getSpeed(int servo_id) const;
+    
+    // Record a new command issued now
+    void command(int servo_id, float target);
+    
+    // Reset a joint to a known angle (e.g. at power up or after re-engaging)
+    void reset(int servo_id, float angle);
+    
+    // Estimated current angle (-1 for invalid id)
+    float estimatePosition(int servo_id) const;
+    
+    // Modeled completion time of the last command
+    TimePoint arrivalTime(int servo_id) const;
+    
+    // Latest arrival over all joints
+    TimePoint arrivalTime() const;
+    
+    bool hasArrived(int servo_id) const;
+    
+    // Time the joint would need to travel between two angles
+    std::chrono::milliseconds travelTime(int servo_id, float from, float to) const;
+};
+
+#endif // SERVO_MODEL_H
@@ -0,0 +1,179 @@
+#include "setpoint_stream.h"
+#include "servo_control.h"
+#include "clock.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace {
+    int64_t local_time_ms() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            arm_clock().now().time_since_epoch()).count();
+    }
+}
+
+SetpointStream::SetpointStream() :
+    head(0),
+    count(0),
+    clock_offset_ms(0),
+    offset_since_ms(0),
+    have_offset(false),
+    delay_ms(STREAM_DEFAULT_DELAY_MS),
+    active(false) {
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        written[i] = -1;
+    }
+}
+
+const SetpointStream::Setpoint& SetpointStream::at(int index) const {
+    return buffer[(head + index) % STREAM_BUFFER_SIZE];
+}
+
+void SetpointStream::dropOldest() {
+    head = (head + 1) % STREAM_BUFFER_SIZE;
+    count--;
+}
+
+float SetpointStream::hermite(float p0, float p1, float m0, float m1, float t, float h) {
+    float t2 = t * t;
+    float t3 = t2 * t;
+    return (2 * t3 - 3 * t2 + 1) * p0 + (t3 - 2 * t2 + t) * h * m0 +
+           (-2 * t3 + 3 * t2) * p1 + (t3 - t2) * h * m1;
+}
+
+bool SetpointStream::push(int64_t sender_time_ms, const float angles[SERVO_COUNT]) {
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    if (count > 0 && sender_time_ms <= at(count - 1).time_ms) {
+        return false; // Duplicate or out of order
+    }
+    
+    // Track the smallest local-sender offset, i.e. the least delayed packet.
+    // Creep upwards by 1 ms every STREAM_OFFSET_CREEP_S so sender clock drift
+    // does not stall playback, independent of the packet rate.
+    int64_t now = local_time_ms();
+    int64_t offset = now - sender_time_ms;
+    if (have_offset) {
+        int64_t creep = (now - offset_since_ms) / (STREAM_OFFSET_CREEP_S * 1000);
+        clock_offset_ms += creep;
+        offset_since_ms += creep * STREAM_OFFSET_CREEP_S * 1000;
+    }
+    if (!have_offset || offset < clock_offset_ms) {
+        clock_offset_ms = offset;
+        offset_since_ms = now;
+        have_offset = true;
+    }
+    
+    if (count == STREAM_BUFFER_SIZE) {
+        dropOldest();
+    }
+    
+    Setpoint& slot = buffer[(head + count) % STREAM_BUFFER_SIZE];
+    slot.time_ms = sender_time_ms;
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        slot.angles[i] = std::max(static_cast<float>(MIN_SERVO_ANGLE),
+                                  std::min(static_cast<float>(MAX_SERVO_ANGLE), angles[i]));
+    }
+    count++;
+    active = true;
+    return true;
+}
+
+void SetpointStream::setDelay(int ms) {
+    std::lock_guard<std::mutex> lock(mutex);
+    delay_ms = std::max(0, std::min(STREAM_MAX_DELAY_MS, ms));
+}
+
+int SetpointStream::getDelay() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return delay_ms;
+}
+
+void SetpointStream::reset() {
+    std::lock_guard<std::mutex> lock(mutex);
+    head = 0;
+    count = 0;
+    have_offset = false;
+    active = false;
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        written[i] = -1;
+    }
+}
+
+bool SetpointStream::update(ServoControl& servo) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!active || count == 0) {
+        return false;
+    }
+    
+    int64_t playback_ms = local_time_ms() - clock_offset_ms - delay_ms;
+    
+    // Keep one sample before the current segment for the incoming tangent
+    while (count >= 3 && at(2).time_ms <= playback_ms) {
+        dropOldest();
+    }
+    
+    if (playback_ms < at(0).time_ms) {
+        return true; // Still filling the jitter buffer
+    }
+    
+    const Setpoint& newest = at(count - 1);
+    if (playback_ms >= newest.time_ms) {
+        // Buffer ran dry - hold the last setpoint, end the stream if it stays dry
+        if (playback_ms - newest.time_ms > STREAM_TIMEOUT_MS) {
+            active = false;
+            head = 0;
+            count = 0;
+            have_offset = false;
+        }
+        for (int i = 0; i < SERVO_COUNT; i++) {
+            int angle = static_cast<int>(std::lround(newest.angles[i]));
+            if (angle != written[i] && servo.admitStart(i) && servo.writeServoAngle(i, angle)) {
+                written[i] = angle;
+            }
+        }
+        return active;
+    }
+    
+    // Locate the segment [k, k+1] containing the playback time
+    int k = 0;
+    while (k + 1 < count && at(k + 1).time_ms <= playback_ms) {
+        k++;
+    }
+    
+    const Setpoint& p1 = at(k);
+    const Setpoint& p2 = at(k + 1);
+    const Setpoint& p0 = k > 0 ? at(k - 1) : p1;
+    const Setpoint& p3 = k + 2 < count ? at(k + 2) : p2;
+    
+    float h = static_cast<float>(p2.time_ms - p1.time_ms);
+    float t = (playback_ms - p1.time_ms) / h;
+    float span_in = static_cast<float>(p2.time_ms - p0.time_ms);
+    float span_out = static_cast<float>(p3.time_ms - p1.time_ms);
+    
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        // Catmull-Rom style tangents for non-uniform sample spacing
+        float m1 = (p2.angles[i] - p0.angles[i]) / span_in;
+        float m2 = (p3.angles[i] - p1.angles[i]) / span_out;
+        float value = hermite(p1.angles[i], p2.angles[i], m1, m2, t, h);
+        value = std::max(static_cast<float>(MIN_SERVO_ANGLE),
+                         std::min(static_cast<float>(MAX_SERVO_ANGLE), value));
+        
+        int angle = static_cast<int>(std::lround(value));
+        if (angle != written[i] && servo.admitStart(i) && servo.writeServoAngle(i, angle)) {
+            written[i] = angle;
+        }
+    }
+    
+    return true;
+}
+
+bool SetpointStream::isActive() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return active;
+}
+
+int SetpointStream::bufferedCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return count;
+}
@@ -0,0 +1,57 @@
+#ifndef SETPOINT_STREAM_H
+#define SETPOINT_STREAM_H
+
+#include <mutex>
+#include <cstdint>
+#include "../include/config.h"
+
+class ServoControl;
+
+// Reconstructs a smooth trajectory from sparse, jittery remote setpoints.
+// Setpoints carry the sender's timestamp; they are held in a short jitter
+// buffer and played back a fixed delay behind the sender clock, with cubic
+// Hermite interpolation between them on every control tick.
+class SetpointStream {
+private:
+    struct Setpoint {
+        int64_t time_ms;              // sender clock
+        float angles[SERVO_COUNT];
+    };
+    
+    mutable std::mutex mutex;
+    Setpoint buffer[STREAM_BUFFER_SIZE];  // ring, ordered by time_ms
+    int head;
+    int count;
+    int64_t clock_offset_ms;          // local - sender, smallest seen
+    int64_t offset_since_ms;          // local time the offset was last set or crept
+    bool have_offset;
+    int delay_ms;
+    int written[SERVO_COUNT];
+    bool active;
+    
+    const Setpoint& at(int index) const;
+    void dropOldest();
+    static float hermite(float p0, float p1, float m0, float m1, float t, float h);
+    
+public:
+    SetpointStream();
+    
+    // Queue a timestamped setpoint. Late or out-of-order samples are dropped.
+    bool push(int64_t sender_time_ms, const float angles[SERVO_COUNT]);
+    
+    // Playback latency behind the sender clock
+    void setDelay(int ms);
+    int getDelay() const;
+    
+    // Discard the buffer and clock sync
+    void reset();
+    
+    // Interpolate at the current playback time and write changed angles.
+    // Returns true while the stream is live.
+    bool update(ServoControl& servo);
+    
+    bool isActive() const;
+    int bufferedCount() const;
+};
+
+#endif // SETPOINT_STREAM_H
@@ -0,0 +1,1106 @@
+#include "telemetry_store.h"
+#include "arrow_ipc.h"
+#include "downsample.h"
+#include "flight_recorder.h"
+#include "metrics.h"
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace {
+    const char SEGMENT_MAGIC[8] = {'S', 'A', 'T', 'E', 'L', 'E', 'M', 'S'};
+    const uint32_t SEGMENT_VERSION = 1;
+    const size_t COLUMN_ALIGNMENT = 64;
+    const int RAW_COLUMNS = SERVO_COUNT + 4;                        // time, joints, distance, mode, event
+    const int ROLLUP_COLUMNS = 3 + 3 * TELEMETRY_CHANNELS + 2;      // time, samples, readings, stats, mode, events
+    const int MAX_COLUMNS = ROLLUP_COLUMNS;
+    const size_t READ_CHUNK = 256 * 1024;                          // bytes per pread of a segment
+    
+    const char* const TIER_PREFIX[TELEMETRY_TIERS] = {"raw", "sec", "min"};
+    const int64_t BUCKET_MS[TELEMETRY_TIERS] = {0, 1000, 60000};
+    const int64_t WINDOW_MS[TELEMETRY_TIERS] = {0, 3600000, 86400000};   // span of one rollup file
+    
+    const char* const JOINT_NAMES[SERVO_COUNT] = {"base", "shoulder", "elbow", "wrist", "gripper"};
+    const char* const EVENT_NAMES[TELEMETRY_EVENT_COUNT] = {
+        "grab", "grab_failed", "stop", "home", "mode", "calibration"
+    };
+    
+    MetricCounter& row_count = metrics().counter("smartarm_telemetry_rows_total",
+                                                 "Rows recorded in the telemetry store");
+    MetricCounter& dropped_count = metrics().counter("smartarm_telemetry_dropped_total",
+                                                     "Telemetry rows lost to a slow or failed segment write");
+    MetricCounter& compacted_count = metrics().counter("smartarm_telemetry_compacted_total",
+                                                       "Telemetry segments rolled up into a coarser tier");
+    MetricCounter& pruned_count = metrics().counter("smartarm_telemetry_pruned_total",
+                                                    "Telemetry segments deleted for age or disk space");
+    
+    int column_count(int tier) {
+        return tier == TELEMETRY_TIER_RAW ? RAW_COLUMNS : ROLLUP_COLUMNS;
+    }
+    
+    size_t column_size(int tier, int column) {
+        if (column == 0) {
+            return sizeof(int64_t);
+        }
+        if (tier == TELEMETRY_TIER_RAW) {
+            return column <= SERVO_COUNT + 1 ? sizeof(float) : sizeof(int8_t);
+        }
+        return column <= 2 ? sizeof(int32_t) : column < ROLLUP_COLUMNS - 2 ? sizeof(float) : sizeof(int8_t);
+    }
+    
+    size_t align_up(size_t value) {
+        return (value + COLUMN_ALIGNMENT - 1) / COLUMN_ALIGNMENT * COLUMN_ALIGNMENT;
+    }
+    
+    // Column offsets in a segment file of the given tier and row count;
+    // returns the file size
+    size_t segment_layout(int tier, size_t rows, size_t offsets[MAX_COLUMNS]) {
+        size_t position = align_up(sizeof(TelemetrySegmentHeader));
+        for (int column = 0; column < column_count(tier); column++) {
+            offsets[column] = position;
+            position = align_up(position + rows * column_size(tier, column));
+        }
+        return position;
+    }
+    
+    // Size of the largest segment file the store writes: a full raw
+    // segment or a rollup with every bucket of its window
+    size_t max_segment_size() {
+        size_t offsets[MAX_COLUMNS];
+        size_t largest = segment_layout(TELEMETRY_TIER_RAW, TELEMETRY_SEGMENT_ROWS, offsets);
+        for (int tier = TELEMETRY_TIER_SECOND; tier < TELEMETRY_TIERS; tier++) {
+            largest = std::max(largest, segment_layout(tier, WINDOW_MS[tier] / BUCKET_MS[tier], offsets));
+        }
+        return largest;
+    }
+    
+    // Column pointers in the order of the file layout
+    void column_pointers(const TelemetryColumns& columns, const void* pointers[MAX_COLUMNS]) {
+        pointers[0] = columns.time;
+        for (int i = 0; i < SERVO_COUNT; i++) pointers[1 + i] = columns.joints[i];
+        pointers[SERVO_COUNT + 1] = columns.distance;
+        pointers[SERVO_COUNT + 2] = columns.mode;
+        pointers[SERVO_COUNT + 3] = columns.event;
+    }
+    
+    void column_pointers(const TelemetryRollupColumns& columns, const void* pointers[MAX_COLUMNS]) {
+        pointers[0] = columns.time;
+        pointers[1] = columns.samples;
+        pointers[2] = columns.readings;
+        for (int c = 0; c < TELEMETRY_CHANNELS; c++) {
+            pointers[3 + c] = columns.min[c];
+            pointers[3 + TELEMETRY_CHANNELS + c] = columns.max[c];
+            pointers[3 + 2 * TELEMETRY_CHANNELS + c] = columns.mean[c];
+        }
+        pointers[ROLLUP_COLUMNS - 2] = columns.mode;
+        pointers[ROLLUP_COLUMNS - 1] = columns.events;
+    }
+    
+    std::string segment_path(const std::string& directory, int tier, int64_t start_ms) {
+        return directory + "/" + TIER_PREFIX[tier] + "-" + std::to_string(start_ms) + ".seg";
+    }
+    
+    // Write a segment file under a temporary name and rename it, so
+    // readers never see a partial file
+    bool write_segment_file(const std::string& path, int tier, size_t rows, int64_t start_ms, int64_t end_ms,
+                            const void* const pointers[MAX_COLUMNS]) {
+        TelemetrySegmentHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC));
+        header.version = SEGMENT_VERSION;
+        header.rows = static_cast<uint32_t>(rows);
+        header.start_ms = start_ms;
+        header.end_ms = end_ms;
+        header.tier = static_cast<uint32_t>(tier);
+        
+        std::string temporary = path + ".tmp";
+        FILE* file = std::fopen(temporary.c_str(), "wb");
+        if (!file) {
+            std::cerr << "Failed to create " << temporary << std::endl;
+            return false;
+        }
+        
+        static const uint8_t zeros[COLUMN_ALIGNMENT] = {};
+        size_t offsets[MAX_COLUMNS];
+        size_t file_size = segment_layout(tier, rows, offsets);
+        bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+        size_t position = sizeof(header);
+        for (int column = 0; column < column_count(tier) && ok; column++) {
+            ok = std::fwrite(zeros, 1, offsets[column] - position, file) == offsets[column] - position;
+            size_t bytes = rows * column_size(tier, column);
+            ok = ok && std::fwrite(pointers[column], 1, bytes, file) == bytes;
+            position = offsets[column] + bytes;
+        }
+        ok = ok && std::fwrite(zeros, 1, file_size - position, file) == file_size - position;
+        ok = (std::fclose(file) == 0) && ok;
+        if (!ok || std::rename(temporary.c_str(), path.c_str()) != 0) {
+            std::cerr << "Failed to write telemetry segment " << path << std::endl;
+            std::remove(temporary.c_str());
+            return false;
+        }
+        return true;
+    }
+    
+    // A segment file read with pread into a buffer the caller reuses.
+    // Segments are never mapped: under mlockall(MCL_FUTURE) every mapping
+    // would be read in full and pinned for as long as it stays mapped.
+    class SegmentReader {
+    private:
+        const uint8_t* data;
+        size_t offsets[MAX_COLUMNS];
+        
+        template <typename T>
+        const T* column(int index) const {
+            return reinterpret_cast<const T*>(data + offsets[index]);
+        }
+        
+    public:
+        SegmentReader() : data(nullptr) {}
+        
+        // Read a segment of the given tier into buffer and check its layout.
+        // Fails for files larger than the buffer.
+        bool open(const std::string& path, int tier, std::vector<uint8_t>& buffer) {
+            data = nullptr;
+            int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) {
+                return false;
+            }
+            struct stat info;
+            bool ok = fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) >= sizeof(TelemetrySegmentHeader) &&
+                      static_cast<size_t>(info.st_size) <= buffer.size();
+            size_t size = ok ? static_cast<size_t>(info.st_size) : 0;
+            size_t done = 0;
+            while (ok && done < size) {
+                ssize_t count = pread(fd, buffer.data() + done, std::min(size - done, READ_CHUNK), done);
+                if (count < 0 && errno == EINTR) continue;
+                ok = count > 0;
+                done += ok ? static_cast<size_t>(count) : 0;
+            }
+            ::close(fd);
+            if (!ok) {
+                return false;
+            }
+            
+            data = buffer.data();
+            const TelemetrySegmentHeader* header = reinterpret_cast<const TelemetrySegmentHeader*>(data);
+            return std::memcmp(header->magic, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC)) == 0 &&
+                   header->version == SEGMENT_VERSION && header->tier == static_cast<uint32_t>(tier) &&
+                   segment_layout(tier, header->rows, offsets) <= size;
+        }
+        
+        size_t rows() const { return reinterpret_cast<const TelemetrySegmentHeader*>(data)->rows; }
+        
+        TelemetryColumns raw() const {
+            TelemetryColumns columns;
+            columns.rows = rows();
+            columns.time = column<int64_t>(0);
+            for (int i = 0; i < SERVO_COUNT; i++) columns.joints[i] = column<float>(1 + i);
+            columns.distance = column<float>(SERVO_COUNT + 1);
+            columns.mode = column<int8_t>(SERVO_COUNT + 2);
+            columns.event = column<int8_t>(SERVO_COUNT + 3);
+            return columns;
+        }
+        
+        TelemetryRollupColumns rollup() const {
+            TelemetryRollupColumns columns;
+            columns.rows = rows();
+            columns.time = column<int64_t>(0);
+            columns.samples = column<int32_t>(1);
+            columns.readings = column<int32_t>(2);
+            for (int c = 0; c < TELEMETRY_CHANNELS; c++) {
+                columns.min[c] = column<float>(3 + c);
+                columns.max[c] = column<float>(3 + TELEMETRY_CHANNELS + c);
+                columns.mean[c] = column<float>(3 + 2 * TELEMETRY_CHANNELS + c);
+            }
+            columns.mode = column<int8_t>(ROLLUP_COLUMNS - 2);
+            columns.events = column<uint8_t>(ROLLUP_COLUMNS - 1);
+            return columns;
+        }
+    };
+    
+    // Rows of a rollup segment being built
+    struct RollupBuffer {
+        std::vector<int64_t> time;
+        std::vector<int32_t> samples;
+        std::vector<int32_t> readings;
+        std::vector<float> min[TELEMETRY_CHANNELS];
+        std::vector<float> max[TELEMETRY_CHANNELS];
+        std::vector<float> mean[TELEMETRY_CHANNELS];
+        std::vector<int8_t> mode;
+        std::vector<uint8_t> events;
+        
+        void clear() {
+            time.clear();
+            samples.clear();
+            readings.clear();
+            for (int c = 0; c < TELEMETRY_CHANNELS; c++) {
+                min[c].clear();
+                max[c].clear();
+                mean[c].clear();
+            }
+            mode.clear();
+            events.clear();
+        }
+        
+        TelemetryRollupColumns columns() const {
+            TelemetryRollupColumns result;
+            result.rows = time.size();
+            result.time = time.data();
+            result.samples = samples.data();
+            result.readings = readings.data();
+            for (int c = 0; c < TELEMETRY_CHANNELS; c++) {
+                result.min[c] = min[c].data();
+                result.max[c] = max[c].data();
+                result.mean[c] = mean[c].data();
+            }
+            result.mode = mode.data();
+            result.events = events.data();
+            return result;
+        }
+    };
+    
+    // Folds time-ordered raw rows or finer rollups into fixed-size buckets
+    class RollupBuilder {
+    private:
+        static const int DISTANCE = TELEMETRY_CHANNELS - 1;
+        
+        RollupBuffer& out;
+        int64_t bucket_ms;
+        int64_t bucket;
+        int32_t samples;
+        int32_t readings;
+        float low[TELEMETRY_CHANNELS];
+        float high[TELEMETRY_CHANNELS];
+        double sum[TELEMETRY_CHANNELS];
+        int8_t mode;
+        uint8_t events;
+        
+        void enter(int64_t time_ms) {
+            int64_t start = time_ms - time_ms % bucket_ms;
+            if (samples > 0 && start == bucket) {
+                return;
+            }
+            flush();
+            bucket = start;
+            for (int c = 0; c < TELEMETRY_CHANNELS; c++) {
+                low[c] = INFINITY;
+                high[c] = -INFINITY;
+                sum[c] = 0.0;
+            }
+            events = 0;
+        }
+        
+        void add(int channel, float minimum, float maximum, double total) {
+            low[channel] = std::min(low[channel], minimum);
+            high[channel] = std::max(high[channel], maximum);
+            sum[channel] += total;
+        }
+        
+    public:
+        RollupBuilder(RollupBuffer& buffer, int64_t bucket_size) :
+            out(buffer), bucket_ms(bucket_size), bucket(0), samples(0), readings(0), mode(0), events(0) {}
+        
+        void addRaw(const TelemetryColumns& columns, size_t row) {
+            enter(columns.time[row]);
+            samples++;
+            for (int i = 0; i < SERVO_COUNT; i++) {
+                float value = columns.joints[i][row];
+                add(i, value, value, value);
+            }
+            float distance = columns.distance[row];
+            if (distance >= 0.0f) {
+                readings++;
+                add(DISTANCE, distance, distance, distance);
+            }
+            mode = columns.mode[row];
+            if (columns.event[row] >= 0) {
+                events |= static_cast<uint8_t>(1 << columns.event[row]);
+            }
+        }
+        
+        void addRollup(const TelemetryRollupColumns& columns, size_t row) {
+            enter(columns.time[row]);
+            samples += columns.samples[row];
+            for (int i = 0; i < SERVO_COUNT; i++) {
+                add(i, columns.min[i][row], columns.max[i][row],
+                    static_cast<double>(columns.mean[i][row]) * columns.samples[row]);
+            }
+            if (columns.readings[row] > 0) {
+                readings += columns.readings[row];
+                add(DISTANCE, columns.min[DISTANCE][row], columns.max[DISTANCE][row],
+                    static_cast<double>(columns.mean[DISTANCE][row]) * columns.readings[row]);
+            }
+            mode = columns.mode[row];
+            events |= columns.events[row];
+        }
+        
+        // Write out the open bucket
+        void flush() {
+            if (samples == 0) {
+                return;
+            }
+            out.time.push_back(bucket);
+            out.samples.push_back(samples);
+            out.readings.push_back(readings);
+            for (int c = 0; c < TELEMETRY_CHANNELS; c++) {
+                int32_t count = c == DISTANCE ? readings : samples;
+                out.min[c].push_back(count > 0 ? low[c] : -1.0f);
+                out.max[c].push_back(count > 0 ? high[c] : -1.0f);
+                out.mean[c].push_back(count > 0 ? static_cast<float>(sum[c] / count) : -1.0f);
+            }
+            out.mode.push_back(mode);
+            out.events.push_back(events);
+            samples = 0;
+            readings = 0;
+        }
+    };
+    
+    // Idle I/O class for the calling thread, so rollups never delay the
+    // sampler's segment writes (Linux ioprio_set has no libc wrapper)
+    void set_idle_io_priority() {
+#ifdef SYS_ioprio_set
+        const int IOPRIO_WHO_PROCESS = 1;   // with id 0: the calling thread
+        const int IOPRIO_CLASS_IDLE = 3;
+        const int IOPRIO_CLASS_SHIFT = 13;
+        if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT) != 0) {
+            std::cerr << "Telemetry retention keeps normal I/O priority: " << std::strerror(errno) << std::endl;
+        }
+#endif
+    }
+    
+    std::vector<ArrowField> raw_schema() {
+        std::vector<ArrowField> fields;
+        fields.push_back({"time", ARROW_TIMESTAMP_MS, false, {}});
+        for (int i = 0; i < SERVO_COUNT; i++) {
+            fields.push_back({JOINT_NAMES[i], ARROW_FLOAT32, false, {}});
+        }
+        fields.push_back({"distance_cm", ARROW_FLOAT32, true, {}});
+        fields.push_back({"mode", ARROW_DICTIONARY, false, {"manual", "auto"}});
+        fields.push_back({"event", ARROW_DICTIONARY, true,
+                          std::vector<std::string>(EVENT_NAMES, EVENT_NAMES + TELEMETRY_EVENT_COUNT)});
+        return fields;
+    }
+    
+    // Rollup columns, channel by channel: base_min, base_max, base_mean, ...
+    std::vector<ArrowField> rollup_schema() {
+        static const char* const STATS[3] = {"_min", "_max", "_mean"};
+        std::vector<ArrowField> fields;
+        fields.push_back({"time", ARROW_TIMESTAMP_MS, false, {}});
+        fields.push_back({"samples", ARROW_INT32, false, {}});
+        fields.push_back({"readings", ARROW_INT32, false, {}});
+        for (int c = 0; c < TELEMETRY_CHANNELS; c++) {
+            std::string name = telemetry_channel_name(c);
+            for (const char* stat : STATS) {
+                fields.push_back({name + stat, ARROW_FLOAT32, c == SERVO_COUNT, {}});
+            }
+        }
+        fields.push_back({"mode", ARROW_DICTIONARY, false, {"manual", "auto"}});
+        fields.push_back({"events", ARROW_UINT8, false, {}});
+        return fields;
+    }
+    
+    // Validity bitmap of the values that pass; returns the null count
+    template <typename T, typename Valid>
+    int64_t build_validity(const T* values, size_t count, std::vector<uint8_t>& bitmap, Valid valid) {
+        bitmap.assign((count + 7) / 8, 0);
+        int64_t nulls = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (valid(values[i])) {
+                bitmap[i / 8] |= static_cast<uint8_t>(1 << (i % 8));
+            } else {
+                nulls++;
+            }
+        }
+        return nulls;
+    }
+}
+
+const char* telemetry_event_name(int event) {
+    return event >= 0 && event < TELEMETRY_EVENT_COUNT ? EVENT_NAMES[event] : "";
+}
+
+const char* telemetry_channel_name(int channel) {
+    if (channel == SERVO_COUNT) {
+        return "distance_cm";
+    }
+    return channel >= 0 && channel < SERVO_COUNT ? JOINT_NAMES[channel] : "";
+}
+
+void TelemetryStore::SegmentBuffer::allocate(size_t capacity) {
+    time.resize(capacity);
+    for (int i = 0; i < SERVO_COUNT; i++) joints[i].resize(capacity);
+    distance.resize(capacity);
+    mode.resize(capacity);
+    event.resize(capacity);
+    rows = 0;
+}
+
+void TelemetryStore::SegmentBuffer::append(const TelemetrySample& sample) {
+    time[rows] = sample.time_ms;
+    for (int i = 0; i < SERVO_COUNT; i++) joints[i][rows] = sample.joints[i];
+    distance[rows] = sample.distance_cm;
+    mode[rows] = sample.mode;
+    event[rows] = sample.event;
+    rows++;
+}
+
+TelemetryColumns TelemetryStore::SegmentBuffer::columns() const {
+    TelemetryColumns result;
+    result.rows = rows;
+    result.time = time.data();
+    for (int i = 0; i < SERVO_COUNT; i++) result.joints[i] = joints[i].data();
+    result.distance = distance.data();
+    result.mode = mode.data();
+    result.event = event.data();
+    return result;
+}
+
+TelemetryStore::TelemetryStore(const std::string& dir) :
+    directory(dir),
+    active(&buffers[0]),
+    sealed(nullptr),
+    dropped(0),
+    epoch_ms(0),
+    readers(0),
+    running(false) {
+    for (int tier = 0; tier < TELEMETRY_TIERS; tier++) {
+        compacted_ms[tier] = 0;
+    }
+    retention.raw_ms = TELEMETRY_RAW_HOURS * 3600000LL;
+    retention.second_ms = TELEMETRY_SECOND_DAYS * 86400000LL;
+    retention.minute_ms = TELEMETRY_MINUTE_DAYS * 86400000LL;
+    retention.max_bytes = TELEMETRY_MAX_MB * 1048576LL;
+    last.time_ms = 0;
+    for (int i = 0; i < SERVO_COUNT; i++) last.joints[i] = 0.0f;
+    last.distance_cm = -1.0f;
+    last.mode = 0;
+    last.event = -1;
+}
+
+TelemetryStore::~TelemetryStore() {
+    stop();
+}
+
+bool TelemetryStore::initialize() {
+    if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+        std::cerr << "Failed to create telemetry directory " << directory << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    
+    // Read and copy buffers for exports, queries and rollups, allocated
+    // once so reading history does not grow the (locked) heap
+    {
+        std::lock_guard<std::mutex> reading(read_mutex);
+        recent.allocate(2 * TELEMETRY_SEGMENT_ROWS);
+        read_buffer.resize(max_segment_size());
+    }
+    rollup_buffer.resize(max_segment_size());
+    
+    std::lock_guard<std::mutex> lock(mutex);
+    for (SegmentBuffer& buffer : buffers) {
+        buffer.allocate(TELEMETRY_SEGMENT_ROWS);
+    }
+    active = &buffers[0];
+    sealed = nullptr;
+    epoch_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    clock_epoch = arm_clock().now();
+    indexSegments();
+    return true;
+}
+
+void TelemetryStore::indexSegments() {
+    for (int tier = 0; tier < TELEMETRY_TIERS; tier++) {
+        segments[tier].clear();
+        compacted_ms[tier] = 0;
+    }
+    DIR* dir = opendir(directory.c_str());
+    if (!dir) {
+        return;
+    }
+    while (struct dirent* entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        std::string path = directory + "/" + name;
+        if (name.size() > 8 && name.compare(name.size() - 8, 8, ".seg.tmp") == 0) {
+            std::remove(path.c_str()); // Interrupted write
+            continue;
+        }
+        if (name.size() < 4 || name.compare(name.size() - 4, 4, ".seg") != 0) continue;
+        
+        FILE* file = std::fopen(path.c_str(), "rb");
+        if (!file) continue;
+        TelemetrySegmentHeader header;
+        bool ok = std::fread(&header, sizeof(header), 1, file) == 1 &&
+                  std::memcmp(header.magic, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC)) == 0 &&
+                  header.version == SEGMENT_VERSION && header.tier < TELEMETRY_TIERS;
+        std::fclose(file);
+        if (ok) {
+            size_t offsets[MAX_COLUMNS];
+            int64_t bytes = static_cast<int64_t>(segment_layout(header.tier, header.rows, offsets));
+            segments[header.tier].push_back({path, header.start_ms, header.end_ms, header.rows, bytes});
+        } else {
+            std::cerr << "Skipping unreadable telemetry segment " << path << std::endl;
+        }
+    }
+    closedir(dir);
+    for (int tier = 0; tier < TELEMETRY_TIERS; tier++) {
+        std::sort(segments[tier].begin(), segments[tier].end(),
+                  [](const SegmentInfo& a, const SegmentInfo& b) { return a.start_ms < b.start_ms; });
+        // Rollup files start on their window, and windows are written in order
+        if (tier != TELEMETRY_TIER_RAW && !segments[tier].empty()) {
+            compacted_ms[tier] = segments[tier].back().start_ms + WINDOW_MS[tier];
+        }
+    }
+}
+
+int64_t TelemetryStore::nowMs() {
+    return epoch_ms + std::chrono::duration_cast<std::chrono::milliseconds>(arm_clock().now() - clock_epoch).count();
+}
+
+void TelemetryStore::append(TelemetrySample& sample) {
+    size_t capacity = active->time.size();
+    if (capacity == 0) {
+        return; // Not initialized
+    }
+    if (active->rows == capacity) {
+        // The previous segment is still being written
+        if (sealed) {
+            dropped++;
+            dropped_count.inc();
+            return;
+        }
+        sealed = active;
+        active = (active == &buffers[0]) ? &buffers[1] : &buffers[0];
+        active->rows = 0;
+    }
+    sample.time_ms = nowMs();
+    active->append(sample);
+    row_count.inc();
+    
+    // Seal right away so the sampler writes it on its next turn
+    if (active->rows == capacity && !sealed) {
+        sealed = active;
+        active = (active == &buffers[0]) ? &buffers[1] : &buffers[0];
+        active->rows = 0;
+    }
+}
+
+void TelemetryStore::copyUnwritten(SegmentBuffer& copy) {
+    copy.rows = 0;
+    for (const SegmentBuffer* buffer : {static_cast<const SegmentBuffer*>(sealed),
+                                        static_cast<const SegmentBuffer*>(active)}) {
+        if (!buffer) continue;
+        for (size_t row = 0; row < buffer->rows; row++) {
+            copy.time[copy.rows] = buffer->time[row];
+            for (int i = 0; i < SERVO_COUNT; i++) copy.joints[i][copy.rows] = buffer->joints[i][row];
+            copy.distance[copy.rows] = buffer->distance[row];
+            copy.mode[copy.rows] = buffer->mode[row];
+            copy.event[copy.rows] = buffer->event[row];
+            copy.rows++;
+        }
+    }
+}
+
+void TelemetryStore::recordEvent(TelemetryEvent event) {
+    std::lock_guard<std::mutex> lock(mutex);
+    TelemetrySample sample = last;
+    sample.event = static_cast<int8_t>(event);
+    append(sample);
+}
+
+bool TelemetryStore::writeSegment(const SegmentBuffer& buffer, SegmentInfo& info) {
+    TelemetryColumns columns = buffer.columns();
+    const void* pointers[MAX_COLUMNS];
+    column_pointers(columns, pointers);
+    int64_t start_ms = columns.time[0];
+    int64_t end_ms = columns.time[columns.rows - 1];
+    std::string path = segment_path(directory, TELEMETRY_TIER_RAW, start_ms);
+    if (!write_segment_file(path, TELEMETRY_TIER_RAW, columns.rows, start_ms, end_ms, pointers)) {
+        return false;
+    }
+    
+    size_t offsets[MAX_COLUMNS];
+    info = {path, start_ms, end_ms, columns.rows,
+            static_cast<int64_t>(segment_layout(TELEMETRY_TIER_RAW, columns.rows, offsets))};
+    return true;
+}
+
+bool TelemetryStore::start(Source sample_source) {
+    {
+        std::lock_guard<std::mutex> lock(thread_mutex);
+        if (running || !sample_source) {
+            return false;
+        }
+        source = sample_source;
+        running = true;
+    }
+    
+    arm_clock().attach(); // The threads sleep on the clock
+    if (!thread.start([this]() { run(); })) {
+        arm_clock().detach();
+        std::lock_guard<std::mutex> lock(thread_mutex);
+        running = false;
+        return false;
+    }
+    arm_clock().attach();
+    if (!retention_thread.start([this]() { retain(); })) {
+        arm_clock().detach();
+        stop(); // Ends the sampler
+        return false;
+    }
+    return true;
+}
+
+void TelemetryStore::stop() {
+    {
+        std::lock_guard<std::mutex> lock(thread_mutex);
+        if (!running) return;
+        running = false;
+    }
+    arm_clock().notifyAll(changed);
+    // Joining blocks outside the clock; let simulated time run meanwhile
+    arm_clock().detach();
+    for (RtThread* worker : {&thread, &retention_thread}) {
+        if (worker->joinable()) worker->join();
+    }
+    arm_clock().attach();
+    
+    // Keep what is still in memory across a restart. Events wait for the
+    // write, which only happens at shutdown.
+    std::lock_guard<std::mutex> lock(mutex);
+    for (SegmentBuffer* buffer : {sealed, active}) {
+        SegmentInfo info;
+        if (buffer && buffer->rows > 0 && writeSegment(*buffer, info)) {
+            segments[TELEMETRY_TIER_RAW].push_back(info);
+        }
+    }
+    sealed = nullptr;
+    active->rows = 0;
+}
+
+void TelemetryStore::run() {
+    flight_thread_name("telemetry");
+    Clock::TimePoint next_sample = arm_clock().now();
+    std::unique_lock<std::mutex> lock(thread_mutex);
+    while (running) {
+        lock.unlock();
+        
+        TelemetrySample sample;
+        sample.distance_cm = -1.0f;
+        sample.mode = 0;
+        sample.event = -1;
+        source(sample);
+        
+        const SegmentBuffer* full;
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            append(sample);
+            last = sample;
+            full = sealed;
+        }
+        if (full) {
+            // The buffer is not touched again until sealed is cleared
+            SegmentInfo info;
+            bool written = writeSegment(*full, info);
+            std::lock_guard<std::mutex> guard(mutex);
+            if (written) {
+                segments[TELEMETRY_TIER_RAW].push_back(info);
+            } else {
+                dropped += full->rows;
+                dropped_count.inc(static_cast<double>(full->rows));
+            }
+            sealed = nullptr;
+        }
+        
+        lock.lock();
+        Clock::TimePoint now = arm_clock().now();
+        next_sample += std::chrono::milliseconds(TELEMETRY_SAMPLE_MS);
+        if (next_sample < now) {
+            next_sample = now; // Fell behind (segment write), do not burst to catch up
+        }
+        arm_clock().waitUntil(changed, lock, next_sample, [this]() { return !running; });
+    }
+    
+    lock.unlock();
+    arm_clock().detach();
+}
+
+void TelemetryStore::retain() {
+    flight_thread_name("retention");
+    set_idle_io_priority();
+    std::unique_lock<std::mutex> lock(thread_mutex);
+    while (running) {
+        lock.unlock();
+        
+        // Catches up at once after downtime, then keeps pace
+        int64_t now_ms = nowMs();
+        compact(TELEMETRY_TIER_SECOND, now_ms - retention.raw_ms);
+        compact(TELEMETRY_TIER_MINUTE, now_ms - retention.second_ms);
+        prune(now_ms);
+        
+        lock.lock();
+        arm_clock().waitUntil(changed, lock, arm_clock().now() + std::chrono::seconds(TELEMETRY_RETENTION_S),
+                              [this]() { return !running; });
+    }
+    
+    lock.unlock();
+    arm_clock().detach();
+}
+
+void TelemetryStore::compact(int tier, int64_t cutoff_ms) {
+    const int source = tier - 1;
+    std::vector<SegmentInfo> inputs;
+    int64_t window;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        inputs = segments[source];
+        window = compacted_ms[tier];
+    }
+    
+    RollupBuffer rollup;
+    std::vector<SegmentInfo> written;
+    size_t next = 0;
+    while (true) {
+        // Skip inputs already rolled up, then windows without data
+        while (next < inputs.size() && inputs[next].end_ms < window) next++;
+        if (next == inputs.size()) break;
+        window = std::max(window, inputs[next].start_ms - inputs[next].start_ms % WINDOW_MS[tier]);
+        int64_t window_end = window + WINDOW_MS[tier];
+        if (window_end > cutoff_ms) break;
+        
+        rollup.clear();
+        RollupBuilder builder(rollup, BUCKET_MS[tier]);
+        for (size_t i = next; i < inputs.size() && inputs[i].start_ms < window_end; i++) {
+            SegmentReader segment;
+            if (!segment.open(inputs[i].path, source, rollup_buffer)) {
+                std::cerr << "Skipping unreadable telemetry segment " << inputs[i].path << std::endl;
+                continue;
+            }
+            if (source == TELEMETRY_TIER_RAW) {
+                TelemetryColumns columns = segment.raw();
+                size_t row = std::lower_bound(columns.time, columns.time + columns.rows, window) - columns.time;
+                for (; row < columns.rows && columns.time[row] < window_end; row++) builder.addRaw(columns, row);
+            } else {
+                TelemetryRollupColumns columns = segment.rollup();
+                size_t row = std::lower_bound(columns.time, columns.time + columns.rows, window) - columns.time;
+                for (; row < columns.rows && columns.time[row] < window_end; row++) builder.addRollup(columns, row);
+            }
+        }
+        builder.flush();
+        
+        if (!rollup.time.empty()) {
+            TelemetryRollupColumns columns = rollup.columns();
+            const void* pointers[MAX_COLUMNS];
+            column_pointers(columns, pointers);
+            std::string path = segment_path(directory, tier, window);
+            if (!write_segment_file(path, tier, columns.rows, window, columns.time[columns.rows - 1], pointers)) {
+                break; // Retried on the next pass
+            }
+            size_t offsets[MAX_COLUMNS];
+            written.push_back({path, window, columns.time[columns.rows - 1], columns.rows,
+                               static_cast<int64_t>(segment_layout(tier, columns.rows, offsets))});
+        }
+        window = window_end;
+    }
+    
+    // Publish the rollups, then drop the inputs they cover in full
+    std::vector<std::string> covered;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        segments[tier].insert(segments[tier].end(), written.begin(), written.end());
+        compacted_ms[tier] = std::max(compacted_ms[tier], window);
+        std::vector<SegmentInfo>& finer = segments[source];
+        size_t count = 0;
+        while (count < finer.size() && finer[count].end_ms < compacted_ms[tier]) {
+            covered.push_back(finer[count].path);
+            count++;
+        }
+        finer.erase(finer.begin(), finer.begin() + count);
+    }
+    removeSegments(covered);
+    compacted_count.inc(static_cast<double>(covered.size()));
+}
+
+void TelemetryStore::prune(int64_t now_ms) {
+    std::vector<std::string> expired;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<SegmentInfo>& minutes = segments[TELEMETRY_TIER_MINUTE];
+        while (!minutes.empty() && minutes.front().end_ms < now_ms - retention.minute_ms) {
+            expired.push_back(minutes.front().path);
+            minutes.erase(minutes.begin());
+        }
+        
+        // Over budget: the oldest history goes first, whatever its tier
+        int64_t total = 0;
+        for (const std::vector<SegmentInfo>& tier : segments) {
+            for (const SegmentInfo& segment : tier) total += segment.bytes;
+        }
+        while (total > retention.max_bytes) {
+            int oldest = -1;
+            for (int tier = 0; tier < TELEMETRY_TIERS; tier++) {
+                if (!segments[tier].empty() &&
+                    (oldest < 0 || segments[tier].front().start_ms < segments[oldest].front().start_ms)) {
+                    oldest = tier;
+                }
+            }
+            if (oldest < 0) break;
+            total -= segments[oldest].front().bytes;
+            expired.push_back(segments[oldest].front().path);
+            segments[oldest].erase(segments[oldest].begin());
+        }
+    }
+    removeSegments(expired);
+    pruned_count.inc(static_cast<double>(expired.size()));
+}
+
+void TelemetryStore::removeSegments(const std::vector<std::string>& paths) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (readers > 0) {
+            doomed.insert(doomed.end(), paths.begin(), paths.end());
+            return;
+        }
+    }
+    for (const std::string& path : paths) {
+        std::remove(path.c_str());
+    }
+}
+
+void TelemetryStore::releaseSegments() {
+    std::vector<std::string> paths;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--readers == 0) paths.swap(doomed);
+    }
+    removeSegments(paths);
+}
+
+bool TelemetryStore::exportArrow(int64_t from_ms, int64_t to_ms, const std::string& path, TelemetryExport& result,
+                                 TelemetryTier tier) {
+    auto started = std::chrono::steady_clock::now();
+    result.rows = 0;
+    result.batches = 0;
+    result.bytes = 0;
+    result.milliseconds = 0.0;
+    
+    // Snapshot the index and copy the rows not yet on disk, so sampling
+    // carries on while the export runs
+    std::lock_guard<std::mutex> reading(read_mutex);
+    std::vector<SegmentInfo> files;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const SegmentInfo& segment : segments[tier]) {
+            if (segment.end_ms >= from_ms && segment.start_ms < to_ms) {
+                files.push_back(segment);
+            }
+        }
+        if (tier == TELEMETRY_TIER_RAW) {
+            copyUnwritten(recent); // Rollups only exist on disk
+        }
+        readers++;
+    }
+    
+    std::string partial = path + ".part";
+    ArrowFileWriter writer;
+    if (!writer.open(partial, tier == TELEMETRY_TIER_RAW ? raw_schema() : rollup_schema())) {
+        releaseSegments();
+        return false;
+    }
+    
+    std::vector<uint8_t> distance_valid, event_valid;
+    auto write_rows = [&](const TelemetryColumns& columns) {
+        size_t first = std::lower_bound(columns.time, columns.time + columns.rows, from_ms) - columns.time;
+        size_t end = std::lower_bound(columns.time, columns.time + columns.rows, to_ms) - columns.time;
+        if (first >= end) return true;
+        
+        size_t count = end - first;
+        std::vector<ArrowColumn> batch;
+        batch.push_back({columns.time + first, nullptr, 0});
+        for (int i = 0; i < SERVO_COUNT; i++) {
+            batch.push_back({columns.joints[i] + first, nullptr, 0});
+        }
+        int64_t distance_nulls = build_validity(columns.distance + first, count, distance_valid,
+                                                [](float value) { return value >= 0.0f; });
+        int64_t event_nulls = build_validity(columns.event + first, count, event_valid,
+                                             [](int8_t value) { return value >= 0; });
+        batch.push_back({columns.distance + first, distance_valid.data(), distance_nulls});
+        batch.push_back({columns.mode + first, nullptr, 0});
+        batch.push_back({columns.event + first, event_valid.data(), event_nulls});
+        result.rows += count;
+        return writer.writeBatch(static_cast<int64_t>(count), batch);
+    };
+    auto write_rollup = [&](const TelemetryRollupColumns& columns) {
+        size_t first = std::lower_bound(columns.time, columns.time + columns.rows, from_ms) - columns.time;
+        size_t end = std::lower_bound(columns.time, columns.time + columns.rows, to_ms) - columns.time;
+        if (first >= end) return true;
+        
+        size_t count = end - first;
+        int64_t distance_nulls = build_validity(columns.readings + first, count, distance_valid,
+                                                [](int32_t readings) { return readings > 0; });
+        std::vector<ArrowColumn> batch;
+        batch.push_back({columns.time + first, nullptr, 0});
+        batch.push_back({columns.samples + first, nullptr, 0});
+        batch.push_back({columns.readings + first, nullptr, 0});
+        for (int c = 0; c < TELEMETRY_CHANNELS; c++) {
+            const uint8_t* validity = c == SERVO_COUNT ? distance_valid.data() : nullptr;
+            int64_t nulls = c == SERVO_COUNT ? distance_nulls : 0;
+            batch.push_back({columns.min[c] + first, validity, nulls});
+            batch.push_back({columns.max[c] + first, validity, nulls});
+            batch.push_back({columns.mean[c] + first, validity, nulls});
+        }
+        batch.push_back({columns.mode + first, nullptr, 0});
+        batch.push_back({columns.events + first, nullptr, 0});
+        result.rows += count;
+        return writer.writeBatch(static_cast<int64_t>(count), batch);
+    };
+    
+    bool ok = true;
+    for (const SegmentInfo& file : files) {
+        SegmentReader segment;
+        if (!segment.open(file.path, tier, read_buffer)) {
+            std::cerr << "Skipping unreadable telemetry segment " << file.path << std::endl;
+            continue;
+        }
+        ok = (tier == TELEMETRY_TIER_RAW ? write_rows(segment.raw()) : write_rollup(segment.rollup())) && ok;
+    }
+    if (recent.rows > 0) {
+        ok = write_rows(recent.columns()) && ok;
+    }
+    ok = writer.close() && ok;
+    if (ok && std::rename(partial.c_str(), path.c_str()) != 0) {
+        std::cerr << "Failed to replace " << path << ": " << std::strerror(errno) << std::endl;
+        ok = false;
+    }
+    if (!ok) {
+        std::remove(partial.c_str());
+    }
+    releaseSegments();
+    
+    result.batches = writer.getBatchCount();
+    result.bytes = writer.getBytesWritten();
+    result.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    return ok;
+}
+
+size_t TelemetryStore::queryHistory(int64_t from_ms, int64_t to_ms, int points, TelemetryDownsample method,
+                                    std::vector<TelemetrySeries>& series) {
+    // Segments are read one at a time into the shared read buffer, once per
+    // pass. Deletions wait until the query is done, so both LTTB passes see
+    // the same rows even if retention runs in between.
+    std::lock_guard<std::mutex> reading(read_mutex);
+    std::vector<SegmentInfo> files[TELEMETRY_TIERS];
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (int tier = 0; tier < TELEMETRY_TIERS; tier++) {
+            for (const SegmentInfo& segment : segments[tier]) {
+                if (segment.end_ms >= from_ms && segment.start_ms < to_ms) {
+                    files[tier].push_back(segment);
+                }
+            }
+        }
+        copyUnwritten(recent);
+        readers++;
+    }
+    
+    // Visit rows oldest tier first. A finer tier only picks up after the
+    // coarser one ends, so a raw segment still being rolled up counts once.
+    size_t scanned = 0;
+    auto for_each_row = [&](auto&& visit) {
+        scanned = 0;
+        int64_t frontier = from_ms;
+        float low[TELEMETRY_CHANNELS], high[TELEMETRY_CHANNELS], mean[TELEMETRY_CHANNELS];
+        for (int tier = TELEMETRY_TIERS - 1; tier > TELEMETRY_TIER_RAW; tier--) {
+            for (const SegmentInfo& file : files[tier]) {
+                SegmentReader segment;
+                if (!segment.open(file.path, tier, read_buffer)) continue;
+                TelemetryRollupColumns columns = segment.rollup();
+                size_t row = std::lower_bound(columns.time, columns.time + columns.rows, frontier) - columns.time;
+                for (; row < columns.rows && columns.time[row] < to_ms; row++) {
+                    for (int c = 0; c < TELEMETRY_CHANNELS; c++) {
+                        low[c] = columns.min[c][row];
+                        high[c] = columns.max[c][row];
+                        mean[c] = columns.mean[c][row];
+                    }
+                    visit(columns.time[row], low, high, mean, columns.readings[row] > 0);
+                    frontier = columns.time[row] + BUCKET_MS[tier];
+                    scanned++;
+                }
+            }
+        }
+        auto visit_raw = [&](const TelemetryColumns& columns) {
+            size_t row = std::lower_bound(columns.time, columns.time + columns.rows, frontier) - columns.time;
+            for (; row < columns.rows && columns.time[row] < to_ms; row++) {
+                for (int i = 0; i < SERVO_COUNT; i++) mean[i] = columns.joints[i][row];
+                mean[SERVO_COUNT] = columns.distance[row];
+                visit(columns.time[row], mean, mean, mean, columns.distance[row] >= 0.0f);
+                frontier = columns.time[row] + 1;
+                scanned++;
+            }
+        };
+        for (const SegmentInfo& file : files[TELEMETRY_TIER_RAW]) {
+            SegmentReader segment;
+            if (segment.open(file.path, TELEMETRY_TIER_RAW, read_buffer)) visit_raw(segment.raw());
+        }
+        visit_raw(recent.columns());
+    };
+    
+    // The distance only has points where there was a reading
+    auto has_value = [](int channel, bool reading) { return channel != SERVO_COUNT || reading; };
+    if (method == TELEMETRY_DOWNSAMPLE_LTTB) {
+        std::vector<LttbDownsampler> samplers(series.size(), LttbDownsampler(from_ms, to_ms, points));
+        for_each_row([&](int64_t time, const float*, const float*, const float* mean, bool reading) {
+            for (size_t i = 0; i < series.size(); i++) {
+                if (has_value(series[i].channel, reading)) samplers[i].measure(time, mean[series[i].channel]);
+            }
+        });
+        for_each_row([&](int64_t time, const float*, const float*, const float* mean, bool reading) {
+            for (size_t i = 0; i < series.size(); i++) {
+                if (has_value(series[i].channel, reading)) samplers[i].select(time, mean[series[i].channel]);
+            }
+        });
+        for (size_t i = 0; i < series.size(); i++) {
+            samplers[i].finish(series[i].time, series[i].value);
+        }
+    } else {
+        std::vector<MinMaxDownsampler> samplers(series.size(), MinMaxDownsampler(from_ms, to_ms, points));
+        for_each_row([&](int64_t time, const float* low, const float* high, const float*, bool reading) {
+            for (size_t i = 0; i < series.size(); i++) {
+                int channel = series[i].channel;
+                if (has_value(channel, reading)) samplers[i].add(time, low[channel], high[channel]);
+            }
+        });
+        for (size_t i = 0; i < series.size(); i++) {
+            samplers[i].finish(series[i].time, series[i].value);
+        }
+    }
+    releaseSegments();
+    return scanned;
+}
+
+size_t TelemetryStore::getSegmentCount(TelemetryTier tier) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return segments[tier].size();
+}
+
+int64_t TelemetryStore::getDiskBytes() {
+    std::lock_guard<std::mutex> lock(mutex);
+    int64_t total = 0;
+    for (const std::vector<SegmentInfo>& tier : segments) {
+        for (const SegmentInfo& segment : tier) total += segment.bytes;
+    }
+    return total;
+}
+
+unsigned long TelemetryStore::getDropped() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return dropped;
+}
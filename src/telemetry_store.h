@@ -0,0 +1,251 @@
+#ifndef TELEMETRY_STORE_H
+#define TELEMETRY_STORE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "clock.h"
+#include "rt_thread.h"
+#include "../include/config.h"
+
+// Controller events marked in the telemetry event column
+enum TelemetryEvent {
+    TELEMETRY_EVENT_GRAB,          // grab routine finished
+    TELEMETRY_EVENT_GRAB_FAILED,
+    TELEMETRY_EVENT_STOP,          // emergency stop
+    TELEMETRY_EVENT_HOME,
+    TELEMETRY_EVENT_MODE,          // mode switched (see the mode column)
+    TELEMETRY_EVENT_CALIBRATION,   // maintenance procedure started
+    TELEMETRY_EVENT_COUNT
+};
+
+// Name of an event as exported ("grab", "stop", ...)
+const char* telemetry_event_name(int event);
+
+// Storage tiers, finest first. Raw segments older than the retention
+// period are rolled up to 1 s buckets, and those later to 1 min buckets.
+enum TelemetryTier {
+    TELEMETRY_TIER_RAW,
+    TELEMETRY_TIER_SECOND,
+    TELEMETRY_TIER_MINUTE,
+    TELEMETRY_TIERS
+};
+
+// Values summarized by rollups: the joints, then the distance
+const int TELEMETRY_CHANNELS = SERVO_COUNT + 1;
+
+// Name of a channel as exported ("base", ..., "distance_cm"), "" if out of range
+const char* telemetry_channel_name(int channel);
+
+enum TelemetryDownsample {
+    TELEMETRY_DOWNSAMPLE_LTTB,     // largest triangle three buckets (shape)
+    TELEMETRY_DOWNSAMPLE_MINMAX    // low and high per bucket (envelope)
+};
+
+// One channel of a history query
+struct TelemetrySeries {
+    int channel;                   // set by the caller
+    std::vector<int64_t> time;     // UTC ms
+    std::vector<float> value;
+};
+
+// One telemetry row
+struct TelemetrySample {
+    int64_t time_ms;               // UTC, stamped by the store
+    float joints[SERVO_COUNT];     // estimated servo angles (deg)
+    float distance_cm;             // last ultrasonic reading, < 0 for none
+    int8_t mode;                   // 0 manual, 1 auto
+    int8_t event;                  // TelemetryEvent, -1 for a periodic sample
+};
+
+// Rows of a segment, one contiguous array per column
+struct TelemetryColumns {
+    size_t rows;
+    const int64_t* time;
+    const float* joints[SERVO_COUNT];
+    const float* distance;
+    const int8_t* mode;
+    const int8_t* event;
+};
+
+// Rows of a rollup segment, one per bucket that has samples
+struct TelemetryRollupColumns {
+    size_t rows;
+    const int64_t* time;                        // bucket start
+    const int32_t* samples;                     // raw rows summarized
+    const int32_t* readings;                    // of which had a distance reading
+    const float* min[TELEMETRY_CHANNELS];
+    const float* max[TELEMETRY_CHANNELS];
+    const float* mean[TELEMETRY_CHANNELS];      // distance values are -1 without readings
+    const int8_t* mode;                         // at the end of the bucket
+    const uint8_t* events;                      // bit (1 << event) per event that occurred
+};
+
+// Segment file layout: this header, then each column starting on a
+// 64-byte boundary (raw: time, joints, distance, mode, event; rollups:
+// time, samples, readings, min, max and mean per channel, mode, events)
+struct TelemetrySegmentHeader {
+    char magic[8];                 // "SATELEMS"
+    uint32_t version;
+    uint32_t rows;
+    int64_t start_ms;              // first row; rollups: start of the file's window
+    int64_t end_ms;                // last row
+    uint32_t tier;                 // TelemetryTier
+    uint8_t reserved[28];
+};
+
+// How long each tier is kept, and the disk space all of them may use
+struct TelemetryRetention {
+    int64_t raw_ms;
+    int64_t second_ms;
+    int64_t minute_ms;
+    int64_t max_bytes;
+};
+
+struct TelemetryExport {
+    size_t rows;
+    int batches;
+    int64_t bytes;
+    double milliseconds;
+};
+
+// Columnar telemetry store. A sampler thread records the source every
+// TELEMETRY_SAMPLE_MS and events add rows as they happen; rows fill a
+// preallocated in-memory segment of TELEMETRY_SEGMENT_ROWS, which is
+// sealed when full and written to TELEMETRY_DIR by the sampler thread.
+// Appending never allocates, so events can be recorded from the control
+// and MQTT threads. A retention thread at idle I/O priority rolls aged
+// segments up to coarser tiers and deletes what falls outside the
+// retention periods or the disk budget.
+class TelemetryStore {
+public:
+    typedef std::function<void(TelemetrySample&)> Source;
+    
+private:
+    struct SegmentBuffer {
+        std::vector<int64_t> time;
+        std::vector<float> joints[SERVO_COUNT];
+        std::vector<float> distance;
+        std::vector<int8_t> mode;
+        std::vector<int8_t> event;
+        size_t rows = 0;
+        
+        void allocate(size_t capacity);
+        void append(const TelemetrySample& sample);
+        TelemetryColumns columns() const;
+    };
+    
+    struct SegmentInfo {
+        std::string path;
+        int64_t start_ms;
+        int64_t end_ms;
+        size_t rows = 0;
+        int64_t bytes = 0;
+    };
+    
+    std::string directory;
+    std::mutex mutex;                    // guards everything below but the thread control
+    SegmentBuffer buffers[2];
+    SegmentBuffer* active;               // being filled
+    SegmentBuffer* sealed;               // full, waiting to be written, or nullptr
+    std::vector<SegmentInfo> segments[TELEMETRY_TIERS];   // on disk, oldest first
+    int64_t compacted_ms[TELEMETRY_TIERS];   // rollup windows before this are written
+    TelemetryRetention retention;
+    TelemetrySample last;                // latest periodic sample, base of event rows
+    unsigned long dropped;               // rows lost to a slow or failed segment write
+    int64_t epoch_ms;                    // UTC time at clock_epoch
+    Clock::TimePoint clock_epoch;
+    int readers;                         // exports and queries reading segment files
+    std::vector<std::string> doomed;     // deleted while they were reading, removed after
+    
+    std::mutex read_mutex;               // one export or query at a time; guards the two below
+    SegmentBuffer recent;                // unwritten rows copied for an export or query
+    std::vector<uint8_t> read_buffer;    // segment file being exported or queried
+    std::vector<uint8_t> rollup_buffer;  // segment file being rolled up (retention thread)
+    
+    Source source;
+    RtThread thread;
+    RtThread retention_thread;
+    std::mutex thread_mutex;
+    std::condition_variable changed;
+    bool running;
+    
+    void run();
+    void retain();
+    
+    // Roll the previous tier's segments up into whole windows of this
+    // tier, up to cutoff_ms, then delete the inputs that are fully covered
+    void compact(int tier, int64_t cutoff_ms);
+    
+    // Delete rollups past their retention period, then the oldest
+    // segments while over the disk budget
+    void prune(int64_t now_ms);
+    
+    // With the mutex held: stamp and append, sealing a full segment
+    void append(TelemetrySample& sample);
+    
+    // With the mutex held: copy the rows not yet written to disk into a
+    // buffer allocated for two segments
+    void copyUnwritten(SegmentBuffer& copy);
+    
+    // Delete segment files, or leave them to releaseSegments() while an
+    // export or query is reading
+    void removeSegments(const std::vector<std::string>& paths);
+    
+    // End of a read that incremented readers under the mutex
+    void releaseSegments();
+    
+    // Write a segment file (not yet indexed)
+    bool writeSegment(const SegmentBuffer& buffer, SegmentInfo& info);
+    
+    // Read the headers of existing segment files
+    void indexSegments();
+    
+public:
+    explicit TelemetryStore(const std::string& dir = TELEMETRY_DIR);
+    ~TelemetryStore();
+    
+    TelemetryStore(const TelemetryStore&) = delete;
+    TelemetryStore& operator=(const TelemetryStore&) = delete;
+    
+    // Create the directory, index stored segments and allocate the buffers
+    bool initialize();
+    
+    // Sample the source every TELEMETRY_SAMPLE_MS on a background thread
+    bool start(Source sample_source);
+    
+    // Stop sampling and write the partial segment
+    void stop();
+    
+    // Add a row marking an event, with the latest sampled values
+    void recordEvent(TelemetryEvent event);
+    
+    // Current time on the store's UTC time line
+    int64_t nowMs();
+    
+    // Write rows of a tier with from_ms <= time < to_ms as an Arrow IPC
+    // file, one record batch per segment. The file is written beside path
+    // and renamed over it when complete, so a reader that still has the
+    // previous export mapped keeps an intact copy.
+    bool exportArrow(int64_t from_ms, int64_t to_ms, const std::string& path, TelemetryExport& result,
+                     TelemetryTier tier = TELEMETRY_TIER_RAW);
+    
+    // Downsample each series' channel over from_ms <= time < to_ms to at
+    // most points points, reading one segment at a time: rollups where
+    // raw rows have aged out, raw rows after. Returns the rows scanned.
+    size_t queryHistory(int64_t from_ms, int64_t to_ms, int points, TelemetryDownsample method,
+                        std::vector<TelemetrySeries>& series);
+    
+    // Before start()
+    void setRetention(const TelemetryRetention& periods) { retention = periods; }
+    
+    size_t getSegmentCount(TelemetryTier tier = TELEMETRY_TIER_RAW);
+    int64_t getDiskBytes();
+    unsigned long getDropped();
+};
+
+#endif // TELEMETRY_STORE_H
@@ -0,0 +1,187 @@
+// Decoder for flight recorder dumps.
+//
+// Reads a flight-<time>-<reason>.bin file written by the controller on
+// e-stop, watchdog trip, crash or request, merges the per-thread rings by
+// time and prints one line per record. Times are relative to the newest
+// record, so the lines just before the fault read as negative offsets.
+//
+// Usage: flight-decode FILE [--csv] [--last N]
+
+#include "flight_recorder.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct DecodedRecord {
+    int thread;
+    FlightRecord record;
+};
+
+static const char* type_name(int type) {
+    switch (type) {
+        case FLIGHT_TICK: return "tick";
+        case FLIGHT_COMMAND: return "command";
+        case FLIGHT_SETPOINT: return "setpoint";
+        case FLIGHT_OUTPUT: return "output";
+        case FLIGHT_SENSOR: return "sensor";
+        case FLIGHT_EVENT: return "event";
+    }
+    return "unknown";
+}
+
+static const char* event_name(int id) {
+    switch (id) {
+        case FLIGHT_EVENT_ESTOP: return "estop";
+        case FLIGHT_EVENT_MODE: return "mode";
+        case FLIGHT_EVENT_GRAB: return "grab";
+        case FLIGHT_EVENT_WATCHDOG: return "watchdog";
+        case FLIGHT_EVENT_DUMP: return "dump";
+        case FLIGHT_EVENT_SERVO_POWER: return "servo_power";
+        case FLIGHT_EVENT_SUPPLY_BUDGET: return "supply_budget";
+        case FLIGHT_EVENT_CONVEYOR: return "conveyor";
+    }
+    return "unknown";
+}
+
+static const char* reason_name(int reason) {
+    switch (reason) {
+        case FLIGHT_DUMP_REQUEST: return "request";
+        case FLIGHT_DUMP_ESTOP: return "estop";
+        case FLIGHT_DUMP_WATCHDOG: return "watchdog";
+        case FLIGHT_DUMP_CRASH: return "crash";
+    }
+    return "unknown";
+}
+
+// Human readable payload for one record
+static std::string describe(const FlightRecord& r) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1);
+    switch (r.type) {
+        case FLIGHT_TICK:
+            out << (r.id ? "auto" : "manual") << " " << r.value << " us";
+            break;
+        case FLIGHT_COMMAND:
+            out << "\"" << std::string(r.text, strnlen(r.text, sizeof(r.text))) << "\"";
+            if (r.value > static_cast<int>(sizeof(r.text))) out << " (" << r.value << " bytes)";
+            break;
+        case FLIGHT_SETPOINT:
+            out << "servo " << static_cast<int>(r.id) << " -> " << r.value << " deg";
+            break;
+        case FLIGHT_OUTPUT:
+            out << "servo " << static_cast<int>(r.id) << " pwm " << r.value << " (" << r.values[0] << " deg)";
+            break;
+        case FLIGHT_SENSOR:
+            if (r.value < 0) out << "timeout";
+            else out << r.values[0] << " cm (" << r.value << " us echo)";
+            break;
+        case FLIGHT_EVENT:
+            out << event_name(r.id) << " " << r.value;
+            break;
+    }
+    return out.str();
+}
+
+int main(int argc, char** argv) {
+    std::string path;
+    bool csv = false;
+    size_t last = 0;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--csv") == 0) {
+            csv = true;
+        } else if (std::strcmp(argv[i], "--last") == 0 && i + 1 < argc) {
+            last = std::strtoul(argv[++i], nullptr, 10);
+        } else if (argv[i][0] != '-' && path.empty()) {
+            path = argv[i];
+        } else {
+            std::cerr << "Usage: flight-decode FILE [--csv] [--last N]" << std::endl;
+            return 1;
+        }
+    }
+    if (path.empty()) {
+        std::cerr << "Usage: flight-decode FILE [--csv] [--last N]" << std::endl;
+        return 1;
+    }
+    
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Cannot open " << path << std::endl;
+        return 1;
+    }
+    
+    FlightDumpHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, "SAFLIGHT", sizeof(header.magic)) != 0) {
+        std::cerr << path << " is not a flight recorder dump" << std::endl;
+        return 1;
+    }
+    if (header.version != 1 || header.record_size != sizeof(FlightRecord)) {
+        std::cerr << "Unsupported dump version " << header.version
+                  << " (record size " << header.record_size << ")" << std::endl;
+        return 1;
+    }
+    
+    std::vector<std::string> names;
+    std::vector<DecodedRecord> records;
+    for (uint32_t t = 0; t < header.thread_count; t++) {
+        FlightDumpThread thread;
+        if (!file.read(reinterpret_cast<char*>(&thread), sizeof(thread))) {
+            std::cerr << "Truncated dump: missing thread " << t << std::endl;
+            return 1;
+        }
+        names.push_back(std::string(thread.name, strnlen(thread.name, sizeof(thread.name))));
+        for (uint32_t i = 0; i < thread.record_count; i++) {
+            DecodedRecord decoded;
+            decoded.thread = t;
+            if (!file.read(reinterpret_cast<char*>(&decoded.record), sizeof(decoded.record))) {
+                std::cerr << "Truncated dump in thread " << names.back() << std::endl;
+                return 1;
+            }
+            records.push_back(decoded);
+        }
+    }
+    
+    std::stable_sort(records.begin(), records.end(), [](const DecodedRecord& a, const DecodedRecord& b) {
+        return a.record.time_ns < b.record.time_ns;
+    });
+    if (last > 0 && records.size() > last) {
+        records.erase(records.begin(), records.end() - last);
+    }
+    uint64_t newest = records.empty() ? 0 : records.back().record.time_ns;
+    
+    if (csv) {
+        std::cout << "time_ms,thread,type,id,value,a,b,c,d,text" << std::endl;
+    } else {
+        std::cout << "Dump reason: " << reason_name(header.reason);
+        if (header.signal != 0) std::cout << " (signal " << header.signal << ")";
+        std::cout << ", " << header.thread_count << " threads, " << records.size() << " records" << std::endl;
+    }
+    
+    for (const DecodedRecord& decoded : records) {
+        const FlightRecord& r = decoded.record;
+        double offset_ms = (static_cast<double>(r.time_ns) - static_cast<double>(newest)) / 1e6;
+        if (csv) {
+            std::cout << std::fixed << std::setprecision(3) << offset_ms << "," << names[decoded.thread] << ","
+                      << type_name(r.type) << "," << static_cast<int>(r.id) << "," << r.value;
+            if (r.type == FLIGHT_COMMAND) {
+                std::string text(r.text, strnlen(r.text, sizeof(r.text)));
+                std::replace(text.begin(), text.end(), '"', '\'');
+                std::cout << ",,,,,\"" << text << "\"";
+            } else {
+                std::cout << "," << r.values[0] << "," << r.values[1] << "," << r.values[2] << "," << r.values[3] << ",";
+            }
+            std::cout << std::endl;
+        } else {
+            std::cout << std::fixed << std::setprecision(3) << std::setw(12) << offset_ms << " ms  "
+                      << std::left << std::setw(10) << names[decoded.thread] << std::setw(9) << type_name(r.type)
+                      << std::right << describe(r) << std::endl;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,371 @@
+// Offline cycle-time tuner for the auto-mode grab routine.
+//
+// Runs the grab routine thousands of times through the real RoutineRunner
+// and ServoControl against simulated hardware on a SimClock, as
+// soak-benchmark does, with joint speed, link frequency/damping and part
+// timing randomized around the nominal values: the same supply budget,
+// input shaping and step pacing the controller uses, judged by
+// SimHardware's joint dynamics. Grid-searches approach/lift speed, blend
+// and dwell parameters across worker processes. The fastest parameter set
+// that meets the success-rate target without leaving joint limits is
+// written to GRAB_PARAMS_FILE, which SmartArm-Vision loads at startup.
+//
+// Usage: grab-tuner [--trials N] [--jobs N] [--min-success 0.99]
+//                   [--shaper off|zv|zvd] [--window-ms N] [--out FILE]
+
+#include "servo_control.h"
+#include "routine_runner.h"
+#include "grab_params.h"
+#include "clock.h"
+#include "sim_hardware.h"
+#include "../include/config.h"
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Motor driver (src/driver_motor.cpp), on the simulated pins
+extern "C" {
+    bool motor_initialize();
+    void motor_set_speed(int speed);
+}
+
+// Pick conditions a routine is judged against
+struct PickScenario {
+    float position_tolerance_mm = 3.0f;   // wrist error allowed when the gripper closes
+    float max_lift_deflection_mm = 3.0f;  // vibration while carrying that shakes the part loose
+    int part_window_ms = 4000;            // part graspable this long after detection
+    float coupling = 0.08f;               // joint acceleration -> link deflection gain
+    ShaperType shaper = SHAPER_NONE;
+};
+
+struct TrialResult {
+    bool success;     // picked the part, in position, and held it
+    bool safe;        // stayed inside joint limits
+    int cycle_ms;     // routine duration
+};
+
+struct Candidate {
+    GrabParams params;
+    double success_rate;
+    double mean_cycle_ms;
+    int worst_cycle_ms;
+    bool safe;
+};
+
+// Sent back from the worker processes as raw bytes
+static_assert(std::is_trivially_copyable<Candidate>::value, "Candidate crosses a pipe");
+
+struct TunerOptions {
+    int trials = 100;
+    int jobs = 0;
+    double min_success = 0.99;
+    PickScenario scenario;
+    std::string output = GRAB_PARAMS_FILE;
+};
+
+// Swallows controller log output without buffering it
+class DiscardBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return traits_type::not_eof(c); }
+    std::streamsize xsputn(const char*, std::streamsize count) override { return count; }
+};
+
+// Search space around the original hand-tuned choreography
+static std::vector<GrabParams> build_grid() {
+    const float approach_speeds[] = {0.0f, 150.0f, 100.0f, 60.0f};
+    const float lift_speeds[] = {0.0f, 150.0f, 100.0f};
+    const float blends[] = {0.0f, 5.0f, 10.0f, 20.0f};
+    const int settle_dwells[] = {0, 100, 250};
+    const int grip_dwells[] = {0, 100, 250};
+    const int approach_steps[] = {1, 3, 5};
+    const bool settle_waits[] = {true, false};
+    
+    std::vector<GrabParams> grid;
+    for (float approach : approach_speeds)
+    for (float lift : lift_speeds)
+    for (float blend : blends)
+    for (int settle_dwell : settle_dwells)
+    for (int grip_dwell : grip_dwells)
+    for (int steps : approach_steps)
+    for (bool wait_settle : settle_waits) {
+        if (blend > 0.0f && wait_settle) continue; // Blending never waits to settle
+        GrabParams params;
+        params.approach_speed = approach;
+        params.lift_speed = lift;
+        params.blend_deg = blend;
+        params.settle_dwell_ms = settle_dwell;
+        params.grip_dwell_ms = grip_dwell;
+        params.approach_steps = steps;
+        params.lift_steps = steps;
+        params.wait_settle = wait_settle;
+        grid.push_back(params);
+    }
+    return grid;
+}
+
+// One pick from the home pose: a part reaches the grab position as the
+// routine starts and the belt carries it out of reach after window_ms.
+// The physical joints differ from the controller's model.
+static TrialResult run_trial(const GrabParams& params, const MotionRoutine& routine,
+                             const SimJoint actual[SERVO_COUNT], const PickScenario& scenario,
+                             int window_ms, unsigned int seed) {
+    SimClock clock;
+    set_arm_clock(&clock);
+    SimHardware hardware(clock, params, SimSensor(), seed);
+    set_sim_hardware(&hardware);
+    
+    TrialResult result = {false, routine.validate(), 0};
+    {
+        ServoControl servo;
+        if (servo.initialize() && motor_initialize()) {
+            servo.setShaperType(scenario.shaper);
+            servo.waitForSettle();
+            hardware.setDynamics(actual, scenario.coupling);
+            hardware.setReach(window_ms / 1000.0 * CONVEYOR_BELT_MM_S);
+            hardware.addPart(hardware.travelAt(clock.now()), 12.0f);
+            motor_set_speed(100);
+            
+            RoutineRunner runner(servo);
+            RoutineReport report;
+            bool completed = runner.run(routine, report);
+            SimDynamicsReport dynamics = hardware.getDynamics();
+            result.cycle_ms = static_cast<int>(report.actual.count());
+            result.safe = result.safe && dynamics.within_limits;
+            result.success = completed && hardware.getParts().front().picked &&
+                             dynamics.close_error_mm <= scenario.position_tolerance_mm &&
+                             dynamics.carry_deflection_mm <= scenario.max_lift_deflection_mm;
+        }
+    }
+    
+    set_sim_hardware(nullptr);
+    set_arm_clock(nullptr);
+    return result;
+}
+
+// Monte Carlo evaluation of one parameter set. Trials are seeded from the
+// candidate index so results do not depend on how work is split.
+static Candidate evaluate(const GrabParams& params, size_t index, const TunerOptions& options) {
+    SimJoint nominal[SERVO_COUNT];
+    SimHardware::defaultJoints(nominal);
+    MotionRoutine routine = build_grab_routine(params);
+    
+    std::mt19937 rng(static_cast<unsigned>(index * 7919 + 17));
+    std::uniform_real_distribution<float> speed_spread(0.85f, 1.05f);
+    std::uniform_real_distribution<float> frequency_spread(0.85f, 1.15f);
+    std::uniform_real_distribution<float> damping_spread(0.7f, 1.3f);
+    std::uniform_real_distribution<float> window_spread(0.8f, 1.2f);
+    
+    Candidate result = {params, 0.0, 0.0, 0, true};
+    int successes = 0;
+    double total_cycle = 0.0;
+    
+    for (int trial = 0; trial < options.trials; trial++) {
+        SimJoint actual[SERVO_COUNT];
+        for (int i = 0; i < SERVO_COUNT; i++) {
+            actual[i] = nominal[i];
+            actual[i].speed *= speed_spread(rng);
+            actual[i].frequency *= frequency_spread(rng);
+            actual[i].damping = std::min(0.9f, actual[i].damping * damping_spread(rng));
+        }
+        int window_ms = static_cast<int>(options.scenario.part_window_ms * window_spread(rng));
+        
+        TrialResult trial_result = run_trial(params, routine, actual, options.scenario, window_ms, rng());
+        if (trial_result.success) successes++;
+        if (!trial_result.safe) result.safe = false;
+        total_cycle += trial_result.cycle_ms;
+        result.worst_cycle_ms = std::max(result.worst_cycle_ms, trial_result.cycle_ms);
+    }
+    
+    result.success_rate = static_cast<double>(successes) / options.trials;
+    result.mean_cycle_ms = total_cycle / options.trials;
+    return result;
+}
+
+static bool write_all(int fd, const void* data, size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t written = write(fd, bytes, size);
+        if (written <= 0) return false;
+        bytes += written;
+        size -= written;
+    }
+    return true;
+}
+
+static bool read_all(int fd, void* data, size_t size) {
+    char* bytes = static_cast<char*>(data);
+    while (size > 0) {
+        ssize_t got = read(fd, bytes, size);
+        if (got <= 0) return false;
+        bytes += got;
+        size -= got;
+    }
+    return true;
+}
+
+// Trials take over the process-wide clock and pin access, so parallel
+// workers are processes: each evaluates every jobs-th candidate and sends
+// the results back through a pipe.
+static bool evaluate_grid(const std::vector<GrabParams>& grid, const TunerOptions& options,
+                          std::vector<Candidate>& results) {
+    if (options.jobs == 1) {
+        for (size_t i = 0; i < grid.size(); i++) {
+            results[i] = evaluate(grid[i], i, options);
+        }
+        return true;
+    }
+    
+    std::vector<pid_t> workers;
+    std::vector<int> pipes;
+    for (int job = 0; job < options.jobs; job++) {
+        int fds[2];
+        if (pipe(fds) != 0) {
+            std::perror("pipe");
+            break;
+        }
+        pid_t pid = fork();
+        if (pid < 0) {
+            std::perror("fork");
+            close(fds[0]);
+            close(fds[1]);
+            break;
+        }
+        if (pid == 0) {
+            close(fds[0]);
+            for (size_t i = job; i < grid.size(); i += options.jobs) {
+                Candidate candidate = evaluate(grid[i], i, options);
+                if (!write_all(fds[1], &i, sizeof(i)) || !write_all(fds[1], &candidate, sizeof(candidate))) {
+                    _exit(1);
+                }
+            }
+            _exit(0);
+        }
+        close(fds[1]);
+        workers.push_back(pid);
+        pipes.push_back(fds[0]);
+    }
+    
+    size_t received = 0;
+    for (int fd : pipes) {
+        size_t index;
+        Candidate candidate;
+        while (read_all(fd, &index, sizeof(index)) && read_all(fd, &candidate, sizeof(candidate))) {
+            if (index < results.size()) {
+                results[index] = candidate;
+                received++;
+            }
+        }
+        close(fd);
+    }
+    for (pid_t pid : workers) {
+        waitpid(pid, nullptr, 0);
+    }
+    if (received != grid.size()) {
+        std::fprintf(stderr, "Workers returned %zu of %zu results\n", received, grid.size());
+        return false;
+    }
+    return true;
+}
+
+static bool parse_options(int argc, char** argv, TunerOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--trials" && has_value) options.trials = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--jobs" && has_value) options.jobs = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--min-success" && has_value) options.min_success = std::atof(argv[++i]);
+        else if (arg == "--window-ms" && has_value) options.scenario.part_window_ms = std::atoi(argv[++i]);
+        else if (arg == "--out" && has_value) options.output = argv[++i];
+        else if (arg == "--shaper" && has_value) {
+            std::string type = argv[++i];
+            options.scenario.shaper = type == "zv" ? SHAPER_ZV : type == "zvd" ? SHAPER_ZVD : SHAPER_NONE;
+        }
+        else {
+            std::cerr << "Usage: " << argv[0] << " [--trials N] [--jobs N] [--min-success P]"
+                      << " [--shaper off|zv|zvd] [--window-ms N] [--out FILE]" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    TunerOptions options;
+    if (!parse_options(argc, argv, options)) {
+        return 1;
+    }
+    if (options.jobs == 0) {
+        options.jobs = std::max(1u, std::thread::hardware_concurrency());
+    }
+    
+    std::vector<GrabParams> grid = build_grid();
+    std::vector<Candidate> results(grid.size());
+    std::cout << "Evaluating " << grid.size() << " parameter sets x " << options.trials
+              << " trials in " << options.jobs << " jobs..." << std::endl;
+    
+    // Controller log output is noise at thousands of picks per second
+    DiscardBuffer discard;
+    std::streambuf* cout_buffer = std::cout.rdbuf(&discard);
+    std::streambuf* cerr_buffer = std::cerr.rdbuf(&discard);
+    bool evaluated = evaluate_grid(grid, options, results);
+    
+    // Baseline: the original choreography with default parameters
+    Candidate baseline = evaluate(GrabParams(), grid.size(), options);
+    std::cout.rdbuf(cout_buffer);
+    std::cerr.rdbuf(cerr_buffer);
+    if (!evaluated) {
+        std::cerr << "Evaluation failed" << std::endl;
+        return 1;
+    }
+    std::cout << std::fixed << std::setprecision(1)
+              << "Baseline: " << baseline.mean_cycle_ms << " ms mean, "
+              << baseline.success_rate * 100.0 << "% success" << std::endl;
+    
+    std::vector<Candidate> feasible;
+    for (const Candidate& candidate : results) {
+        if (candidate.safe && candidate.success_rate >= options.min_success) {
+            feasible.push_back(candidate);
+        }
+    }
+    if (feasible.empty()) {
+        std::cerr << "No parameter set reached " << options.min_success * 100.0 << "% success" << std::endl;
+        return 1;
+    }
+    std::sort(feasible.begin(), feasible.end(), [](const Candidate& a, const Candidate& b) {
+        return a.mean_cycle_ms < b.mean_cycle_ms;
+    });
+    
+    std::cout << feasible.size() << " feasible sets, best:" << std::endl;
+    for (size_t i = 0; i < std::min<size_t>(5, feasible.size()); i++) {
+        const Candidate& c = feasible[i];
+        std::cout << "  " << c.mean_cycle_ms << " ms (worst " << c.worst_cycle_ms << ", "
+                  << c.success_rate * 100.0 << "%)"
+                  << " approach " << c.params.approach_speed << " deg/s x" << c.params.approach_steps
+                  << ", lift " << c.params.lift_speed << " deg/s"
+                  << ", blend " << c.params.blend_deg << " deg"
+                  << ", settle " << (c.params.wait_settle ? "wait" : "no-wait") << "+" << c.params.settle_dwell_ms
+                  << " ms, grip dwell " << c.params.grip_dwell_ms << " ms" << std::endl;
+    }
+    
+    std::filesystem::path output_dir = std::filesystem::path(options.output).parent_path();
+    if (!output_dir.empty()) {
+        std::error_code error;
+        std::filesystem::create_directories(output_dir, error);
+    }
+    if (!save_grab_params(options.output, feasible.front().params)) {
+        return 1;
+    }
+    std::cout << "Wrote " << options.output << std::endl;
+    return 0;
+}
@@ -0,0 +1,251 @@
+// Synthetic check of the hand-eye solver.
+//
+// Places a camera and a gripper fiducial at known poses, drives the arm
+// model through HAND_EYE_POSES and generates the fiducial observations the
+// vision node would report, with Gaussian rotation/translation noise and
+// optionally some gross outliers (a flipped or misdetected fiducial). Each
+// seed is solved as the controller would, written with save_hand_eye and
+// read back with load_hand_eye, and compared against the true camera pose.
+// The error that matters downstream is where a detection on the belt ends
+// up in arm coordinates, so that is reported too.
+//
+// Exits non-zero if any seed fails to solve or exceeds --max-mm/--max-deg.
+//
+// Usage: hand-eye-check [--seeds N] [--noise-deg D] [--noise-mm M] [--outliers K]
+//                       [--max-mm M] [--max-deg D] [--verbose]
+
+#include "hand_eye.h"
+#include "kinematics.h"
+#include "../include/config.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+struct CheckOptions {
+    int seeds = 100;
+    double noise_deg = 0.2;
+    double noise_mm = 1.5;
+    int outliers = 1;
+    double outlier_rad = 1.0;     // rotation and offset of an outlying observation
+    double outlier_mm = 100.0;
+    double max_mm = 10.0;
+    double max_deg = 1.5;
+    bool verbose = false;
+};
+
+struct SeedError {
+    bool solved;
+    double rotation_deg;
+    double translation_mm;
+    double belt_mm;               // worst placement error over belt points
+    int inliers;
+    int pairs;
+};
+
+static const double PI = 3.14159265358979;
+
+static RigidTransform compose(const RigidTransform& x, const RigidTransform& y) {
+    RigidTransform result;
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            result.r[i][j] = x.r[i][0] * y.r[0][j] + x.r[i][1] * y.r[1][j] + x.r[i][2] * y.r[2][j];
+        }
+        result.t[i] = x.r[i][0] * y.t[0] + x.r[i][1] * y.t[1] + x.r[i][2] * y.t[2] + x.t[i];
+    }
+    return result;
+}
+
+static RigidTransform inverse(const RigidTransform& x) {
+    RigidTransform result;
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            result.r[i][j] = x.r[j][i];
+        }
+    }
+    for (int i = 0; i < 3; i++) {
+        result.t[i] = -(result.r[i][0] * x.t[0] + result.r[i][1] * x.t[1] + result.r[i][2] * x.t[2]);
+    }
+    return result;
+}
+
+static double rotation_angle(const RigidTransform& x) {
+    double c = (x.r[0][0] + x.r[1][1] + x.r[2][2] - 1.0) / 2.0;
+    return std::acos(std::max(-1.0, std::min(1.0, c)));
+}
+
+// Perturb a pose by a rotation of the given size about a random axis
+// through its origin and an offset of the given size in a random direction
+static RigidTransform perturb(const RigidTransform& pose, double angle, double offset, std::mt19937& rng) {
+    std::normal_distribution<double> normal(0.0, 1.0);
+    double axis[3], direction[3];
+    double axis_norm = 0.0, direction_norm = 0.0;
+    for (int i = 0; i < 3; i++) {
+        axis[i] = normal(rng);
+        direction[i] = normal(rng);
+        axis_norm += axis[i] * axis[i];
+        direction_norm += direction[i] * direction[i];
+    }
+    double rotation[3], translation[3] = {0.0, 0.0, 0.0};
+    RigidTransform result = pose;
+    for (int i = 0; i < 3; i++) {
+        rotation[i] = axis[i] / std::sqrt(axis_norm) * angle;
+        result.t[i] += direction[i] / std::sqrt(direction_norm) * offset;
+    }
+    return compose(result, rigid_from_rotation_vector(rotation, translation));
+}
+
+static SeedError run_seed(int seed, const CheckOptions& options) {
+    // Camera above and to the right of the workspace, looking down at the
+    // belt; fiducial plate on the gripper, facing up
+    const double camera_rotation[3] = {2.9, 0.35, -0.25};
+    const double camera_translation[3] = {180.0, -260.0, 480.0};
+    const double marker_rotation[3] = {0.0, -0.4, 0.0};
+    const double marker_translation[3] = {-25.0, 0.0, 30.0};
+    RigidTransform camera = rigid_from_rotation_vector(camera_rotation, camera_translation);
+    RigidTransform marker = rigid_from_rotation_vector(marker_rotation, marker_translation);
+    RigidTransform camera_inverse = inverse(camera);
+    
+    std::mt19937 rng(static_cast<unsigned>(seed * 7919 + 31));
+    std::normal_distribution<double> rotation_noise(0.0, options.noise_deg * PI / 180.0);
+    std::normal_distribution<double> translation_noise(0.0, options.noise_mm);
+    
+    const float poses[][4] = HAND_EYE_POSES;
+    const int pose_count = sizeof(poses) / sizeof(poses[0]);
+    std::vector<int> order(pose_count);
+    for (int i = 0; i < pose_count; i++) order[i] = i;
+    std::shuffle(order.begin(), order.end(), rng);
+    
+    std::vector<HandEyeSample> samples;
+    for (int index = 0; index < pose_count; index++) {
+        HandEyeSample sample;
+        sample.gripper = arm_gripper_pose(poses[index][0], poses[index][1], poses[index][2], poses[index][3]);
+        RigidTransform seen = compose(camera_inverse, compose(sample.gripper, marker));
+        
+        // Pose estimation noise: orientation about the fiducial's center,
+        // position in the camera frame
+        double rotation[3], offset[3] = {0.0, 0.0, 0.0};
+        for (int i = 0; i < 3; i++) {
+            rotation[i] = rotation_noise(rng);
+            seen.t[i] += translation_noise(rng);
+        }
+        seen = compose(seen, rigid_from_rotation_vector(rotation, offset));
+        if (std::find(order.begin(), order.begin() + options.outliers, index) != order.begin() + options.outliers) {
+            seen = perturb(seen, options.outlier_rad, options.outlier_mm, rng);
+        }
+        sample.fiducial = seen;
+        samples.push_back(sample);
+    }
+    
+    SeedError error = {false, 0.0, 0.0, 0.0, 0, 0};
+    HandEyeResult result;
+    if (!solve_hand_eye(samples, result)) {
+        return error;
+    }
+    
+    // Through the calibration file, as the controller leaves it
+    char path[] = "/tmp/hand-eye-check-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        std::cerr << "Failed to create a temporary file" << std::endl;
+        return error;
+    }
+    close(fd);
+    RigidTransform loaded;
+    bool round_trip = save_hand_eye(path, result) && load_hand_eye(path, loaded);
+    std::remove(path);
+    if (!round_trip) {
+        return error;
+    }
+    
+    RigidTransform difference = compose(inverse(camera), loaded);
+    error.solved = true;
+    error.inliers = result.inliers;
+    error.pairs = result.pairs;
+    error.rotation_deg = rotation_angle(difference) * 180.0 / PI;
+    error.translation_mm = std::sqrt(difference.t[0] * difference.t[0] + difference.t[1] * difference.t[1] +
+                                     difference.t[2] * difference.t[2]);
+    
+    // Belt points as the camera sees them, placed with the solved pose
+    for (float x = 100.0f; x <= 300.0f; x += 50.0f) {
+        for (float y = -150.0f; y <= 150.0f; y += 50.0f) {
+            ArmPoint in_camera = rigid_apply(camera_inverse, {x, y, 0.0f});
+            ArmPoint placed = rigid_apply(loaded, in_camera);
+            double dx = placed.x - x, dy = placed.y - y, dz = placed.z;
+            error.belt_mm = std::max(error.belt_mm, std::sqrt(dx * dx + dy * dy + dz * dz));
+        }
+    }
+    return error;
+}
+
+static bool parse_options(int argc, char** argv, CheckOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--seeds" && has_value) options.seeds = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--noise-deg" && has_value) options.noise_deg = std::atof(argv[++i]);
+        else if (arg == "--noise-mm" && has_value) options.noise_mm = std::atof(argv[++i]);
+        else if (arg == "--outliers" && has_value) options.outliers = std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--max-mm" && has_value) options.max_mm = std::atof(argv[++i]);
+        else if (arg == "--max-deg" && has_value) options.max_deg = std::atof(argv[++i]);
+        else if (arg == "--verbose") options.verbose = true;
+        else {
+            std::cerr << "Usage: " << argv[0] << " [--seeds N] [--noise-deg D] [--noise-mm M] [--outliers K]"
+                      << " [--max-mm M] [--max-deg D] [--verbose]" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    CheckOptions options;
+    if (!parse_options(argc, argv, options)) {
+        return 1;
+    }
+    
+    int failures = 0;
+    double worst_rotation = 0.0, worst_translation = 0.0, worst_belt = 0.0;
+    std::vector<double> translations;
+    std::cout << std::fixed << std::setprecision(2);
+    for (int seed = 0; seed < options.seeds; seed++) {
+        SeedError error = run_seed(seed, options);
+        if (!error.solved) {
+            std::cout << "seed " << seed << ": no solution" << std::endl;
+            failures++;
+            continue;
+        }
+        if (options.verbose) {
+            std::cout << "seed " << seed << ": " << error.rotation_deg << " deg, " << error.translation_mm
+                      << " mm, belt " << error.belt_mm << " mm, " << error.inliers << "/" << error.pairs
+                      << " pairs" << std::endl;
+        }
+        worst_rotation = std::max(worst_rotation, error.rotation_deg);
+        worst_translation = std::max(worst_translation, error.translation_mm);
+        worst_belt = std::max(worst_belt, error.belt_mm);
+        translations.push_back(error.translation_mm);
+    }
+    
+    double median = 0.0;
+    if (!translations.empty()) {
+        std::nth_element(translations.begin(), translations.begin() + translations.size() / 2, translations.end());
+        median = translations[translations.size() / 2];
+    }
+    std::cout << options.seeds << " seeds, noise " << options.noise_deg << " deg / " << options.noise_mm
+              << " mm, " << options.outliers << " outliers: " << failures << " unsolved, camera error worst "
+              << worst_rotation << " deg / " << worst_translation << " mm (median " << median
+              << " mm), belt placement worst " << worst_belt << " mm" << std::endl;
+    
+    if (failures > 0 || worst_translation > options.max_mm || worst_rotation > options.max_deg) {
+        std::cout << "FAIL (limits " << options.max_deg << " deg / " << options.max_mm << " mm)" << std::endl;
+        return 1;
+    }
+    std::cout << "PASS" << std::endl;
+    return 0;
+}
@@ -0,0 +1,458 @@
+// Full-shift soak benchmark for auto mode.
+//
+// Runs the real auto-mode controller (AutoController, RoutineRunner,
+// ServoControl, UltrasonicSensor) against simulated hardware: the fake
+// wiringPi/softPwm in sim/ drive a slew-model arm, the conveyor motor and an
+// ultrasonic sensor looking at the belt, and parts are spaced on the belt
+// with a configurable distribution. The belt runs coordinated with the
+// picks by default, or at a fixed speed as an operator would set it.
+// Everything runs on a SimClock, so an 8 hour shift takes seconds.
+//
+// Reports picks per minute, missed parts, pick latency and cycle time
+// percentiles, the phases that contribute most to cycle time, control
+// tick overruns, CPU per pick and peak memory as JSON, so builds and
+// settings can be compared. With --telemetry the shift is also recorded
+// to a TelemetryStore in DIR and exported as one Arrow file at the end,
+// timing the export; --telemetry-raw-hours shortens raw retention so the
+// shift also exercises the rollups. --rt-memory locks memory the way the
+// controller does in RT_MEMORY_MODE, so the export is timed as it runs there.
+// Built with -DSOAK_RT_CHECK=ON, the auto-mode poll runs in an
+// RtNoAllocScope as in the controller's Debug build, so a heap allocation
+// in steady state asserts offline instead of on the arm.
+//
+// Usage: soak-benchmark [--hours H] [--rate PARTS_PER_MIN] [--arrival poisson|periodic|burst]
+//                       [--burst N] [--window-ms N] [--belt coordinated|fixed] [--belt-speed N]
+//                       [--servo-speed SCALE] [--dropout P] [--tick-budget-ms N] [--params FILE]
+//                       [--seed N] [--telemetry DIR] [--telemetry-raw-hours H] [--rt-memory] [--out FILE]
+//                       [--verbose]
+
+#include "auto_controller.h"
+#include "servo_control.h"
+#include "sensor_ultrasonic.h"
+#include "grab_params.h"
+#include "clock.h"
+#include "telemetry_store.h"
+#include "rt_memory.h"
+#include "sim_hardware.h"
+#include "../include/config.h"
+#include <sys/resource.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Motor driver (src/driver_motor.cpp), on the simulated pins
+extern "C" {
+    bool motor_initialize();
+    void motor_set_speed(int speed);
+}
+
+struct SoakOptions {
+    double hours = 8.0;
+    double rate = 10.0;             // parts per minute at full belt speed
+    std::string arrival = "poisson";
+    int burst = 4;                  // parts per burst
+    int window_ms = 4000;           // time a part stays within reach at full belt speed
+    std::string belt = "coordinated";
+    int belt_speed = CONVEYOR_RUN_SPEED;   // fixed speed, or the coordinated run speed
+    float servo_speed = 1.0f;       // physical servo speed relative to the model
+    SimSensor sensor;
+    int tick_budget_ms = 250;       // idle wake later than AUTO_IDLE_WAKE_MS by this is an overrun
+    std::string params_file = GRAB_PARAMS_FILE;
+    unsigned int seed = 1;
+    std::string telemetry_dir;      // record and export telemetry here, "" to skip
+    double telemetry_raw_hours = TELEMETRY_RAW_HOURS;
+    bool rt_memory = false;         // mlockall as in RT_MEMORY_MODE
+    std::string output;
+    bool verbose = false;
+};
+
+static bool parse_options(int argc, char** argv, SoakOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--hours" && has_value) options.hours = std::atof(argv[++i]);
+        else if (arg == "--rate" && has_value) options.rate = std::atof(argv[++i]);
+        else if (arg == "--arrival" && has_value) options.arrival = argv[++i];
+        else if (arg == "--burst" && has_value) options.burst = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--window-ms" && has_value) options.window_ms = std::atoi(argv[++i]);
+        else if (arg == "--belt" && has_value) options.belt = argv[++i];
+        else if (arg == "--belt-speed" && has_value) options.belt_speed = std::atoi(argv[++i]);
+        else if (arg == "--servo-speed" && has_value) options.servo_speed = std::atof(argv[++i]);
+        else if (arg == "--dropout" && has_value) options.sensor.dropout = std::atof(argv[++i]);
+        else if (arg == "--tick-budget-ms" && has_value) options.tick_budget_ms = std::atoi(argv[++i]);
+        else if (arg == "--params" && has_value) options.params_file = argv[++i];
+        else if (arg == "--seed" && has_value) options.seed = std::atoi(argv[++i]);
+        else if (arg == "--telemetry" && has_value) options.telemetry_dir = argv[++i];
+        else if (arg == "--telemetry-raw-hours" && has_value) options.telemetry_raw_hours = std::atof(argv[++i]);
+        else if (arg == "--rt-memory") options.rt_memory = true;
+        else if (arg == "--out" && has_value) options.output = argv[++i];
+        else if (arg == "--verbose") options.verbose = true;
+        else {
+            std::cerr << "Usage: " << argv[0] << " [--hours H] [--rate PARTS_PER_MIN]"
+                      << " [--arrival poisson|periodic|burst] [--burst N] [--window-ms N]"
+                      << " [--belt coordinated|fixed] [--belt-speed N] [--servo-speed SCALE] [--dropout P] [--tick-budget-ms N]"
+                      << " [--params FILE] [--seed N] [--telemetry DIR] [--telemetry-raw-hours H] [--rt-memory]"
+                      << " [--out FILE] [--verbose]" << std::endl;
+            return false;
+        }
+    }
+    
+    if (options.hours <= 0.0 || options.rate <= 0.0 || options.window_ms <= 0 || options.servo_speed <= 0.0f ||
+        options.belt_speed <= 0 || options.belt_speed > 100 ||
+        (options.belt != "coordinated" && options.belt != "fixed") ||
+        (options.arrival != "poisson" && options.arrival != "periodic" && options.arrival != "burst")) {
+        std::cerr << "Invalid soak benchmark options" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Part arrival times over the shift at full belt speed, in ms from the start
+static std::vector<double> generate_arrivals(const SoakOptions& options, std::mt19937& rng) {
+    double shift_ms = options.hours * 3600000.0;
+    double mean_gap_ms = 60000.0 / options.rate;
+    std::vector<double> arrivals;
+    
+    if (options.arrival == "periodic") {
+        // Evenly spaced with +-10% jitter
+        std::uniform_real_distribution<double> jitter(-0.1 * mean_gap_ms, 0.1 * mean_gap_ms);
+        for (double t = mean_gap_ms; t < shift_ms; t += mean_gap_ms) {
+            arrivals.push_back(t + jitter(rng));
+        }
+    } else if (options.arrival == "burst") {
+        // Poisson bursts of closely spaced parts with the same average rate
+        std::exponential_distribution<double> burst_gap(1.0 / (mean_gap_ms * options.burst));
+        std::uniform_real_distribution<double> spacing(500.0, 1500.0);
+        for (double t = burst_gap(rng); t < shift_ms; t += burst_gap(rng)) {
+            double part = t;
+            for (int i = 0; i < options.burst && part < shift_ms; i++) {
+                arrivals.push_back(part);
+                part += spacing(rng);
+            }
+            t = part;
+        }
+    } else {
+        std::exponential_distribution<double> gap(1.0 / mean_gap_ms);
+        for (double t = gap(rng); t < shift_ms; t += gap(rng)) {
+            arrivals.push_back(t);
+        }
+    }
+    
+    std::sort(arrivals.begin(), arrivals.end());
+    return arrivals;
+}
+
+static double percentile(std::vector<double> values, double p) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    size_t index = static_cast<size_t>(p * (values.size() - 1) + 0.5);
+    return values[index];
+}
+
+static void write_distribution(std::ostream& out, const char* name, const std::vector<double>& values) {
+    out << "  \"" << name << "\": {\"count\": " << values.size()
+        << ", \"p50\": " << percentile(values, 0.50)
+        << ", \"p95\": " << percentile(values, 0.95)
+        << ", \"p99\": " << percentile(values, 0.99)
+        << ", \"max\": " << (values.empty() ? 0.0 : *std::max_element(values.begin(), values.end())) << "},\n";
+}
+
+// Swallows controller log output without buffering it
+class DiscardBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return traits_type::not_eof(c); }
+    std::streamsize xsputn(const char*, std::streamsize count) override { return count; }
+};
+
+static double cpu_seconds() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+struct PhaseSummary {
+    std::string name;
+    double critical_ms;   // mean contribution per cycle
+    double share;
+    double mean_ms;
+    double p95_ms;
+};
+
+struct SoakResult {
+    int parts;
+    int picks;
+    int missed;
+    int empty_grabs;
+    int tick_overruns;
+    std::vector<double> pick_latency_ms;   // part reaching the grab position to gripper closed on it
+    std::vector<double> cycle_ms;          // grab routine durations
+    std::vector<double> tick_ms;           // polls that ended without a part
+    std::vector<double> detect_ms;         // part first seen to grab start
+    unsigned long pings;
+    unsigned long detections;
+    unsigned long occluded;                // pings discarded with the arm in the beam
+    float supply_peak_ma;                  // modeled supply current
+    unsigned long deferrals;               // joint segments staggered by the current budget
+    unsigned long overloads;
+    double belt_mean_speed;                // average motor speed over the shift
+    unsigned long belt_slowdowns;
+    unsigned long belt_stops;
+    std::vector<PhaseSummary> phases;      // grab cycle contributors, largest first
+    TelemetryExport telemetry;             // with --telemetry
+    unsigned long telemetry_dropped;
+    size_t telemetry_segments[TELEMETRY_TIERS];
+    int64_t telemetry_disk_bytes;
+};
+
+// Run the auto-mode branch of control_loop() for one shift
+static bool run_shift(const SoakOptions& options, const GrabParams& grab_params, SoakResult& result) {
+    SimClock clock;
+    set_arm_clock(&clock);
+    
+    std::mt19937 rng(options.seed);
+    SimHardware hardware(clock, grab_params, options.sensor, options.seed);
+    hardware.setServoSpeedScale(options.servo_speed);
+    set_sim_hardware(&hardware);
+    
+    bool initialized;
+    {
+        ServoControl servo_control;
+        UltrasonicSensor ultrasonic;
+        initialized = servo_control.initialize() && ultrasonic.initialize() && motor_initialize();
+        
+        Clock::TimePoint shift_start = clock.now();
+        Clock::TimePoint shift_end = shift_start +
+            std::chrono::milliseconds(static_cast<long long>(options.hours * 3600000.0));
+        std::uniform_real_distribution<float> part_distance(8.0f, 16.0f);
+        for (double arrival_ms : generate_arrivals(options, rng)) {
+            hardware.addPart(arrival_ms / 1000.0 * CONVEYOR_BELT_MM_S, part_distance(rng));
+        }
+        hardware.setReach(options.window_ms / 1000.0 * CONVEYOR_BELT_MM_S);
+        hardware.reserveBelt(4 * hardware.getParts().size()); // about one speed change per part coordinated
+        
+        AutoController controller(servo_control, ultrasonic, grab_params);
+        ConveyorCoordinator& conveyor = controller.getConveyor();
+        if (options.belt == "fixed") {
+            conveyor.setCoordinated(false);
+            motor_set_speed(options.belt_speed);
+        } else {
+            conveyor.setRunSpeed(options.belt_speed);
+        }
+        controller.prepare();
+        initialized = initialized && controller.start();
+        
+        TelemetryStore telemetry(options.telemetry_dir);
+        bool recording = !options.telemetry_dir.empty();
+        if (recording) {
+            TelemetryRetention retention = {static_cast<int64_t>(options.telemetry_raw_hours * 3600000.0),
+                                            TELEMETRY_SECOND_DAYS * 86400000LL, TELEMETRY_MINUTE_DAYS * 86400000LL,
+                                            TELEMETRY_MAX_MB * 1048576LL};
+            telemetry.setRetention(retention);
+            initialized = initialized && telemetry.initialize() &&
+                telemetry.start([&](TelemetrySample& sample) {
+                    for (int i = 0; i < SERVO_COUNT; i++) {
+                        sample.joints[i] = servo_control.getEstimatedAngle(i);
+                    }
+                    sample.distance_cm = controller.getMonitor().getLastDistance();
+                    sample.mode = 1;
+                });
+        }
+        int64_t telemetry_start = telemetry.nowMs();
+        result.tick_overruns = 0;
+        rt_allocation_tracking(true);
+        while (initialized && clock.now() < shift_end) {
+            Clock::TimePoint tick_start = clock.now();
+            const AutoCycle* polled;
+            {
+                RtNoAllocScope no_alloc("auto poll");
+                polled = &controller.poll(tick_start + std::chrono::milliseconds(AUTO_IDLE_WAKE_MS));
+                servo_control.update();
+            }
+            const AutoCycle& cycle = *polled;
+            double elapsed_ms = std::chrono::duration<double, std::milli>(clock.now() - tick_start).count();
+            
+            if (cycle.grabbed) {
+                if (recording) {
+                    telemetry.recordEvent(cycle.report.success ? TELEMETRY_EVENT_GRAB : TELEMETRY_EVENT_GRAB_FAILED);
+                }
+                result.cycle_ms.push_back(cycle.report.actual.count());
+                const CycleProfiler& profiler = controller.getProfiler();
+                for (int phase = 0; phase < profiler.getPhaseCount(); phase++) {
+                    if (profiler.getPhaseName(phase) == "detect") {
+                        result.detect_ms.push_back(profiler.getLastMs(phase));
+                    }
+                }
+            } else {
+                result.tick_ms.push_back(elapsed_ms);
+                if (elapsed_ms > AUTO_IDLE_WAKE_MS + options.tick_budget_ms) {
+                    result.tick_overruns++;
+                }
+            }
+        }
+        rt_allocation_tracking(false);
+        controller.stop();
+        result.telemetry = TelemetryExport();
+        result.telemetry_dropped = 0;
+        result.telemetry_disk_bytes = 0;
+        if (recording) {
+            telemetry.stop();
+            result.telemetry_dropped = telemetry.getDropped();
+            result.telemetry_disk_bytes = telemetry.getDiskBytes();
+            for (int tier = 0; tier < TELEMETRY_TIERS; tier++) {
+                result.telemetry_segments[tier] = telemetry.getSegmentCount(static_cast<TelemetryTier>(tier));
+            }
+            initialized = telemetry.exportArrow(telemetry_start, telemetry.nowMs() + 1,
+                                                options.telemetry_dir + "/export.arrow", result.telemetry) &&
+                          initialized;
+        }
+        result.pings = controller.getMonitor().getPings();
+        result.detections = controller.getMonitor().getDetections();
+        result.occluded = controller.getMonitor().getOccluded();
+        result.supply_peak_ma = servo_control.getBudget().getPeak();
+        result.deferrals = servo_control.getBudget().getDeferrals();
+        result.overloads = servo_control.getBudget().getOverloads();
+        result.belt_mean_speed = hardware.travelAt(shift_end) / (options.hours * 3600.0 * CONVEYOR_BELT_MM_S) * 100.0;
+        result.belt_slowdowns = conveyor.getSlowdowns();
+        result.belt_stops = conveyor.getStops();
+        
+        // Parts still within reach at the end of the shift count as neither
+        result.parts = hardware.getParts().size();
+        result.picks = 0;
+        for (const SimPart& part : hardware.getParts()) {
+            if (part.picked && part.pick_time <= shift_end) {
+                result.picks++;
+                result.pick_latency_ms.push_back(
+                    std::chrono::duration<double, std::milli>(part.pick_time - hardware.arrivalTime(part)).count());
+            }
+        }
+        const CycleProfiler& profiler = controller.getProfiler();
+        for (int phase : profiler.ranked()) {
+            result.phases.push_back({profiler.getPhaseName(phase), profiler.getMeanCriticalMs(phase),
+                                     profiler.getShare(phase), profiler.getMeanMs(phase),
+                                     profiler.percentile(phase, 0.95)});
+        }
+        result.missed = hardware.missedCount(shift_end);
+        result.empty_grabs = hardware.emptyGrabCount();
+    }
+    
+    set_sim_hardware(nullptr);
+    set_arm_clock(nullptr);
+    return initialized;
+}
+
+int main(int argc, char** argv) {
+    SoakOptions options;
+    if (!parse_options(argc, argv, options)) {
+        return 1;
+    }
+    
+    GrabParams grab_params;
+    load_grab_params(options.params_file, grab_params); // Optional, defaults otherwise
+    if (options.rt_memory && !rt_memory_lock()) {
+        return 1;
+    }
+    
+    // Controller log output is noise at thousands of cycles per second
+    DiscardBuffer discard;
+    std::streambuf* cout_buffer = std::cout.rdbuf();
+    std::streambuf* cerr_buffer = std::cerr.rdbuf();
+    if (!options.verbose) {
+        std::cout.rdbuf(&discard);
+        std::cerr.rdbuf(&discard);
+    }
+    
+    auto wall_start = std::chrono::steady_clock::now();
+    double cpu_start = cpu_seconds();
+    SoakResult result;
+    bool completed = run_shift(options, grab_params, result);
+    double cpu_used = cpu_seconds() - cpu_start;
+    double wall_used = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+    
+    std::cout.rdbuf(cout_buffer);
+    std::cerr.rdbuf(cerr_buffer);
+    if (!completed) {
+        std::cerr << "Failed to initialize simulated hardware" << std::endl;
+        return 1;
+    }
+    
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    int offered = result.picks + result.missed;
+    
+    std::ostringstream json;
+    json << "{\n"
+         << "  \"shift_hours\": " << options.hours << ",\n"
+         << "  \"arrival\": \"" << options.arrival << "\",\n"
+         << "  \"rate_per_min\": " << options.rate << ",\n"
+         << "  \"window_ms\": " << options.window_ms << ",\n"
+         << "  \"belt\": \"" << options.belt << "\",\n"
+         << "  \"belt_speed\": " << options.belt_speed << ",\n"
+         << "  \"seed\": " << options.seed << ",\n"
+         << "  \"rt_memory\": " << (options.rt_memory ? "true" : "false") << ",\n"
+         << "  \"parts\": " << result.parts << ",\n"
+         << "  \"picks\": " << result.picks << ",\n"
+         << "  \"missed\": " << result.missed << ",\n"
+         << "  \"miss_rate\": " << (offered > 0 ? static_cast<double>(result.missed) / offered : 0.0) << ",\n"
+         << "  \"empty_grabs\": " << result.empty_grabs << ",\n"
+         << "  \"picks_per_min\": " << result.picks / (options.hours * 60.0) << ",\n";
+    write_distribution(json, "pick_latency_ms", result.pick_latency_ms);
+    write_distribution(json, "cycle_ms", result.cycle_ms);
+    write_distribution(json, "tick_ms", result.tick_ms);
+    write_distribution(json, "detect_ms", result.detect_ms);
+    json << "  \"pings\": " << result.pings << ",\n"
+         << "  \"detections\": " << result.detections << ",\n"
+         << "  \"occluded_pings\": " << result.occluded << ",\n"
+         << "  \"supply_peak_ma\": " << result.supply_peak_ma << ",\n"
+         << "  \"deferrals\": " << result.deferrals << ",\n"
+         << "  \"overloads\": " << result.overloads << ",\n"
+         << "  \"belt_mean_speed\": " << result.belt_mean_speed << ",\n"
+         << "  \"belt_slowdowns\": " << result.belt_slowdowns << ",\n"
+         << "  \"belt_stops\": " << result.belt_stops << ",\n";
+    if (!options.telemetry_dir.empty()) {
+        json << "  \"telemetry\": {\"rows\": " << result.telemetry.rows
+             << ", \"batches\": " << result.telemetry.batches
+             << ", \"bytes\": " << result.telemetry.bytes
+             << ", \"dropped\": " << result.telemetry_dropped
+             << ", \"segments\": [" << result.telemetry_segments[TELEMETRY_TIER_RAW]
+             << ", " << result.telemetry_segments[TELEMETRY_TIER_SECOND]
+             << ", " << result.telemetry_segments[TELEMETRY_TIER_MINUTE] << "]"
+             << ", \"disk_bytes\": " << result.telemetry_disk_bytes
+             << ", \"export_ms\": " << result.telemetry.milliseconds << "},\n";
+    }
+    json << "  \"cycle_phases\": [";
+    for (size_t i = 0; i < result.phases.size(); i++) {
+        const PhaseSummary& phase = result.phases[i];
+        json << (i > 0 ? ",\n" : "\n") << "    {\"name\": \"" << phase.name << "\", \"critical_ms\": " << phase.critical_ms
+             << ", \"share\": " << phase.share << ", \"mean_ms\": " << phase.mean_ms
+             << ", \"p95_ms\": " << phase.p95_ms << "}";
+    }
+    json << "\n  ],\n";
+    json << "  \"tick_budget_ms\": " << options.tick_budget_ms << ",\n"
+         << "  \"tick_overruns\": " << result.tick_overruns << ",\n"
+         << "  \"cpu_s\": " << cpu_used << ",\n"
+         << "  \"cpu_ms_per_pick\": " << (result.picks > 0 ? cpu_used * 1000.0 / result.picks : 0.0) << ",\n"
+         << "  \"wall_s\": " << wall_used << ",\n"
+         << "  \"speedup\": " << (wall_used > 0 ? options.hours * 3600.0 / wall_used : 0.0) << ",\n"
+         << "  \"max_rss_kb\": " << usage.ru_maxrss << "\n"
+         << "}\n";
+    
+    if (options.output.empty()) {
+        std::cout << json.str();
+    } else {
+        std::ofstream file(options.output);
+        if (!(file << json.str())) {
+            std::cerr << "Failed to write " << options.output << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}